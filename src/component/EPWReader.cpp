@@ -19,13 +19,13 @@ void comp::EPWReader::awake()  {
                               }})";
     init_vars(jsonStr1);
 
-
-
-
-
+    fields.clear();
+    for (const char* field : {"dry_bulb_temp", "wind_speed", "rad1", "rad2", "rad3"}) {
+        fields.push_back(outputs.handle<double>(field));
+    }
 }
 
-void comp::EPWReader::before(const core::SimTime& time) {
+void comp::EPWReader::update(const core::SimTime& time) {
     if (!flag) {
         // outputs["temp"]["value"] = getRealNumber();
         // outputs["wind_speed"]["value"] = getRandomNumber();
@@ -33,12 +33,10 @@ void comp::EPWReader::before(const core::SimTime& time) {
         std::vector<float> data = getDataAtHour(currentTime);
 
         // 提取数据
-        if (data.size() >= 5) {
-            outputs["dry_bulb_temp"]["value"] = data[0];
-            outputs["wind_speed"]["value"] = data[1];
-            outputs["rad1"]["value"] = data[2];
-            outputs["rad2"]["value"] = data[3];
-            outputs["rad3"]["value"] = data[4];
+        if (data.size() >= fields.size()) {
+            for (size_t i = 0; i < fields.size(); ++i) {
+                outputs.set(fields[i], static_cast<double>(data[i]));
+            }
         }
 
         flag = true;
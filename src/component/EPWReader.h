@@ -19,6 +19,7 @@ class EPWReader:public core::BaseComponent {
     std::string delimiter;                // 字段分隔符
     std::vector<unsigned int> targetCols;          // 目标列索引
     std::vector<std::vector<float>> data; // 存储数据的二维向量
+    std::vector<core::DoubleVar> fields;  // 各目标列对应的输出变量（awake时解析）
 
     // 解析一行数据
     [[nodiscard]] std::vector<float> parseLine(const std::string& line) const {
@@ -146,7 +147,8 @@ public:
         targetCols = {6, 21, 13, 14, 15};  // [温度，风速，辐射1，辐射2，辐射3]
     }
     void awake() override;
-    void before(const core::SimTime& time) override;
+    [[nodiscard]] bool is_thread_safe() const override { return true; }  // update只写本组件的输出
+    void update(const core::SimTime& time) override;
     void after(const core::SimTime& time) override;
     void sayHello() override;
     void parse(const json &in_params) override;
@@ -16,7 +16,11 @@ namespace comp {
                               "outputs": {}})";
         init_vars(jsonStr1);
 
-
+        columns.clear();
+        for (const auto& var_name : var_names) {
+            const std::string key = var_name.get<std::string>();
+            columns.push_back(inputs.contains(key) ? inputs.ref(key) : core::VarRef{});
+        }
     }
 
     void Output::after(const core::SimTime& time) {
@@ -31,9 +35,9 @@ namespace comp {
             if (fabs(remainder) < EPSILON) {
                 if (outFile.is_open()) {
                     outFile << time.get_current_datetime_str() << ",";
-                    for (const auto& var_name : var_names) {
-                        if (inputs.contains(var_name)) {
-                            outFile << inputs[var_name]["value"] << ",";
+                    for (const auto& column : columns) {
+                        if (column.valid()) {
+                            outFile << inputs.valueJson(column) << ",";
                         } else {
                             outFile << "nan" << ",";
                         }
@@ -71,8 +75,7 @@ namespace comp {
                     var_names.push_back(var_name);
 
                     // 初始化输入值为0.0
-                    inputs[var_name] = json::object();
-                    inputs[var_name]["value"] = 0.0;
+                    inputs.define(var_name, json{{"value", 0.0}});
                 }
             }
 
@@ -15,12 +15,14 @@ private:
     std::ofstream outFile;
 
     json var_names;
+    std::vector<core::VarRef> columns;  // 各输出列对应的输入变量（awake时解析）
 
     double interval = 1;
 
 
 public:
     void awake() override;
+    [[nodiscard]] bool is_thread_safe() const override { return true; }  // 输出在after中写入，update为空
     void after(const core::SimTime& time) override;
     ~Output() override;
     void parse(const json &in_params) override;
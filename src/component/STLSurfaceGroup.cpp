@@ -4,6 +4,9 @@
 
 #include "STLSurfaceGroup.h"
 
+#include <algorithm>
+#include <sstream>
+
 #include "SystemStateHub.h"
 #include <SunPosition.h>
 
@@ -20,8 +23,20 @@ namespace comp {
                               "outputs": {}})";
         init_vars(jsonStr1);
 
-        //初始化表面组
-        surface_group = std::make_shared<SurfaceGroup>(name, path, surface_names);
+        surface_outputs.clear();
+        for (const auto& surface_name : surface_names) {
+            surface_outputs.push_back({
+                outputs.handle<double>(surface_name + "_shd"),
+                outputs.handle<double>(surface_name + "_rad_direct"),
+                outputs.handle<double>(surface_name + "_rad_diffuse"),
+                outputs.handle<double>(surface_name + "_rad_reflect"),
+                outputs.handle<double>(surface_name + "_rad_total"),
+            });
+        }
+
+        if (!weather) {
+            throw std::runtime_error("STLSurfaceGroup " + name + " 的天气组件不存在（须在本组件之前定义）");
+        }
 
         auto site = core::SystemStateHub::getInstance().getSite();
 
@@ -29,29 +44,154 @@ namespace comp {
         latitude = site->latitude;
         timeZone = static_cast<int>(site->timeZone);
 
+        //初始化表面组（同一STL文件只解析一次，其他组件以相同参数分析过的表面直接共享）
+        //遮挡计算使用进程共用的线程池，不为每个分组另开线程
+        const auto pool = core::SystemStateHub::getInstance().getThreadPool();
+        surfaces = GeometryRegistry::getInstance().acquireSurfaces(name, path, surface_names, pool, shading_options);
+
+        //SunPath模式：预先计算模拟期间太阳经过的网格单元（每个分组一次）
+        if (shading_options.mode == ShadingMode::SunPath) {
+            const auto sun_positions = collect_sun_positions();
+            std::vector<SurfaceGroup*> groups;
+            for (const auto& surface : surfaces) {
+                if (std::ranges::find(groups, surface.group.get()) == groups.end()) {
+                    groups.push_back(surface.group.get());
+                    surface.group->precomputeSunPath(sun_positions);
+                }
+            }
+        }
 
+        //表面ID已在注册表中解析，逐时步查询时不再按名称查找；法向量和视角系数与时间无关，一并取出
+        //（update可能与共享同一分组的其他组件并行，逐时步只做只读查询）
+        surface_normals.clear();
+        sky_view_factors.clear();
+        ground_view_factors.clear();
+        for (size_t i = 0; i < surface_names.size(); ++i) {
+            const auto& [group, id] = surfaces[i];
+            if (id < 0) {
+                throw std::runtime_error("STL文件中不存在表面: " + surface_names[i]);
+            }
+            surface_normals.push_back(group->getAveNormal(surface_names[i]));
+            sky_view_factors.push_back(group->getSkyViewFactor(id));
+            ground_view_factors.push_back(group->getGroundViewFactor(id));
+        }
     }
 
-    void STLSurfaceGroup::before(const core::SimTime &time) {
+    std::vector<std::pair<double, double>> STLSurfaceGroup::collect_sun_positions() const {
+        std::vector<std::pair<double, double>> positions;
+        const auto& hub = core::SystemStateHub::getInstance();
+        core::SimTime time(0, 0, hub.getTimestep());
+        for (const auto& period : hub.getRunPeriods()) {
+            time.setRunPeriod(period);
+            while (time.currentTime <= time.endTime) {
+                auto [year, month, day, hour, min, sec] = time.getCurrentDateTime();
+                auto [altitude, azimuth] = util::SunPosition::calculate_sun_position(longitude, latitude, timeZone, year, month, day, hour, min, sec);
+                if (altitude > 0) {
+                    positions.emplace_back(altitude, azimuth);
+                }
+                time.advanceTime();
+            }
+        }
+        return positions;
+    }
+
+    // 可选参数（key=value）：
+    //   shading=grid|sunpath|adaptive  遮挡计算方式，sunpath只计算模拟期间太阳经过的天空区域，
+    //                             adaptive在粗网格上按阴影变化自适应加密
+    //   sky_altitude_step=<度>    sunpath模式的高度角网格步长
+    //   sky_azimuth_step=<度>     sunpath模式的方位角网格步长
+    //   occlusion=raycast|raster  遮挡判定引擎，raster按深度图近似判定，适合高度细分的表面
+    //   raster_resolution=<像素>  raster引擎的深度图边长
+    //   adaptive_tolerance=<值>   adaptive模式下角点遮挡值相差超过该值的单元继续细分
+    //   adaptive_depth=<层数>     adaptive模式的最大细分层数
+    //   samples=mesh|stream|progressive  stream时不保存细分网格，遮挡计算中现场生成采样点（省内存，结果相同）；
+    //                             progressive在stream基础上逐个父三角形渐进加密，误差达标即停止
+    //   progressive_tolerance=<值> progressive模式下逐层加密的停止判据容差（启发式，非误差界）
+    //   precision=double|float|validate  射线求交精度，float省一半遮挡物内存；
+    //                             validate以双精度为准，另用单精度计算一遍并报告最大差异
+    void STLSurfaceGroup::parse_option(const std::string& option) {
+        const size_t eq = option.find('=');
+        const std::string key = option.substr(0, eq);
+        const std::string value = option.substr(eq + 1);
+
+        if (key == "shading") {
+            if (value == "grid") {
+                shading_options.mode = ShadingMode::Grid;
+            } else if (value == "sunpath") {
+                shading_options.mode = ShadingMode::SunPath;
+            } else if (value == "adaptive") {
+                shading_options.mode = ShadingMode::Adaptive;
+            } else {
+                throw std::runtime_error("未知的遮挡计算方式: " + value);
+            }
+        } else if (key == "sky_altitude_step") {
+            shading_options.sky_altitude_step = std::stod(value);
+        } else if (key == "sky_azimuth_step") {
+            shading_options.sky_azimuth_step = std::stod(value);
+        } else if (key == "occlusion") {
+            shading_options.occlusion_method = parse_occlusion_method(value);
+        } else if (key == "raster_resolution") {
+            shading_options.raster_resolution = std::stoi(value);
+        } else if (key == "adaptive_tolerance") {
+            shading_options.adaptive_tolerance = std::stod(value);
+        } else if (key == "adaptive_depth") {
+            shading_options.adaptive_max_depth = std::stoi(value);
+        } else if (key == "samples") {
+            if (value == "mesh") {
+                shading_options.sample_mode = SampleMode::Mesh;
+            } else if (value == "stream") {
+                shading_options.sample_mode = SampleMode::Stream;
+            } else if (value == "progressive") {
+                shading_options.sample_mode = SampleMode::Progressive;
+            } else {
+                throw std::runtime_error("未知的采样方式: " + value);
+            }
+        } else if (key == "progressive_tolerance") {
+            shading_options.progressive_tolerance = std::stod(value);
+        } else if (key == "precision") {
+            if (value == "double") {
+                shading_options.precision = PrecisionMode::Double;
+            } else if (value == "float") {
+                shading_options.precision = PrecisionMode::Float;
+            } else if (value == "validate") {
+                shading_options.precision = PrecisionMode::Validate;
+            } else {
+                throw std::runtime_error("未知的求交精度: " + value);
+            }
+        } else {
+            throw std::runtime_error("未知的STLSurfaceGroup参数: " + key);
+        }
+        params.define(key, {{"name", key}, {"type", "string"}, {"value", value}});
+    }
+
+    std::vector<std::shared_ptr<core::BaseComponent>> STLSurfaceGroup::dependencies() const {
+        if (!weather) return {};
+        return {weather};
+    }
+
+    void STLSurfaceGroup::update(const core::SimTime &time) {
 
         if (!flag) {
+            // 可能与其他组件并行计算，日志先写入缓冲区，最后一次输出
+            std::ostringstream log;
+
             //获取经纬度，计算太阳方位角和高度角，更新数据
             auto [year, month, day, hour, min, sec] = time.getCurrentDateTime();
             auto [altitude, azimuth] = util::SunPosition::calculate_sun_position(longitude, latitude, timeZone, year, month, day, hour, min, sec);
 
             // 输出示例（北京地区正午）
-            std::cout << std::fixed << std::setprecision(2);
-            std::cout<<longitude<<" "<<latitude<<" "<<timeZone<<" "<< year<<" "<<month<<" "<< day<<" "<<hour<<" "<<min<<" "<<sec<<" "<<std::endl;
-            std::cout << "太阳高度角: " << altitude << "°" << std::endl;  // 例如 60.5°
-            std::cout << "太阳方位角: " << azimuth << "°" << std::endl;    // 例如 180°（正南）
-
-            //获取辐射数据
-            weather->before(time);
-
-
-            const double rad1=weather->getOutputVal("rad1")["value"].get<double>();
-            const double rad2=weather->getOutputVal("rad2")["value"].get<double>();
-            //const double windspeed=weather->getOutputVal("wind_speed")["value"].get<double>();
+            log << std::fixed << std::setprecision(2);
+            log<<longitude<<" "<<latitude<<" "<<timeZone<<" "<< year<<" "<<month<<" "<< day<<" "<<hour<<" "<<min<<" "<<sec<<" "<<std::endl;
+            log << "太阳高度角: " << altitude << "°" << std::endl;  // 例如 60.5°
+            log << "太阳方位角: " << azimuth << "°" << std::endl;    // 例如 180°（正南）
+
+            //获取辐射数据（天气组件是本组件的依赖，所在依赖层先于本组件计算完毕）
+            if (!weather_rad1.valid()) {
+                weather_rad1 = weather->getOutputs().handle<double>("rad1");
+                weather_rad2 = weather->getOutputs().handle<double>("rad2");
+            }
+            const double rad1=weather->getOutputs().get(weather_rad1);
+            const double rad2=weather->getOutputs().get(weather_rad2);
 
             //std::cout << "直接辐射: " << rad1 << "W/m2" << std::endl;
             //std::cout << "天空散射辐射: " << rad2 << "W/m2" << std::endl;
@@ -60,41 +200,41 @@ namespace comp {
             //std::cout<<"children"<<outputs <<std::endl;
             //std::cout<<"parents:"<<BaseComponent::outputs<<std::endl;
 
-            for (const auto& surface_name : surface_names) {
-                auto normal = surface_group->getAveNormal(surface_name);
-                std::string shd = surface_name+"_shd";  //遮挡值
-                std::string rad_direct  = surface_name+"_rad_direct";
-                std::string rad_diffuse = surface_name+"_rad_diffuse";
-                std::string rad_reflect = surface_name+"_rad_reflect";
-                std::string rad_total   = surface_name+"_rad_total";
-                double val = surface_group->get_shadow_value(altitude, azimuth, surface_name);
+            for (size_t i = 0; i < surface_names.size(); ++i) {
+                const auto& [group, surface_id] = surfaces[i];
+                const SurfaceOutputs& vars = surface_outputs[i];
+                const Point3D& normal = surface_normals[i];
+                double val = group->get_shadow_value(altitude, azimuth, surface_id);
                 //std::cout<<shd<<" "<<val<<" ";
                 //std::cout<<"输出："<<outputs<<std::endl;
-                this->outputs[shd]["value"] = val; //余弦值
+                outputs.set(vars.shd, val); //余弦值
 
                 //辐射计算
                 //地面反射
-                std::cout<<"法向量"<<normal.x<<" "<<normal.y<<" "<<normal.z<<std::endl;
+                log<<"法向量"<<normal.x<<" "<<normal.y<<" "<<normal.z<<std::endl;
                 std::vector n = {normal.x,normal.y,normal.z};
                 auto [totRad, directRad, diffuseRad, reflectRad] = util::Radiation::calculateTotalRadiationOnSurface(
                     rad1, rad2,
                     n,
                     val,
                     altitude*M_PI/180.0,
-                    0.12
+                    0.12,
+                    true,
+                    sky_view_factors[i],
+                    ground_view_factors[i]
                 );
 
-                this->outputs[rad_direct]["value"] = directRad;
-                this->outputs[rad_diffuse]["value"] = diffuseRad;
-                this->outputs[rad_reflect]["value"] = reflectRad;
-                this->outputs[rad_total]["value"] = totRad;
+                outputs.set(vars.rad_direct, directRad);
+                outputs.set(vars.rad_diffuse, diffuseRad);
+                outputs.set(vars.rad_reflect, reflectRad);
+                outputs.set(vars.rad_total, totRad);
 
 
 
             }
             //std::cout<<std::endl;
 
-
+            std::cout << log.str();
 
             flag = true;
         }
@@ -116,7 +256,7 @@ namespace comp {
 
             // 天气数据
             std::string weather_name= in_params[1].get<std::string>();
-            params["weather"]["value"] = weather_name;
+            params.assign("weather", weather_name);
             weather = core::SystemStateHub::getInstance().getComponent(weather_name);
 
             if (in_params.is_array() && in_params.size() > 1) {
@@ -125,6 +265,12 @@ namespace comp {
                     auto surf_name = in_params[i].get<std::string>();
                     std::cout<<surf_name<<std::endl;
 
+                    // key=value形式为选项，其余为表面名
+                    if (surf_name.find('=') != std::string::npos) {
+                        parse_option(surf_name);
+                        continue;
+                    }
+
                     surface_names.push_back(surf_name);
 
 
@@ -160,7 +306,7 @@ namespace comp {
                 }
             }
 
-            std::cout<<"STL:"<<outputs<<std::endl;
+            std::cout<<"STL:"<<outputs.toJson()<<std::endl;
 
 
         } catch (const json::parse_error& e) {
@@ -5,7 +5,7 @@
 #ifndef STLSURFACEGROUP_H
 #define STLSURFACEGROUP_H
 #include <BaseComponent.h>
-#include <SurfaceGroup.h>
+#include <GeometryRegistry.h>
 
 using namespace geom;
 
@@ -15,8 +15,26 @@ namespace comp {
         std::shared_ptr<BaseComponent> weather;
 
         std::string path;
-        std::shared_ptr<SurfaceGroup> surface_group;
         std::vector<std::string> surface_names;
+        // 各表面的分析分组及ID（awake时从几何注册表取得，同一STL的其他组件分析过的表面直接共享）
+        std::vector<GeometryRegistry::SurfaceHandle> surfaces;
+        std::vector<Point3D> surface_normals;     // 各表面的平均法向量（awake时读取）
+        std::vector<double> sky_view_factors;     // 各表面的天空视角系数（awake时读取）
+        std::vector<double> ground_view_factors;  // 各表面的地面视角系数
+        ShadingOptions shading_options;  // 遮挡计算方式（参数中的key=value选项）
+
+        // 各表面的输出变量句柄（awake时解析）
+        struct SurfaceOutputs {
+            core::DoubleVar shd;
+            core::DoubleVar rad_direct;
+            core::DoubleVar rad_diffuse;
+            core::DoubleVar rad_reflect;
+            core::DoubleVar rad_total;
+        };
+        std::vector<SurfaceOutputs> surface_outputs;
+        // 天气组件的辐射输出（首次使用时解析，天气组件的变量在其awake中定义）
+        core::DoubleVar weather_rad1;
+        core::DoubleVar weather_rad2;
 
         bool flag=false;
 
@@ -24,9 +42,16 @@ namespace comp {
         double latitude; //纬度
         int timeZone;
 
+        // 按模拟时段和时间步长遍历太阳位置(高度角, 方位角)
+        std::vector<std::pair<double, double>> collect_sun_positions() const;
+        void parse_option(const std::string& option);
+
     public:
         void awake() override;
-        void before(const core::SimTime &time) override;
+        // update只读取天气组件的输出（声明为依赖，先于本组件计算）并写本组件的输出；遮挡表的按需计算有锁保护
+        [[nodiscard]] bool is_thread_safe() const override { return true; }
+        [[nodiscard]] std::vector<std::shared_ptr<BaseComponent>> dependencies() const override;
+        void update(const core::SimTime &time) override;
         void after(const core::SimTime& time) override;
         void parse(const json &in_params) override;
     };
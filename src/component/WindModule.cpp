@@ -20,22 +20,21 @@ void comp::WindModule::awake() {
                               }})";
     init_vars(jsonStr1);
 
+    e = params.handle<double>("e");
+    wind_speed = inputs.handle<double>("wind_speed");
+    power = outputs.handle<double>("power");
+    energy = outputs.handle<double>("energy");
 }
 
 void comp::WindModule::update(const core::SimTime& time) {
     //LOG_DEBUG("windModule");
 
-    // std::cout<<params<<std::endl;
-    // std::cout<<inputs<<std::endl;
-    // std::cout<<outputs<<std::endl;
-    //std::cout<<previous_outputs<<std::endl;
-    //std::cout<<previous_outputs_2<<std::endl;
-    const double e = params["e"]["value"];
-    double wind_speed = inputs["wind_speed"]["value"];
-    double power = e * wind_speed;
-    outputs["power"]["value"] = power;
-    double energy = outputs["energy"]["value"];
-    outputs["energy"]["value"] = energy+power;
+    // std::cout<<params.toJson()<<std::endl;
+    // std::cout<<inputs.toJson()<<std::endl;
+    // std::cout<<outputs.toJson()<<std::endl;
+    const double p = params.get(e) * inputs.get(wind_speed);
+    outputs.set(power, p);
+    outputs.set(energy, outputs.get(energy) + p);
 
 }
 
@@ -44,7 +43,7 @@ void comp::WindModule::parse(const json &in_params) {
     //in_params是一个数组
     try {
         std::cout<<in_params<<std::endl;
-        params["e"]["value"] = in_params[0];
+        params.assign("e", in_params[0]);
     }catch (const json::parse_error& e) {
         std::cerr << "输入文件参数错误: " << e.what() << std::endl;
     }
@@ -12,9 +12,15 @@
 namespace comp {
 class WindModule: public core::BaseComponent{
 private:
+    // 变量句柄（awake时解析）
+    core::DoubleVar e;
+    core::DoubleVar wind_speed;
+    core::DoubleVar power;
+    core::DoubleVar energy;
 
 public:
     void awake() override;
+    [[nodiscard]] bool is_thread_safe() const override { return true; }  // update只读写本组件的变量
     void update(const core::SimTime& time) override;
     void parse(const json &in_params) override;
 
@@ -5,9 +5,13 @@
 #ifndef BASECOMPONENT_H
 #define BASECOMPONENT_H
 
+#include <memory>
+#include <vector>
+
 #include <json.hpp>
 
 #include "SimTime.h"
+#include "VariableStore.h"
 
 
 using json =  nlohmann::json;
@@ -18,11 +22,11 @@ namespace core {
     class BaseComponent {
     protected:
         std::string name; //组件名
-        json params= json::object();
-        json inputs = json::object();
-        json outputs = json::object();
-        json previous_outputs = json::object();   //瞬时值
-        json previous_outputs_2 = json::object(); //非瞬时值
+        // 参数、输入、输出按类型存放在连续槽位中，组件在awake/parse时解析句柄，之后按句柄读写
+        // 输出的上一次值（瞬时值每次迭代前记录，非瞬时值在时间步收敛后记录）也保存在outputs中
+        VariableStore params;
+        VariableStore inputs;
+        VariableStore outputs;
 
         bool is_converged = false;
 
@@ -34,6 +38,12 @@ namespace core {
         virtual void update(const SimTime& time) {};
         virtual void after(const SimTime& time){};
         virtual void sayHello(){}
+
+        // 线程安全特性：update只读写本组件的变量（不访问其他组件和全局状态）时返回true，
+        // 此时同一依赖层中的多个组件可以在线程池中同时update；默认不并行
+        [[nodiscard]] virtual bool is_thread_safe() const { return false; }
+        // 不经过连接、在update中直接读取其输出的组件；调度时视为依赖（先于本组件计算），默认无
+        [[nodiscard]] virtual std::vector<std::shared_ptr<BaseComponent>> dependencies() const { return {}; }
         virtual ~BaseComponent()= default;
 
         void init_vars(const std::string& jsonStr);
@@ -51,12 +61,23 @@ namespace core {
             this->is_converged = val;
         }
 
-        json getOutputVal(const std::string &varname) {
-            return this->outputs[varname];
+        // 以json形式读写单个变量（配置与调试用，变量不存在时getOutputVal抛出异常）
+        json getOutputVal(const std::string &varname) const {
+            return this->outputs.toJson(varname);
         }
 
-        void setInputVal(const std::string& varname, const json& val) {
-            this->inputs[varname] = val;
+        void setInputVal(const std::string& varname, const json& val);
+
+        // 变量存储（供连接等在初始化时解析槽位）
+        [[nodiscard]] const VariableStore& getParams() const { return params; }
+        [[nodiscard]] const VariableStore& getInputs() const { return inputs; }
+        [[nodiscard]] VariableStore& getInputs() { return inputs; }
+        [[nodiscard]] const VariableStore& getOutputs() const { return outputs; }
+
+        // 冻结输入与输出的槽位（连接编译后由SimManager调用），此后不能再新建变量
+        void freeze_vars() {
+            inputs.freeze();
+            outputs.freeze();
         }
 
         virtual void parse(const json& in_params);
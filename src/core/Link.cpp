@@ -4,7 +4,7 @@
 
 #include "Link.h"
 
-#include <iostream>
+#include <stdexcept>
 
 #include "SystemStateHub.h"
 
@@ -31,20 +31,54 @@ namespace core {
 
     }
 
-    void Link::update() {
-
-        try {
-            // 获取源值
-            json source_val = source_component->getOutputVal(source_variable);
-
-            target_component->setInputVal(target_variable, source_val);
+    void Link::resolve(VarRef &source_ref, VarRef &target_ref) const {
+        const VariableStore& outputs = source_component->getOutputs();
+        const VariableStore& inputs = target_component->getInputs();
+        if (!outputs.contains(source_variable)) {
+            throw std::runtime_error("连接的源变量不存在: " + describe());
+        }
+        if (!inputs.contains(target_variable)) {
+            throw std::runtime_error("连接的目标变量不存在: " + describe());
+        }
+        source_ref = outputs.ref(source_variable);
+        target_ref = inputs.ref(target_variable);
+        if (source_ref.type == VarType::String || target_ref.type == VarType::String) {
+            throw std::runtime_error("字符串变量不能连接: " + describe());
+        }
+        // 整数/布尔值可以连接到double输入（按数值转换），其余情况两端类型须一致
+        if (source_ref.type != target_ref.type && target_ref.type != VarType::Double) {
+            throw std::runtime_error("连接两端的变量类型不一致（只允许整数/布尔值连接到double输入）: " + describe());
+        }
+    }
 
+    std::string Link::describe() const {
+        return source + "." + source_variable + " -> " + target + "." + target_variable;
+    }
 
-        } catch (const std::exception& e) {
-            std::cerr << "更新链接错误: " << e.what() << std::endl;
-        } catch (...) {
-            std::cerr << "更新链接时发生未知错误" << std::endl;
+    void LinkPlan::add(const Link &link) {
+        VarRef source_ref, target_ref;
+        link.resolve(source_ref, target_ref);
+        const void* source_slot = link.getSourceComponent()->getOutputs().address(source_ref);
+        void* target_slot = link.getTargetComponent()->getInputs().address(target_ref);
+        const bool to_double = source_ref.type != target_ref.type;
+        switch (source_ref.type) {
+            case VarType::Double:
+                doubles.push_back({static_cast<const double*>(source_slot), static_cast<double*>(target_slot)});
+                break;
+            case VarType::Int:
+                if (to_double) {
+                    ints_to_doubles.push_back({static_cast<const int*>(source_slot), static_cast<double*>(target_slot)});
+                } else {
+                    ints.push_back({static_cast<const int*>(source_slot), static_cast<int*>(target_slot)});
+                }
+                break;
+            default:
+                if (to_double) {
+                    bools_to_doubles.push_back({static_cast<const uint8_t*>(source_slot), static_cast<double*>(target_slot)});
+                } else {
+                    bools.push_back({static_cast<const uint8_t*>(source_slot), static_cast<uint8_t*>(target_slot)});
+                }
+                break;
         }
-
     }
 } // core
\ No newline at end of file
@@ -5,6 +5,8 @@
 #ifndef LINK_H
 #define LINK_H
 #include <memory>
+#include <string>
+#include <vector>
 #include "BaseComponent.h"
 
 
@@ -24,10 +26,58 @@ public:
     Link(const std::string& sourceComp, const std::string& sourceVar,
          const std::string& targetComp, const std::string& targetVar);
 
-    // 更新链接
-    void update();
+    // 解析两端的变量（源组件的输出 → 目标组件的输入），变量不存在或类型不兼容时抛出异常
+    // 两端类型须一致，唯一的例外是整数/布尔值连接到double输入（如Output的各列），同步时按数值转换
+    // 须在各组件定义完变量（awake）之后调用
+    void resolve(VarRef& source_ref, VarRef& target_ref) const;
 
+    [[nodiscard]] const std::shared_ptr<BaseComponent>& getSourceComponent() const { return source_component; }
+    [[nodiscard]] const std::shared_ptr<BaseComponent>& getTargetComponent() const { return target_component; }
 
+    // 连接的文字描述（用于日志和错误信息）
+    [[nodiscard]] std::string describe() const;
+};
+
+// 编译后的连接：一组（源槽位, 目标槽位）指针对，按类型分开存放，每次同步只做直接复制（或转换为double）
+// 编译后须冻结各组件的变量存储（BaseComponent::freeze_vars），槽位数组扩容会使指针失效
+class LinkPlan {
+private:
+    template <typename S, typename T = S>
+    struct SlotCopy {
+        const S* source;
+        T* target;
+    };
+
+    std::vector<SlotCopy<double>> doubles;
+    std::vector<SlotCopy<int>> ints;
+    std::vector<SlotCopy<uint8_t>> bools;
+    std::vector<SlotCopy<int, double>> ints_to_doubles;
+    std::vector<SlotCopy<uint8_t, double>> bools_to_doubles;
+
+public:
+    // 加入一条连接（解析失败时抛出异常）
+    void add(const Link& link);
+
+    void clear() {
+        doubles.clear();
+        ints.clear();
+        bools.clear();
+        ints_to_doubles.clear();
+        bools_to_doubles.clear();
+    }
+
+    [[nodiscard]] size_t size() const {
+        return doubles.size() + ints.size() + bools.size() + ints_to_doubles.size() + bools_to_doubles.size();
+    }
+
+    // 同步所有连接（各组内按加入顺序复制；同一输入不应连接多个源，因此组间顺序无关）
+    void run() const {
+        for (const auto& copy : doubles) *copy.target = *copy.source;
+        for (const auto& copy : ints) *copy.target = *copy.source;
+        for (const auto& copy : bools) *copy.target = *copy.source;
+        for (const auto& copy : ints_to_doubles) *copy.target = static_cast<double>(*copy.source);
+        for (const auto& copy : bools_to_doubles) *copy.target = *copy.source != 0 ? 1.0 : 0.0;
+    }
 };
 
 } // core
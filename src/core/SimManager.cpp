@@ -3,6 +3,11 @@
 //
 #include "SimManager.h"
 
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <set>
+
 #include "SystemStateHub.h"
 #include <Parser.h>
 #include "ComponentFactory.h"
@@ -10,7 +15,6 @@
 namespace core {
     SimManager::SimManager(): time(0,10,1) {
         //time = SimTime(0, 10, 1);
-        run_periods = json::array();
     }
 
     void SimManager::parse_file(const std::string& in_file) {
@@ -20,10 +24,29 @@ namespace core {
         const json& modules = res["modules"];
         const json& links = res["links"];
         const json& site = res["site"];
-        this->run_periods = res["run_periods"];
         this->timestep = res["timestep"];
         this->max_iterations = std::stoi(res["control"][2].get<std::string>());
 
+        // 解析模拟时段
+        this->run_periods.clear();
+        for (const auto& run_period : res["run_periods"]) {
+            try {
+                // 使用get<std::string>()先获取字符串，再转为整数
+                RunPeriod period;
+                period.name = run_period["object_name"].get<std::string>();
+                period.startYear = std::stoi(run_period["params"][0].get<std::string>());
+                period.startMonth = std::stoi(run_period["params"][1].get<std::string>());
+                period.startDay = std::stoi(run_period["params"][2].get<std::string>());
+                period.endYear = std::stoi(run_period["params"][3].get<std::string>());
+                period.endMonth = std::stoi(run_period["params"][4].get<std::string>());
+                period.endDay = std::stoi(run_period["params"][5].get<std::string>());
+                this->run_periods.push_back(period);
+            } catch (const std::exception& e) {
+                std::cerr << "Error parsing time parameters: " << e.what() << std::endl;
+            }
+        }
+        SystemStateHub::getInstance().setRunPeriods(this->run_periods, this->timestep);
+
         // std::cout<<modules<<std::endl;
         // std::cout<<links<<std::endl;
         for (auto module : modules) {
@@ -68,8 +91,8 @@ namespace core {
     bool SimManager::run_a_step(const SimTime& time) {
         //LOG_DEBUG("运行一步");
 
-        int iteration = 0; //当前时间步
-        bool converged = false; //是否收敛
+        int iteration = 1; //本时间步中迭代最多的块的迭代次数
+        bool converged = true; //是否收敛
 
         // 每个时间步开始时，重置模块的收敛状态
         SystemStateHub::getInstance().forEachComponent([](const std::string& name, const std::shared_ptr<BaseComponent> &component) {
@@ -80,101 +103,361 @@ namespace core {
             component->before(time);
         });
 
-        while (iteration<max_iterations && !converged) {
-            // 1. 更新所有模块的前一次输出值
+        // 按依赖层执行各块：不在环上的组件输入已是本步的最终值，只计算一次；环在块内迭代至收敛
+        for (const auto& level : levels) {
+            if (!run_level(level, time, iteration)) {
+                converged = false;
+                break;
+            }
+        }
 
-            SystemStateHub::getInstance().forEachComponent([](const std::string& name, const std::shared_ptr<BaseComponent>& component) {
+        if (converged==true) {
+            SystemStateHub::getInstance().forEachComponent([this, time](const std::string& name, const std::shared_ptr<BaseComponent> &component) {
                 component->update_previous_values();
-            });
-
-            // 2. 执行模块计算（假设模块的 update 方法会更新输出）
+                component->update_previous_output_2();
+                component->after(time);
 
-            SystemStateHub::getInstance().forEachComponent([time](const std::string& name, const std::shared_ptr<BaseComponent> &component) {
-                component->update(time);
             });
+        }
+        step_count += 1;
+        iteration_count += iteration;
 
-            // # 3. 通过 Link 同步变量
-            SystemStateHub::getInstance().update_links();
+        //LOG_DEBUG("运行一步结束");
+        return converged;
+    }
 
-            // 4. 检查每个模块的收敛状态
-            SystemStateHub::getInstance().forEachComponent([this](const std::string& name, const std::shared_ptr<BaseComponent> &component) {
-                component->check_convergence(convergence_threshold);
+    bool SimManager::run_level(const ExecutionLevel& level, const SimTime& time, int& iteration) {
+        // 1. 可并行的组件在线程池中同时计算，等待全部完成（层间屏障）后再同步它们的连接，
+        //    连接的目标都在后面的层中，同步顺序不影响结果
+        if (pool && level.parallel.size() > 1) {
+            pool->parallel_for(level.parallel.size(), [this, &level, &time](size_t k) {
+                update_once(blocks[level.parallel[k]].begin, time);
             });
-            // 5. 检查全局收敛
-            converged = check_global_convergence();
+        } else {
+            for (const size_t b : level.parallel) {
+                update_once(blocks[b].begin, time);
+            }
+        }
+        for (const size_t b : level.parallel) {
+            outgoing[blocks[b].begin].run();
+            blocks[b].iterations += 1;
+        }
+        update_count += static_cast<long long>(level.parallel.size());
 
-            if (converged==false) {
-                SystemStateHub::getInstance().forEachComponent([this](const std::string& name, const std::shared_ptr<BaseComponent>& component) {
-                    component->set_previous_outputs_2_to_current();
-                });
+        // 2. 环和非线程安全的组件依次执行
+        for (const size_t b : level.serial) {
+            if (!run_block(blocks[b], time, iteration)) {
+                return false;
             }
-            iteration += 1;
         }
-        if (converged==true) {
-            SystemStateHub::getInstance().forEachComponent([this, time](const std::string& name, const std::shared_ptr<BaseComponent> &component) {
-                component->update_previous_values();
-                component->update_previous_output_2();
-                component->after(time);
+        return true;
+    }
 
-            });
+    void SimManager::update_once(size_t i, const SimTime& time) const {
+        order[i]->update_previous_values();
+        order[i]->update(time);
+        order[i]->set_converged(true);
+    }
+
+    bool SimManager::run_block(ExecutionBlock& block, const SimTime& time, int& iteration) {
+        if (!block.loop) {
+            update_once(block.begin, time);
+            outgoing[block.begin].run();
+            block.iterations += 1;
+            update_count += 1;
+            return true;
         }
-        if (iteration>max_iterations) {
-            const std::string msg = "超出最大迭代次数"+ std::to_string(iteration);
-            std::cout<<msg<<std::endl<<"请检查输入文件，或修改最大迭代次数"<<std::endl;
-            exit(1);
+
+        int block_iteration = 0;
+        bool converged = false;
+        while (block_iteration<max_iterations && !converged) {
+            // 1. 更新块内模块的前一次输出值
+            for (size_t i = block.begin; i < block.end; ++i) {
+                order[i]->update_previous_values();
+            }
+
+            // 2. 依次计算块内模块，每个模块计算后立即通过 Link 同步它的输出
+            for (size_t i = block.begin; i < block.end; ++i) {
+                order[i]->update(time);
+                outgoing[i].run();
+            }
+
+            // 3. 检查块内每个模块的收敛状态
+            for (size_t i = block.begin; i < block.end; ++i) {
+                order[i]->check_convergence(convergence_threshold);
+            }
+            converged = check_block_convergence(block);
+
+            // 未收敛时恢复非瞬时值（累积量），下次迭代重新从本步开始时的值累积
+            if (converged==false) {
+                for (size_t i = block.begin; i < block.end; ++i) {
+                    order[i]->set_previous_outputs_2_to_current();
+                }
+            }
+            block_iteration += 1;
         }
 
-        //LOG_DEBUG("运行一步结束");
+        block.iterations += block_iteration;
+        update_count += static_cast<long long>(block_iteration) * static_cast<long long>(block.end - block.begin);
+        iteration = std::max(iteration, block_iteration);
+        if (!converged) {
+            std::cout<<"超出最大迭代次数"<<max_iterations<<std::endl<<"请检查输入文件，或修改最大迭代次数"<<std::endl;
+        }
         return converged;
     }
 
-    bool SimManager::check_global_convergence() {
+    bool SimManager::check_block_convergence(const ExecutionBlock& block) const {
         bool all_converged = true;
 
-        SystemStateHub::getInstance().forEachComponent(
-            [&all_converged](const std::string& name, const std::shared_ptr<BaseComponent>& component) {
-                std::cout<<component->getName()<<"收敛情况："<<component->get_converged()<<std::endl;
-                if (!component->get_converged()) {
-                    all_converged = false;  // 标记为未收敛
-                    // 注意：不能提前 return，需继续遍历所有组件
-                }
+        for (size_t i = block.begin; i < block.end; ++i) {
+            std::cout<<order[i]->getName()<<"收敛情况："<<order[i]->get_converged()<<std::endl;
+            if (!order[i]->get_converged()) {
+                all_converged = false;  // 标记为未收敛
+                // 注意：不能提前 return，需继续遍历块内所有组件
             }
-        );
-        std::cout<<"全局收敛："<<all_converged<<std::endl;
+        }
+        std::cout<<"环收敛："<<all_converged<<std::endl;
 
         return all_converged;  // 返回最终结果
     }
 
-    void SimManager::run() {
+    void SimManager::build_schedule() {
+        auto& hub = SystemStateHub::getInstance();
+
+        // 组件按名字排序，保证执行顺序确定（组件表为无序容器）
+        std::vector<std::string> names = hub.getAllComponentNames();
+        std::sort(names.begin(), names.end());
+        std::map<const BaseComponent*, size_t> index;
+        std::vector<std::shared_ptr<BaseComponent>> components;
+        for (const auto& name : names) {
+            index[hub.getComponent(name).get()] = components.size();
+            components.push_back(hub.getComponent(name));
+        }
+
+        // 依赖图：源组件 → 目标组件（同一对组件间的多个连接只算一条边）
+        // 组件声明的直接依赖（不经过连接读取的组件）同样作为边
+        const size_t n = components.size();
+        std::vector<std::set<size_t>> successors(n);
+        std::vector<bool> self_loop(n, false);
+        auto add_edge = [&successors, &self_loop](size_t src, size_t trg) {
+            if (src == trg) {
+                self_loop[src] = true;
+            } else {
+                successors[src].insert(trg);
+            }
+        };
+        for (const auto& link : hub.getLinks()) {
+            add_edge(index.at(link->getSourceComponent().get()), index.at(link->getTargetComponent().get()));
+        }
+        for (size_t v = 0; v < n; ++v) {
+            for (const auto& dependency : components[v]->dependencies()) {
+                if (const auto it = index.find(dependency.get()); it != index.end()) {
+                    add_edge(it->second, v);
+                }
+            }
+        }
+
+        // Tarjan算法求强连通分量
+        constexpr int kUnvisited = -1;
+        std::vector<int> visit_index(n, kUnvisited), low_link(n, 0), scc_of(n, -1);
+        std::vector<bool> on_stack(n, false);
+        std::vector<size_t> stack;
+        int counter = 0, scc_count = 0;
+        std::function<void(size_t)> strong_connect = [&](size_t v) {
+            visit_index[v] = low_link[v] = counter++;
+            stack.push_back(v);
+            on_stack[v] = true;
+            for (const size_t w : successors[v]) {
+                if (visit_index[w] == kUnvisited) {
+                    strong_connect(w);
+                    low_link[v] = std::min(low_link[v], low_link[w]);
+                } else if (on_stack[w]) {
+                    low_link[v] = std::min(low_link[v], visit_index[w]);
+                }
+            }
+            if (low_link[v] == visit_index[v]) {
+                size_t w;
+                do {
+                    w = stack.back();
+                    stack.pop_back();
+                    on_stack[w] = false;
+                    scc_of[w] = scc_count;
+                } while (w != v);
+                scc_count += 1;
+            }
+        };
+        for (size_t v = 0; v < n; ++v) {
+            if (visit_index[v] == kUnvisited) strong_connect(v);
+        }
+
+        // 分量内的组件按名字排序（组件下标即名字顺序）
+        std::vector<std::vector<size_t>> members(scc_count);
+        for (size_t v = 0; v < n; ++v) {
+            members[scc_of[v]].push_back(v);
+        }
+
+        // 分量间的依赖图做Kahn拓扑排序（同层按分量中第一个组件的名字），同时计算依赖深度
+        std::vector<std::set<int>> scc_successors(scc_count);
+        std::vector<int> in_degree(scc_count, 0), level(scc_count, 0);
+        for (size_t v = 0; v < n; ++v) {
+            for (const size_t w : successors[v]) {
+                if (scc_of[v] != scc_of[w] && scc_successors[scc_of[v]].insert(scc_of[w]).second) {
+                    in_degree[scc_of[w]] += 1;
+                }
+            }
+        }
+        std::set<std::pair<size_t, int>> ready;
+        for (int c = 0; c < scc_count; ++c) {
+            if (in_degree[c] == 0) ready.insert({members[c].front(), c});
+        }
+
+        std::vector<int> sorted;
+        dependency_depth = 0;
+        while (!ready.empty()) {
+            const int c = ready.begin()->second;
+            ready.erase(ready.begin());
+            sorted.push_back(c);
+            dependency_depth = std::max(dependency_depth, level[c]);
+            for (const int d : scc_successors[c]) {
+                level[d] = std::max(level[d], level[c] + 1);
+                if (--in_degree[d] == 0) ready.insert({members[d].front(), d});
+            }
+        }
+        // 按依赖层重排（层内保持拓扑排序的顺序），同一层的块互不依赖
+        std::stable_sort(sorted.begin(), sorted.end(), [&level](int a, int b) { return level[a] < level[b]; });
+
+        order.clear();
+        blocks.clear();
+        levels.assign(dependency_depth + 1, ExecutionLevel());
+        std::vector<size_t> position(n);
+        for (const int c : sorted) {
+            ExecutionBlock block;
+            block.begin = order.size();
+            block.loop = members[c].size() > 1 || self_loop[members[c].front()];
+            block.level = level[c];
+            for (const size_t v : members[c]) {
+                position[v] = order.size();
+                order.push_back(components[v]);
+            }
+            block.end = order.size();
+
+            const bool parallel = !block.loop && order[block.begin]->is_thread_safe();
+            (parallel ? levels[block.level].parallel : levels[block.level].serial).push_back(blocks.size());
+            blocks.push_back(block);
+        }
+
+        outgoing.assign(n, LinkPlan());
+        for (const auto& link : hub.getLinks()) {
+            outgoing[position[index.at(link->getSourceComponent().get())]].add(*link);
+        }
+
+        // 使用进程共用的线程池（与组件内的遮挡计算共用，组件在任务中再次并行时不会多开线程）；
+        // 只有某一层有多个可并行组件时才需要
+        size_t widest = 0;
+        for (const auto& level_blocks : levels) {
+            widest = std::max(widest, level_blocks.parallel.size());
+        }
+        pool = widest > 1 ? hub.getThreadPool() : nullptr;
+
+        bool has_loop = false;
+        std::cout << "执行顺序:";
+        for (size_t b = 0; b < blocks.size(); ++b) {
+            const auto& block = blocks[b];
+            has_loop = has_loop || block.loop;
+            if (b > 0 && block.level != blocks[b - 1].level) {
+                std::cout << " |";  // 依赖层分隔
+            }
+            std::cout << " " << (block.loop ? "[" : "");
+            for (size_t i = block.begin; i < block.end; ++i) {
+                std::cout << (i > block.begin ? " " : "") << order[i]->getName();
+            }
+            std::cout << (block.loop ? "]" : "");
+        }
+        std::cout << (has_loop ? "（[]内为代数环，在环内迭代至收敛）" : "（无环，每个时间步一次遍历）") << std::endl;
+        std::cout << "依赖层 " << levels.size() << " 层, 组件并行线程数 " << (pool ? std::min(pool->size(), widest) : 1) << std::endl;
+    }
+
+    void SimManager::report_iterations(const std::string& period_name) {
+        std::cout << period_name << " 迭代统计: " << step_count << " 个时间步共 " << iteration_count
+                  << " 次迭代, 组件计算 " << update_count << " 次" << std::endl;
+
+        bool has_loop = false;
+        for (auto& block : blocks) {
+            if (block.loop) {
+                has_loop = true;
+                std::cout << "  环";
+                for (size_t i = block.begin; i < block.end; ++i) {
+                    std::cout << " " << order[i]->getName();
+                }
+                std::cout << ": " << block.iterations << " 次迭代" << std::endl;
+            }
+            block.iterations = 0;
+        }
+
+        const auto n = static_cast<long long>(order.size());
+        if (has_loop) {
+            // 估计值（并未实际运行）：整个模型一起迭代时按相同的迭代次数计，每次迭代都要计算所有组件
+            const long long whole = iteration_count * n;
+            std::cout << "  只在环内迭代估计节省组件计算 " << whole - update_count
+                      << " 次（估计值：整体迭代约需 " << whole << " 次）" << std::endl;
+        } else {
+            // 估计值（并未实际运行）：各模块同时计算、计算后统一同步时（Jacobi），新值每次迭代只能沿依赖链前进一层，
+            // 最坏需要 依赖深度+1 次迭代传播到末端，再加1次确认收敛；实际所需次数取决于各模块的收敛判据
+            const long long jacobi = step_count * (dependency_depth + 2);
+            std::cout << "  按依赖顺序执行比逐次同步估计节省 " << jacobi - iteration_count
+                      << " 次迭代（估计值：逐次同步最坏需 " << jacobi << " 次）" << std::endl;
+        }
+    }
+
+    std::vector<SimManager::BlockInfo> SimManager::schedule() const {
+        std::vector<BlockInfo> infos(blocks.size());
+        for (size_t b = 0; b < blocks.size(); ++b) {
+            infos[b].loop = blocks[b].loop;
+            infos[b].level = blocks[b].level;
+            for (size_t i = blocks[b].begin; i < blocks[b].end; ++i) {
+                infos[b].components.push_back(order[i]->getName());
+            }
+        }
+        for (const auto& level : levels) {
+            for (const size_t b : level.parallel) {
+                infos[b].parallel = true;
+            }
+        }
+        return infos;
+    }
+
+    void SimManager::prepare() {
         SystemStateHub::getInstance().forEachComponent([](const std::string& name, const std::shared_ptr<core::BaseComponent>& component) {
             component->awake();
         });
 
+        // 各组件的变量已定义，检查连接（连接到不存在的变量时在此报错），再按执行顺序编译各组件的连接
+        SystemStateHub::getInstance().validate_links();
+        build_schedule();
+        // 连接已编译为槽位指针，冻结各组件的变量存储（此后新建变量会使指针悬空）
+        SystemStateHub::getInstance().forEachComponent([](const std::string& name, const std::shared_ptr<core::BaseComponent>& component) {
+            component->freeze_vars();
+        });
+    }
+
+    void SimManager::run() {
+        prepare();
+
         time.timeDelta = this->timestep;
 
         for (const auto& run_period : this->run_periods) {
-            //std::cout<<run_period<<std::endl;
+            time.setRunPeriod(run_period);
 
-            time.currentTime = 0;
+            // 使用解析后的时间数据
+            std::cout<< run_period.name << " Start date: " << time.startYear << "-"
+                      << time.startMonth << "-" << time.startDay << " ";
+            std::cout << "End date: " << time.endYear << "-"
+                      << time.endMonth << "-" << time.endDay << std::endl;
 
-            // 解析时间参数
+            step_count = 0;
+            iteration_count = 0;
+            update_count = 0;
             try {
-                // 使用get<std::string>()先获取字符串，再转为整数
-                time.startYear = std::stoi(run_period["params"][0].get<std::string>());
-                time.startMonth = std::stoi(run_period["params"][1].get<std::string>());
-                time.startDay = std::stoi(run_period["params"][2].get<std::string>());
-                time.endYear = std::stoi(run_period["params"][3].get<std::string>());
-                time.endMonth = std::stoi(run_period["params"][4].get<std::string>());
-                time.endDay = std::stoi(run_period["params"][5].get<std::string>());
-
-                time.calcEndTime();
-
-                // 使用解析后的时间数据
-                std::cout<< run_period["object_name"].get<std::string>() << " Start date: " << time.startYear << "-"
-                          << time.startMonth << "-" << time.startDay << " ";
-                std::cout << "End date: " << time.endYear << "-"
-                          << time.endMonth << "-" << time.endDay << std::endl;
-
                 while (time.currentTime<=time.endTime) {
                     if (!run_a_step(time)) {
                         std::cout<<"收敛失败"<<std::endl;
@@ -183,14 +466,10 @@ namespace core {
                     }
                     time.advanceTime();
                 }
-
             } catch (const std::exception& e) {
-                std::cerr << "Error parsing time parameters: " << e.what() << std::endl;
+                std::cerr << "Error running " << run_period.name << ": " << e.what() << std::endl;
             }
-
-
-
-
+            report_iterations(run_period.name);
         }
 
 
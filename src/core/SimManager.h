@@ -5,6 +5,12 @@
 #ifndef SIMMANAGER_H
 #define SIMMANAGER_H
 
+#include <memory>
+#include <vector>
+
+#include <ThreadPool.h>
+
+#include "Link.h"
 #include "SimTime.h"
 #include "SystemStateHub.h"
 
@@ -15,7 +21,44 @@ class SimManager {
     int max_iterations = 50;
     double timestep=3600.0;
 
-    json run_periods;
+    std::vector<RunPeriod> run_periods;
+
+    // 执行块：连接构成的依赖图按强连通分量划分，块按拓扑顺序排列；
+    // 块内组件为order中的区间[begin, end)，loop为真表示组件间有代数环，块内迭代至收敛
+    struct ExecutionBlock {
+        size_t begin = 0;
+        size_t end = 0;
+        bool loop = false;
+        int level = 0;             // 依赖层：上游块的最大层+1
+        long long iterations = 0;  // 本模拟时段内的累计迭代次数
+    };
+
+    // 执行顺序（Gauss-Seidel）：每个组件update后立即同步它的输出连接，下游组件在同一步内用到新值
+    std::vector<std::shared_ptr<BaseComponent>> order;
+    std::vector<LinkPlan> outgoing;  // 与order对应：各组件作为源的连接
+    std::vector<ExecutionBlock> blocks;
+    int dependency_depth = 0;        // 执行块之间最长依赖链的连接数
+
+    // 依赖层：同一层的块之间没有连接，只依赖前面各层
+    // parallel为不在环上且线程安全的组件所在块，在线程池中同时计算；其余块（环、非线程安全组件）依次执行
+    struct ExecutionLevel {
+        std::vector<size_t> parallel;  // blocks下标
+        std::vector<size_t> serial;
+    };
+    std::vector<ExecutionLevel> levels;
+    std::shared_ptr<util::ThreadPool> pool;  // 进程共用的线程池（单线程或没有可并行的层时为空）
+
+    // 迭代统计（每个模拟时段输出一次）
+    long long step_count = 0;
+    long long iteration_count = 0;   // 各时间步中迭代最多的块的迭代次数之和（无环的时间步记1次）
+    long long update_count = 0;      // 组件计算次数
+
+    void build_schedule();
+    bool run_level(const ExecutionLevel& level, const SimTime& time, int& iteration);
+    bool run_block(ExecutionBlock& block, const SimTime& time, int& iteration);
+    void update_once(size_t i, const SimTime& time) const;
+    bool check_block_convergence(const ExecutionBlock& block) const;
+    void report_iterations(const std::string& period_name);
 public:
     SimTime time;
 
@@ -24,8 +67,20 @@ public:
 
     void parse_file(const std::string& in_file);
 
+    // 初始化：各组件awake，检查连接并按执行顺序编译，冻结各组件的变量存储（run开始时调用）
+    void prepare();
+
+    // 调度结果中的一个执行块（用于检查调度）：组件名按块内执行顺序排列，
+    // parallel为真表示与同一依赖层的其他并行块在线程池中同时计算
+    struct BlockInfo {
+        std::vector<std::string> components;
+        bool loop = false;
+        int level = 0;
+        bool parallel = false;
+    };
+    [[nodiscard]] std::vector<BlockInfo> schedule() const;
+
     bool run_a_step(const SimTime& time);
-    static bool check_global_convergence();
     void run();
 };
 
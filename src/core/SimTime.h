@@ -8,9 +8,21 @@
 #include <tuple>
 #include <cmath>
 #include <iomanip>
+#include <string>
 
 
 namespace core {
+// 模拟时段（起止日期均包含在内）
+struct RunPeriod {
+    std::string name;
+    int startYear = 2025;
+    int startMonth = 1;
+    int startDay = 1;
+    int endYear = 2025;
+    int endMonth = 1;
+    int endDay = 1;
+};
+
 class SimTime {
 public:
     double currentTime = 0; //当前时间sec
@@ -34,6 +46,18 @@ public:
     }
     ~SimTime()=default;
 
+    // 设置模拟时段并从头开始计时
+    void setRunPeriod(const RunPeriod& period) {
+        startYear = period.startYear;
+        startMonth = period.startMonth;
+        startDay = period.startDay;
+        endYear = period.endYear;
+        endMonth = period.endMonth;
+        endDay = period.endDay;
+        currentTime = 0;
+        calcEndTime();
+    }
+
     void calcEndTime() {
         double endTimeDays = daysBetweenDates(startYear, startMonth, startDay, endYear, endMonth, endDay);
         if (endTimeDays>0) {
@@ -60,4 +60,12 @@ namespace core {
 
         return true;
     }
+
+    void SystemStateHub::validate_links() const {
+        for (const auto& link : links) {
+            VarRef source_ref, target_ref;
+            link->resolve(source_ref, target_ref);
+        }
+        std::cout << "连接检查完成: " << links.size() << " 个变量连接" << std::endl;
+    }
 } // namespace core
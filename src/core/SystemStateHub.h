@@ -5,6 +5,10 @@
 #include <vector>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
+
+#include <ThreadPool.h>
 
 #include "BaseComponent.h"
 #include "Link.h"
@@ -15,10 +19,18 @@ namespace core {
     private:
         // 存储组件的映射表
         std::unordered_map<std::string, std::shared_ptr<BaseComponent>> components;
-        // Link
+        // Link（由SimManager按源组件编译为槽位复制）
         std::vector<std::shared_ptr<Link>> links;
         // Site
         std::shared_ptr<Site> site;
+        // 计算线程数（1为串行，<=0为全部硬件线程）
+        int num_threads = 1;
+        // 进程共用的线程池：遮挡计算、网格细分与同一依赖层组件的并行计算都在其中执行（单线程时为空）
+        std::shared_ptr<util::ThreadPool> thread_pool;
+        std::mutex thread_pool_mutex;
+        // 模拟时段与时间步长（秒）
+        std::vector<RunPeriod> run_periods;
+        double timestep = 3600.0;
 
         // 私有构造函数和拷贝控制
         SystemStateHub() {
@@ -62,15 +74,14 @@ namespace core {
         bool createLink(const std::string& source_component, const std::string& source_variable,
              const std::string& target_component, const std::string& target_variable);
 
-        void update_links() const {
+        // 检查所有连接两端的变量（须在各组件awake之后调用），变量不存在或类型不兼容时抛出异常
+        void validate_links() const;
 
-            for (const auto& link : links) {
-                link->update();
-            }
+        const std::vector<std::shared_ptr<Link>>& getLinks() const {
+            return links;
         }
 
 
-
         //地理位置
         void setSite(const json& site_info) const {
             site->name = site_info["name"].get<std::string>();
@@ -84,5 +95,40 @@ namespace core {
             return site;
         }
 
+        //线程数（须在创建使用线程池的组件之前设置）
+        void setNumThreads(int threads) {
+            std::lock_guard<std::mutex> lock(thread_pool_mutex);
+            num_threads = threads;
+            thread_pool.reset();
+        }
+
+        int getNumThreads() const {
+            return num_threads;
+        }
+
+        // 进程共用的线程池（首次使用时按线程数创建，单线程时为空）
+        std::shared_ptr<util::ThreadPool> getThreadPool() {
+            std::lock_guard<std::mutex> lock(thread_pool_mutex);
+            const size_t n = util::ThreadPool::resolve_thread_count(num_threads);
+            if (!thread_pool && n > 1) {
+                thread_pool = std::make_shared<util::ThreadPool>(n);
+            }
+            return thread_pool;
+        }
+
+        //模拟时段
+        void setRunPeriods(const std::vector<RunPeriod>& periods, double step) {
+            run_periods = periods;
+            timestep = step;
+        }
+
+        const std::vector<RunPeriod>& getRunPeriods() const {
+            return run_periods;
+        }
+
+        double getTimestep() const {
+            return timestep;
+        }
+
     };
 } // namespace core
@@ -0,0 +1,180 @@
+//
+// Created by zhou on 25-7-21.
+//
+
+#include "VariableStore.h"
+
+namespace core {
+
+    VarType parse_var_type(const std::string& type_name, const json& value) {
+        if (type_name.empty()) {
+            if (value.is_boolean()) return VarType::Bool;
+            if (value.is_string()) return VarType::String;
+            return VarType::Double;
+        }
+        if (type_name == "double" || type_name == "float") return VarType::Double;
+        if (type_name == "int") return VarType::Int;
+        if (type_name == "bool") return VarType::Bool;
+        if (type_name == "string") return VarType::String;
+        throw std::runtime_error("未知的变量类型: " + type_name);
+    }
+
+    VarRef VariableStore::define(const std::string& name, const json& def) {
+        const bool is_def = def.is_object();
+        const json value = is_def ? def.value("value", json()) : def;
+        const std::string type_name = is_def && def.contains("type") ? def["type"].get<std::string>() : "";
+        const VarType type = parse_var_type(type_name, value);
+
+        size_t idx;
+        if (const auto it = index_.find(name); it != index_.end()) {
+            idx = it->second;
+            // 类型改变时换用新槽位（旧槽位废弃，已解析的句柄随之失效，只应在配置阶段发生）
+            if (vars_[idx].ref.type != type) {
+                vars_[idx].ref = allocate(type, name);
+            }
+        } else {
+            idx = vars_.size();
+            vars_.push_back({name, "", allocate(type, name), -1});
+            previous_.push_back(0.0);
+            index_[name] = idx;
+        }
+
+        Info& var = vars_[idx];
+        var.type_name = type_name;
+        var.inst = is_def && def.contains("isInstValue") ? (def["isInstValue"] == true ? 1 : 0) : -1;
+        if (!value.is_null()) {
+            store(var.ref, value, name);
+        }
+        if (var.ref.type != VarType::String) {
+            previous_[idx] = number(var.ref);
+        }
+        return var.ref;
+    }
+
+    void VariableStore::assign(const std::string& name, const json& value) {
+        if (const auto it = index_.find(name); it != index_.end()) {
+            store(vars_[it->second].ref, value, name);
+        } else {
+            define(name, json{{"value", value}});
+        }
+    }
+
+    const VariableStore::Info& VariableStore::info(const std::string& name) const {
+        const auto it = index_.find(name);
+        if (it == index_.end()) {
+            throw std::out_of_range("变量不存在: " + name);
+        }
+        return vars_[it->second];
+    }
+
+    const void* VariableStore::address(VarRef ref) const {
+        switch (ref.type) {
+            case VarType::Double: return &doubles_[ref.slot];
+            case VarType::Int:    return &ints_[ref.slot];
+            case VarType::Bool:   return &bools_[ref.slot];
+            default:              return &strings_[ref.slot];
+        }
+    }
+
+    double VariableStore::number(VarRef ref) const {
+        switch (ref.type) {
+            case VarType::Double: return doubles_[ref.slot];
+            case VarType::Int:    return ints_[ref.slot];
+            case VarType::Bool:   return bools_[ref.slot] != 0 ? 1.0 : 0.0;
+            default: throw std::runtime_error("字符串变量不能作为数值使用");
+        }
+    }
+
+    void VariableStore::setNumber(VarRef ref, double value) {
+        switch (ref.type) {
+            case VarType::Double: doubles_[ref.slot] = value; break;
+            case VarType::Int:    ints_[ref.slot] = static_cast<int>(value); break;
+            case VarType::Bool:   bools_[ref.slot] = value != 0.0 ? 1 : 0; break;
+            default: throw std::runtime_error("字符串变量不能作为数值使用");
+        }
+    }
+
+    void VariableStore::snapshot(int inst) {
+        for (size_t i = 0; i < vars_.size(); ++i) {
+            if (vars_[i].inst == inst && vars_[i].ref.type != VarType::String) {
+                previous_[i] = number(vars_[i].ref);
+            }
+        }
+    }
+
+    void VariableStore::restore(int inst) {
+        for (size_t i = 0; i < vars_.size(); ++i) {
+            if (vars_[i].inst == inst && vars_[i].ref.type != VarType::String) {
+                setNumber(vars_[i].ref, previous_[i]);
+            }
+        }
+    }
+
+    bool VariableStore::hasInst(int inst) const {
+        for (const auto& var : vars_) {
+            if (var.inst == inst) return true;
+        }
+        return false;
+    }
+
+    json VariableStore::valueJson(VarRef ref) const {
+        switch (ref.type) {
+            case VarType::Double: return doubles_[ref.slot];
+            case VarType::Int:    return ints_[ref.slot];
+            case VarType::Bool:   return bools_[ref.slot] != 0;
+            default:              return strings_[ref.slot];
+        }
+    }
+
+    json VariableStore::toJson(const std::string& name) const {
+        const Info& var = info(name);
+        json j = {{"name", var.name}, {"value", valueJson(var.ref)}};
+        if (!var.type_name.empty()) j["type"] = var.type_name;
+        if (var.inst >= 0) j["isInstValue"] = var.inst == 1;
+        return j;
+    }
+
+    json VariableStore::toJson() const {
+        json j = json::object();
+        for (const auto& var : vars_) {
+            j[var.name] = toJson(var.name);
+        }
+        return j;
+    }
+
+    VarRef VariableStore::allocate(VarType type, const std::string& name) {
+        if (frozen_) {
+            throw std::runtime_error("变量槽位已冻结（连接已编译），不能再新建变量或改变变量类型: " + name);
+        }
+        VarRef ref{type, 0};
+        switch (type) {
+            case VarType::Double: ref.slot = static_cast<uint32_t>(doubles_.size()); doubles_.push_back(0.0); break;
+            case VarType::Int:    ref.slot = static_cast<uint32_t>(ints_.size()); ints_.push_back(0); break;
+            case VarType::Bool:   ref.slot = static_cast<uint32_t>(bools_.size()); bools_.push_back(0); break;
+            default:              ref.slot = static_cast<uint32_t>(strings_.size()); strings_.emplace_back(); break;
+        }
+        return ref;
+    }
+
+    void VariableStore::store(VarRef ref, const json& value, const std::string& name) {
+        const bool numeric = value.is_number() || value.is_boolean();
+        switch (ref.type) {
+            case VarType::Double:
+                if (!numeric) throw std::runtime_error("变量 " + name + " 的值应为数值: " + value.dump());
+                doubles_[ref.slot] = value.is_boolean() ? (value.get<bool>() ? 1.0 : 0.0) : value.get<double>();
+                break;
+            case VarType::Int:
+                if (!numeric) throw std::runtime_error("变量 " + name + " 的值应为整数: " + value.dump());
+                ints_[ref.slot] = value.is_boolean() ? (value.get<bool>() ? 1 : 0) : value.get<int>();
+                break;
+            case VarType::Bool:
+                if (!numeric) throw std::runtime_error("变量 " + name + " 的值应为布尔值: " + value.dump());
+                bools_[ref.slot] = value.is_boolean() ? value.get<bool>() : value.get<double>() != 0.0;
+                break;
+            default:
+                strings_[ref.slot] = value.is_string() ? value.get<std::string>() : value.dump();
+                break;
+        }
+    }
+
+}
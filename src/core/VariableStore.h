@@ -0,0 +1,173 @@
+//
+// Created by zhou on 25-7-21.
+//
+
+#ifndef VARIABLESTORE_H
+#define VARIABLESTORE_H
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <json.hpp>
+
+using json = nlohmann::json;
+
+namespace core {
+
+    // 变量类型（对应变量定义中的"type"字段）
+    enum class VarType { Double, Int, Bool, String };
+
+    // 变量句柄：在awake/parse时按名字解析一次，之后按槽位下标直接读写
+    template <typename T>
+    struct Var {
+        static constexpr uint32_t kInvalid = std::numeric_limits<uint32_t>::max();
+        uint32_t slot = kInvalid;
+
+        [[nodiscard]] bool valid() const { return slot != kInvalid; }
+    };
+
+    using DoubleVar = Var<double>;
+    using IntVar = Var<int>;
+    using BoolVar = Var<bool>;
+    using StringVar = Var<std::string>;
+
+    // 类型无关的变量引用（连接、收敛判断等需要按类型分派的场合）
+    struct VarRef {
+        VarType type = VarType::Double;
+        uint32_t slot = Var<double>::kInvalid;
+
+        [[nodiscard]] bool valid() const { return slot != Var<double>::kInvalid; }
+    };
+
+    // 组件变量存储：按类型分开的连续槽位（double/int/bool，字符串只用于配置），
+    // 变量名只在定义和解析句柄时使用；json形式只用于配置和调试输出
+    // 每个变量可声明isInstValue：瞬时值在每次迭代前记录上一次的值，非瞬时值（累积量）在时间步收敛后记录
+    class VariableStore {
+    public:
+        // 变量的元数据
+        struct Info {
+            std::string name;
+            std::string type_name;  // 定义中的类型名（原样保留用于json输出）
+            VarRef ref;
+            int inst = -1;          // isInstValue：-1未声明，1瞬时值，0非瞬时值
+        };
+
+        // 按json定义 {"name", "type", "value", "isInstValue"} 声明变量；同名变量已存在且类型相同时沿用原槽位
+        VarRef define(const std::string& name, const json& def);
+
+        // 设置变量值（配置时使用），变量不存在时按值的类型新建
+        void assign(const std::string& name, const json& value);
+
+        [[nodiscard]] bool contains(const std::string& name) const { return index_.contains(name); }
+        [[nodiscard]] bool empty() const { return vars_.empty(); }
+        [[nodiscard]] size_t size() const { return vars_.size(); }
+        [[nodiscard]] const std::vector<Info>& vars() const { return vars_; }
+
+        // 按名字查找变量（找不到抛出异常）
+        [[nodiscard]] const Info& info(const std::string& name) const;
+        [[nodiscard]] VarRef ref(const std::string& name) const { return info(name).ref; }
+
+        // 按名字解析类型化句柄（找不到或类型不符时抛出异常）
+        template <typename T>
+        [[nodiscard]] Var<T> handle(const std::string& name) const {
+            const Info& var = info(name);
+            if (var.ref.type != type_of<T>()) {
+                throw std::runtime_error("变量类型不匹配: " + name);
+            }
+            return Var<T>{var.ref.slot};
+        }
+
+        // 读写槽位（热路径，不检查句柄）
+        template <typename T>
+        [[nodiscard]] T get(Var<T> var) const {
+            if constexpr (std::is_same_v<T, bool>) {
+                return bools_[var.slot] != 0;
+            } else {
+                return slots<T>()[var.slot];
+            }
+        }
+
+        template <typename T>
+        void set(Var<T> var, const T& value) {
+            if constexpr (std::is_same_v<T, bool>) {
+                bools_[var.slot] = value ? 1 : 0;
+            } else {
+                slots<T>()[var.slot] = value;
+            }
+        }
+
+        // 槽位地址（bool槽位为uint8_t），供连接编译为直接复制；之后须freeze，不得再定义新变量（槽位数组不能扩容）
+        [[nodiscard]] const void* address(VarRef ref) const;
+        [[nodiscard]] void* address(VarRef ref) {
+            return const_cast<void*>(std::as_const(*this).address(ref));
+        }
+
+        // 冻结槽位：此后新建变量或改变变量类型（需要分配槽位）时抛出异常，已有变量的读写不受影响
+        // 连接编译为槽位指针后调用，防止槽位数组扩容使指针悬空
+        void freeze() { frozen_ = true; }
+        [[nodiscard]] bool frozen() const { return frozen_; }
+
+        // 数值变量按double读写（收敛判断与上一次值的记录使用）
+        [[nodiscard]] double number(VarRef ref) const;
+        void setNumber(VarRef ref, double value);
+
+        // 记录/恢复上一次的值：inst为1时处理瞬时值，为0时处理非瞬时值
+        void snapshot(int inst);
+        void restore(int inst);
+        [[nodiscard]] double previous(size_t var_index) const { return previous_[var_index]; }
+        [[nodiscard]] bool hasInst(int inst) const;
+
+        // json视图（配置与调试用）
+        [[nodiscard]] json valueJson(VarRef ref) const;
+        [[nodiscard]] json toJson(const std::string& name) const;
+        [[nodiscard]] json toJson() const;
+
+    private:
+        std::vector<Info> vars_;
+        std::unordered_map<std::string, size_t> index_;  // 变量名 → vars_下标
+        std::vector<double> previous_;                   // 各变量上一次的值（与vars_对应，非数值变量不用）
+
+        std::vector<double> doubles_;
+        std::vector<int> ints_;
+        std::vector<uint8_t> bools_;
+        std::vector<std::string> strings_;
+        bool frozen_ = false;
+
+        template <typename T>
+        static constexpr VarType type_of() {
+            if constexpr (std::is_same_v<T, double>) return VarType::Double;
+            else if constexpr (std::is_same_v<T, int>) return VarType::Int;
+            else if constexpr (std::is_same_v<T, bool>) return VarType::Bool;
+            else return VarType::String;
+        }
+
+        template <typename T>
+        std::vector<T>& slots() {
+            if constexpr (std::is_same_v<T, double>) return doubles_;
+            else if constexpr (std::is_same_v<T, int>) return ints_;
+            else return strings_;
+        }
+
+        template <typename T>
+        const std::vector<T>& slots() const {
+            if constexpr (std::is_same_v<T, double>) return doubles_;
+            else if constexpr (std::is_same_v<T, int>) return ints_;
+            else return strings_;
+        }
+
+        VarRef allocate(VarType type, const std::string& name);
+        void store(VarRef ref, const json& value, const std::string& name);
+    };
+
+    // 类型名 → 变量类型（未知类型抛出异常）；type_name为空时按值推断
+    VarType parse_var_type(const std::string& type_name, const json& value);
+
+}
+
+#endif //VARIABLESTORE_H
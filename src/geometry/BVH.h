@@ -0,0 +1,315 @@
+//
+// Created by zhou on 25-7-8.
+//
+
+#ifndef BVH_H
+#define BVH_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "OccluderBuffer.h"
+#include "Point3D.h"
+#include "SimdKernel.h"
+
+namespace geom {
+
+// 轴对齐包围盒
+struct AABB {
+    Point3D min{ std::numeric_limits<double>::max(),  std::numeric_limits<double>::max(),  std::numeric_limits<double>::max()};
+    Point3D max{-std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(), -std::numeric_limits<double>::max()};
+
+    void grow(const Point3D& p) {
+        min = Point3D(std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z));
+        max = Point3D(std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z));
+    }
+
+    void grow(const AABB& b) {
+        if (b.empty()) return;
+        grow(b.min);
+        grow(b.max);
+    }
+
+    [[nodiscard]] bool empty() const {
+        return min.x > max.x;
+    }
+
+    [[nodiscard]] Point3D centroid() const {
+        return (min + max) * 0.5;
+    }
+
+    // 表面积（SAH代价计算用）
+    [[nodiscard]] double surface_area() const {
+        if (empty()) return 0.0;
+        const Point3D d = max - min;
+        return 2.0 * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    // 射线-包围盒相交（slab算法），inv_dir为方向分量的倒数
+    [[nodiscard]] bool intersect(const Point3D& origin, const Point3D& inv_dir, double t_max) const {
+        double t_near = -std::numeric_limits<double>::infinity();
+        double t_far = std::numeric_limits<double>::infinity();
+        return clip_slab(min.x, max.x, origin.x, inv_dir.x, t_near, t_far) &&
+               clip_slab(min.y, max.y, origin.y, inv_dir.y, t_near, t_far) &&
+               clip_slab(min.z, max.z, origin.z, inv_dir.z, t_near, t_far) &&
+               t_far >= t_near && t_far >= 0.0 && t_near <= t_max;
+    }
+
+private:
+    // 用一个轴的slab裁剪射线参数区间
+    // 方向分量为0时（inv为±inf）射线与slab平行：起点在slab内（含边界）则不限制，否则不相交
+    // 不能直接相乘：起点恰在slab平面上时0*inf为NaN，min/max的结果取决于参数顺序
+    static bool clip_slab(double lo, double hi, double o, double inv, double& t_near, double& t_far) {
+        if (std::isinf(inv)) {
+            return o >= lo && o <= hi;
+        }
+        double t1 = (lo - o) * inv;
+        double t2 = (hi - o) * inv;
+        if (t1 > t2) std::swap(t1, t2);
+        t_near = std::max(t_near, t1);
+        t_far = std::min(t_far, t2);
+        return true;
+    }
+};
+
+// 遮挡三角形包围盒（世界坐标），按尺寸外扩一点，保证与Möller-Trumbore的epsilon容差一致
+template <typename T>
+AABB occluder_bounds(const BasicOccluderBuffer<T>& occluders, size_t i) {
+    AABB box;
+    box.min = occluders.bounds_min(i);
+    box.max = occluders.bounds_max(i);
+    const Point3D d = box.max - box.min;
+    const double pad = std::max({d.x, d.y, d.z}) * 1e-6 + 1e-9;
+    box.min = box.min - Point3D(pad, pad, pad);
+    box.max = box.max + Point3D(pad, pad, pad);
+    return box;
+}
+
+// 扁平化的BVH节点：count>0为叶子（first为三角形起始下标），否则left_first为左子节点下标，右子节点紧随其后
+struct BVHNode {
+    AABB bounds;
+    uint32_t left_first = 0;
+    uint32_t count = 0;
+
+    [[nodiscard]] bool is_leaf() const { return count > 0; }
+};
+
+// 遮挡物包围体层次结构（SAH分箱构建，节点连续存储）
+class BVH {
+public:
+    static constexpr uint32_t kMaxLeafSize = 8;   // 叶子最多容纳的三角形数（与AVX-512宽度一致）
+    static constexpr int kBinCount = 16;          // SAH分箱数
+    static constexpr int kMaxDepth = 60;          // 最大深度（遍历栈容量为64）
+
+    BVH() = default;
+
+    // 由遮挡物缓冲区构建BVH，缓冲区会按叶子顺序原地重排
+    void build(OccluderBuffer& occluders) {
+        nodes_.clear();
+        triangle_count_ = occluders.size();
+        if (occluders.empty()) return;
+
+        const size_t n = occluders.size();
+        std::vector<AABB> prim_bounds(n);
+        std::vector<Point3D> centroids(n);
+        std::vector<uint32_t> indices(n);
+        for (size_t i = 0; i < n; ++i) {
+            prim_bounds[i] = occluder_bounds(occluders, i);
+            centroids[i] = prim_bounds[i].centroid();
+            indices[i] = static_cast<uint32_t>(i);
+        }
+
+        nodes_.reserve(2 * n);
+        nodes_.emplace_back();
+        nodes_[0].left_first = 0;
+        nodes_[0].count = static_cast<uint32_t>(n);
+        update_bounds(0, prim_bounds, indices);
+        subdivide(0, 0, prim_bounds, centroids, indices);
+        nodes_.shrink_to_fit();
+
+        occluders.permute(indices);
+    }
+
+    // 任意命中查询：射线在(epsilon, +inf)内与任一非skip_id的三角形相交即返回true
+    // occluders必须是构建本BVH时使用（并已重排）的缓冲区，或由它转换的单精度缓冲区
+    // 节点遍历始终用双精度世界坐标，只有叶子内求交使用缓冲区的精度
+    template <typename T>
+    [[nodiscard]] bool any_hit(const BasicOccluderBuffer<T>& occluders, const Point3D& origin, const Point3D& dir,
+                               int skip_id) const {
+        uint64_t tests = 0;
+        return first_hit(occluders, origin, dir, skip_id, tests) >= 0;
+    }
+
+    // 同any_hit，返回命中三角形的下标（无命中返回-1），tests累加射线-三角形求交次数
+    template <typename T>
+    [[nodiscard]] int64_t first_hit(const BasicOccluderBuffer<T>& occluders, const Point3D& origin, const Point3D& dir,
+                                    int skip_id, uint64_t& tests) const {
+        if (nodes_.empty()) return -1;
+
+        // 求交用的局部坐标（每条射线转换一次）
+        const Vec3<T> local_origin = occluders.local_point(origin);
+        const Vec3<T> local_dir = occluders.local_dir(dir);
+
+        const Point3D inv_dir(1.0 / dir.x, 1.0 / dir.y, 1.0 / dir.z);
+        constexpr double t_max = std::numeric_limits<double>::infinity();
+
+        std::array<uint32_t, 64> stack{};
+        int sp = 0;
+        stack[sp++] = 0;
+
+        while (sp > 0) {
+            const BVHNode& node = nodes_[stack[--sp]];
+            if (!node.bounds.intersect(origin, inv_dir, t_max)) continue;
+
+            if (node.is_leaf()) {
+                // 叶子内的三角形一次向量化求交（自遮挡判断：跳过id==skip_id的三角形）
+                const int64_t hit = simd::first_hit(occluders, node.left_first, node.count, local_origin, local_dir, skip_id);
+                if (hit >= 0) {
+                    tests += hit - node.left_first + 1;
+                    return hit;
+                }
+                tests += node.count;
+            } else {
+                stack[sp++] = node.left_first;
+                stack[sp++] = node.left_first + 1;
+            }
+        }
+        return -1;
+    }
+
+    [[nodiscard]] bool empty() const { return nodes_.empty(); }
+    [[nodiscard]] size_t triangle_count() const { return triangle_count_; }
+    [[nodiscard]] size_t node_count() const { return nodes_.size(); }
+    [[nodiscard]] const std::vector<BVHNode>& nodes() const { return nodes_; }
+
+private:
+    std::vector<BVHNode> nodes_;
+    size_t triangle_count_ = 0;
+
+    void update_bounds(uint32_t node_idx, const std::vector<AABB>& prim_bounds,
+                       const std::vector<uint32_t>& indices) {
+        BVHNode& node = nodes_[node_idx];
+        node.bounds = AABB();
+        for (uint32_t i = node.left_first; i < node.left_first + node.count; ++i) {
+            node.bounds.grow(prim_bounds[indices[i]]);
+        }
+    }
+
+    // 划分方案：沿axis轴，质心落在[0, bin)号箱内的图元划到左侧
+    struct SplitPlan {
+        int axis = -1;
+        int bin = 0;
+        double lo = 0.0;
+        double scale = 0.0;
+        double cost = std::numeric_limits<double>::max();
+
+        [[nodiscard]] int bin_of(const Point3D& c) const {
+            return std::min(kBinCount - 1, static_cast<int>((axis_of(c, axis) - lo) * scale));
+        }
+    };
+
+    // 分箱SAH：在三个轴上寻找代价最小的划分
+    SplitPlan find_best_split(const BVHNode& node, const std::vector<AABB>& prim_bounds,
+                              const std::vector<Point3D>& centroids, const std::vector<uint32_t>& indices) const {
+        SplitPlan best;
+
+        AABB centroid_bounds;
+        for (uint32_t i = node.left_first; i < node.left_first + node.count; ++i) {
+            centroid_bounds.grow(centroids[indices[i]]);
+        }
+
+        for (int axis = 0; axis < 3; ++axis) {
+            const double lo = axis_of(centroid_bounds.min, axis);
+            const double hi = axis_of(centroid_bounds.max, axis);
+            if (hi - lo < 1e-12) continue;
+
+            SplitPlan plan;
+            plan.axis = axis;
+            plan.lo = lo;
+            plan.scale = kBinCount / (hi - lo);
+
+            std::array<AABB, kBinCount> bins{};
+            std::array<uint32_t, kBinCount> counts{};
+            for (uint32_t i = node.left_first; i < node.left_first + node.count; ++i) {
+                const uint32_t idx = indices[i];
+                const int b = plan.bin_of(centroids[idx]);
+                bins[b].grow(prim_bounds[idx]);
+                counts[b]++;
+            }
+
+            // 从左右两侧累积，得到每个划分平面两边的面积与数量
+            std::array<double, kBinCount - 1> left_area{}, right_area{};
+            std::array<uint32_t, kBinCount - 1> left_count{}, right_count{};
+            AABB left_box, right_box;
+            uint32_t left_sum = 0, right_sum = 0;
+            for (int i = 0; i < kBinCount - 1; ++i) {
+                left_sum += counts[i];
+                left_box.grow(bins[i]);
+                left_count[i] = left_sum;
+                left_area[i] = left_box.surface_area();
+
+                right_sum += counts[kBinCount - 1 - i];
+                right_box.grow(bins[kBinCount - 1 - i]);
+                right_count[kBinCount - 2 - i] = right_sum;
+                right_area[kBinCount - 2 - i] = right_box.surface_area();
+            }
+
+            for (int i = 0; i < kBinCount - 1; ++i) {
+                if (left_count[i] == 0 || right_count[i] == 0) continue;
+                const double cost = left_count[i] * left_area[i] + right_count[i] * right_area[i];
+                if (cost < best.cost) {
+                    best = plan;
+                    best.bin = i + 1;
+                    best.cost = cost;
+                }
+            }
+        }
+        return best;
+    }
+
+    void subdivide(uint32_t node_idx, int depth, const std::vector<AABB>& prim_bounds,
+                   const std::vector<Point3D>& centroids, std::vector<uint32_t>& indices) {
+        if (nodes_[node_idx].count <= kMaxLeafSize || depth >= kMaxDepth) return;
+
+        const SplitPlan plan = find_best_split(nodes_[node_idx], prim_bounds, centroids, indices);
+        if (plan.axis < 0) return;  // 质心重合，无法再划分
+
+        // 不划分时的代价；叶子过大时强制划分
+        const double leaf_cost = nodes_[node_idx].count * nodes_[node_idx].bounds.surface_area();
+        if (plan.cost >= leaf_cost && nodes_[node_idx].count <= 4 * kMaxLeafSize) return;
+
+        const uint32_t first = nodes_[node_idx].left_first;
+        const uint32_t count = nodes_[node_idx].count;
+        const auto mid_it = std::partition(indices.begin() + first, indices.begin() + first + count,
+                                           [&](uint32_t idx) { return plan.bin_of(centroids[idx]) < plan.bin; });
+        const auto left_count = static_cast<uint32_t>(mid_it - (indices.begin() + first));
+        if (left_count == 0 || left_count == count) return;
+
+        const auto left_idx = static_cast<uint32_t>(nodes_.size());
+        nodes_.emplace_back();
+        nodes_.emplace_back();
+        nodes_[left_idx].left_first = first;
+        nodes_[left_idx].count = left_count;
+        nodes_[left_idx + 1].left_first = first + left_count;
+        nodes_[left_idx + 1].count = count - left_count;
+        nodes_[node_idx].left_first = left_idx;
+        nodes_[node_idx].count = 0;
+
+        update_bounds(left_idx, prim_bounds, indices);
+        update_bounds(left_idx + 1, prim_bounds, indices);
+        subdivide(left_idx, depth + 1, prim_bounds, centroids, indices);
+        subdivide(left_idx + 1, depth + 1, prim_bounds, centroids, indices);
+    }
+
+    static double axis_of(const Point3D& p, int axis) {
+        return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+    }
+};
+
+}
+
+#endif //BVH_H
@@ -0,0 +1,165 @@
+//
+// Created by zhou on 25-7-21.
+//
+
+#ifndef GEOMETRYREGISTRY_H
+#define GEOMETRYREGISTRY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ShadowCache.h"
+#include "SharedGeometry.h"
+#include "SurfaceGroup.h"
+
+namespace geom {
+
+// 计算参数的摘要：参数相同的分组得到的遮挡结果相同，可以共享
+inline uint64_t shading_options_digest(const ShadingOptions& options) {
+    Fnv1a64 h;
+    h.update_value(static_cast<int>(options.mode));
+    h.update_value(options.sky_altitude_step);
+    h.update_value(options.sky_azimuth_step);
+    h.update_value(static_cast<int>(options.occlusion_method));
+    h.update_value(options.raster_resolution);
+    h.update_value(options.adaptive_tolerance);
+    h.update_value(options.adaptive_max_depth);
+    h.update_value(static_cast<int>(options.sample_mode));
+    h.update_value(options.progressive_tolerance);
+    h.update_value(options.progressive_start_level);
+    h.update_value(static_cast<int>(options.precision));
+    return h.digest();
+}
+
+// 进程内的几何注册表：同一STL文件（规范路径+内容哈希）只解析一次、遮挡场景只构建一次；
+// 内容哈希按（规范路径, 文件大小, 修改时间）记忆，文件未变时不再重读整个文件；
+// 各表面的分析结果按计算参数登记，再次请求同一表面时共享已有分组，只为尚未分析的表面新建分组
+// 注册表只持有弱引用，几何与分析结果随最后一个使用者释放
+class GeometryRegistry {
+public:
+    // 一个表面的查询句柄：分析它的分组及其在分组中的ID（STL中没有该表面时为-1）
+    struct SurfaceHandle {
+        std::shared_ptr<SurfaceGroup> group;
+        int id = -1;
+    };
+
+    static GeometryRegistry& getInstance() {
+        static GeometryRegistry instance;
+        return instance;
+    }
+
+    // 取得STL文件的共享几何，文件内容变化后视为新的几何
+    std::shared_ptr<const SharedGeometry> acquireGeometry(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return acquire_geometry(path).first;
+    }
+
+    // 取得各表面的查询句柄（与surfaces一一对应）；尚未以相同计算参数分析过的表面
+    // 合并为一个新分组（名为name，缓存文件为name_shd.bin）一次分析
+    // 分析在持锁期间进行，并发请求依次执行；新分组使用pool（进程共用的线程池，为空时串行）
+    std::vector<SurfaceHandle> acquireSurfaces(const std::string& name, const std::string& path,
+                                               const std::vector<std::string>& surfaces,
+                                               std::shared_ptr<util::ThreadPool> pool = nullptr,
+                                               const ShadingOptions& options = {}) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto [geometry, entry] = acquire_geometry(path);
+        auto& analyzed = entry->surfaces[shading_options_digest(options)];
+
+        std::vector<SurfaceHandle> handles(surfaces.size());
+        std::vector<std::string> missing;
+        for (size_t i = 0; i < surfaces.size(); ++i) {
+            const auto it = analyzed.find(surfaces[i]);
+            if (it != analyzed.end()) {
+                handles[i].group = it->second.lock();
+            }
+            if (!handles[i].group && std::ranges::find(missing, surfaces[i]) == missing.end()) {
+                missing.push_back(surfaces[i]);
+            }
+        }
+
+        if (!missing.empty()) {
+            if (missing.size() < surfaces.size()) {
+                std::cout << "共享已分析的 " << surfaces.size() - missing.size() << " 个表面, 新分析 "
+                          << missing.size() << " 个表面: " << geometry->path() << std::endl;
+            }
+            const auto group = std::make_shared<SurfaceGroup>(name, geometry, missing, pool, options);
+            for (const auto& surface : missing) {
+                analyzed[surface] = group;
+            }
+            for (size_t i = 0; i < surfaces.size(); ++i) {
+                if (!handles[i].group) handles[i].group = group;
+            }
+        } else {
+            std::cout << "共享已分析的 " << surfaces.size() << " 个表面: " << geometry->path() << std::endl;
+        }
+
+        for (size_t i = 0; i < surfaces.size(); ++i) {
+            handles[i].id = handles[i].group->getSurfaceId(surfaces[i]);
+        }
+        return handles;
+    }
+
+private:
+    struct GeometryEntry {
+        std::weak_ptr<const SharedGeometry> geometry;
+        // 计算参数摘要 → 表面名 → 分析该表面的分组
+        std::map<uint64_t, std::map<std::string, std::weak_ptr<SurfaceGroup>>> surfaces;
+    };
+
+    // 文件状态：大小与修改时间都未变时沿用上次的内容哈希
+    struct FileStamp {
+        uintmax_t size = 0;
+        std::filesystem::file_time_type mtime;
+        uint64_t content_hash = 0;
+    };
+
+    std::mutex mutex_;
+    std::map<std::pair<std::string, uint64_t>, GeometryEntry> entries_;  // (规范路径, 内容哈希) → 几何
+    std::map<std::string, FileStamp> stamps_;                             // 规范路径 → 文件状态
+
+    GeometryRegistry() = default;
+
+    // 须持锁调用
+    std::pair<std::shared_ptr<const SharedGeometry>, GeometryEntry*> acquire_geometry(const std::string& path) {
+        // 清理已无人使用的几何
+        std::erase_if(entries_, [](const auto& item) { return item.second.geometry.expired(); });
+
+        const std::string canonical = std::filesystem::weakly_canonical(path).string();
+        const uint64_t content_hash = content_hash_of(canonical);
+        GeometryEntry& entry = entries_[{canonical, content_hash}];
+        auto geometry = entry.geometry.lock();
+        if (geometry) {
+            std::cout << "共享已解析的STL文件: " << canonical << std::endl;
+        } else {
+            geometry = std::make_shared<const SharedGeometry>(canonical, content_hash);
+            entry.geometry = geometry;
+            entry.surfaces.clear();
+        }
+        return {geometry, &entry};
+    }
+
+    // 须持锁调用；文件大小或修改时间变化时才重新计算内容哈希
+    uint64_t content_hash_of(const std::string& canonical) {
+        const uintmax_t size = std::filesystem::file_size(canonical);
+        const auto mtime = std::filesystem::last_write_time(canonical);
+        FileStamp& stamp = stamps_[canonical];
+        if (stamp.content_hash == 0 || stamp.size != size || stamp.mtime != mtime) {
+            stamp.content_hash = hash_file_content(canonical);
+            stamp.size = size;
+            stamp.mtime = mtime;
+        }
+        return stamp.content_hash;
+    }
+};
+
+}
+
+#endif //GEOMETRYREGISTRY_H
@@ -0,0 +1,227 @@
+//
+// Created by zhou on 25-7-14.
+//
+
+#ifndef OCCLUDERBUFFER_H
+#define OCCLUDERBUFFER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <vector>
+
+#include "Point3D.h"
+#include "Triangle.h"
+
+namespace geom {
+
+// 按Alignment字节对齐分配内存的分配器（用于缓存行/向量寄存器对齐）
+template <typename T, size_t Alignment>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() noexcept = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* p, size_t) noexcept {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T, 64>>;
+
+// 扁平化的遮挡物缓冲区：所有遮挡三角形按分量连续存放（64字节对齐），
+// 预先计算边向量、包围盒和所属表面ID，每个ShadowAnalyzer只构建一次
+// 末尾补齐kPadding个退化三角形，使向量化读取不会越界
+// 按标量类型模板化：单精度缓冲区的坐标相对局部原点origin存放（平移后坐标小，float精度足够），
+// 双精度缓冲区的局部原点为零
+template <typename T>
+struct BasicOccluderBuffer {
+    static constexpr size_t kPadding = 16;  // 一个AVX-512单精度向量的宽度
+
+    // 顶点0与两条边（Möller-Trumbore求交用）
+    AlignedVector<T> v0x, v0y, v0z;
+    AlignedVector<T> e1x, e1y, e1z;
+    AlignedVector<T> e2x, e2y, e2z;
+    // 包围盒
+    AlignedVector<T> min_x, min_y, min_z;
+    AlignedVector<T> max_x, max_y, max_z;
+    // 所属表面ID（用于自遮挡判断）
+    AlignedVector<int> ids;
+    // 局部原点（世界坐标 = 存放坐标 + origin）
+    Point3D origin;
+    // 射线起点沿法向的偏移：须大于坐标舍入误差，避免与共面的相邻三角形相交
+    double ray_bias = 1e-5;
+
+    [[nodiscard]] size_t size() const { return count_; }
+    [[nodiscard]] bool empty() const { return count_ == 0; }
+
+    void build(const std::vector<Triangle>& triangles) {
+        resize(triangles.size());
+        for (size_t i = 0; i < triangles.size(); ++i) {
+            set(i, triangles[i]);
+        }
+    }
+
+    void build(const StlModel& model) {
+        size_t n = 0;
+        for (const auto& [solidName, triangles] : model) {
+            n += triangles.size();
+        }
+        resize(n);
+        size_t i = 0;
+        for (const auto& [solidName, triangles] : model) {
+            for (const auto& tri : triangles) {
+                set(i++, tri);
+            }
+        }
+    }
+
+    // 由双精度缓冲区转换（保持顺序），局部原点取包围盒中心
+    void convert(const BasicOccluderBuffer<double>& source) {
+        resize(source.size());
+        origin = Point3D();
+        ray_bias = source.ray_bias;
+        if (!source.empty()) {
+            Point3D lo = source.bounds_min(0), hi = source.bounds_max(0);
+            for (size_t i = 1; i < source.size(); ++i) {
+                const Point3D a = source.bounds_min(i), b = source.bounds_max(i);
+                lo = Point3D(std::min(lo.x, a.x), std::min(lo.y, a.y), std::min(lo.z, a.z));
+                hi = Point3D(std::max(hi.x, b.x), std::max(hi.y, b.y), std::max(hi.z, b.z));
+            }
+            origin = (lo + hi) * 0.5;
+            // 偏移取局部坐标最大值处舍入误差的若干倍
+            const Point3D half = (hi - lo) * 0.5;
+            const double radius = std::max({half.x, half.y, half.z});
+            ray_bias = std::max(ray_bias, 16.0 * std::numeric_limits<T>::epsilon() * radius);
+        }
+        for (size_t i = 0; i < source.size(); ++i) {
+            const Point3D v0 = source.vertex0(i) - origin;
+            const Point3D e1 = source.edge1(i), e2 = source.edge2(i);
+            const Point3D lo = source.bounds_min(i) - origin, hi = source.bounds_max(i) - origin;
+            v0x[i] = static_cast<T>(v0.x); v0y[i] = static_cast<T>(v0.y); v0z[i] = static_cast<T>(v0.z);
+            e1x[i] = static_cast<T>(e1.x); e1y[i] = static_cast<T>(e1.y); e1z[i] = static_cast<T>(e1.z);
+            e2x[i] = static_cast<T>(e2.x); e2y[i] = static_cast<T>(e2.y); e2z[i] = static_cast<T>(e2.z);
+            // 包围盒向外取整，保证包含转换后的三角形
+            min_x[i] = round_down(lo.x); min_y[i] = round_down(lo.y); min_z[i] = round_down(lo.z);
+            max_x[i] = round_up(hi.x); max_y[i] = round_up(hi.y); max_z[i] = round_up(hi.z);
+            ids[i] = source.ids[i];
+        }
+    }
+
+    // 世界坐标点/方向转换为本缓冲区的局部坐标
+    [[nodiscard]] Vec3<T> local_point(const Point3D& p) const { return (p - origin).template cast<T>(); }
+    [[nodiscard]] static Vec3<T> local_dir(const Point3D& d) { return d.template cast<T>(); }
+
+    // 以下均返回世界坐标
+    [[nodiscard]] Point3D vertex0(size_t i) const { return Point3D(v0x[i], v0y[i], v0z[i]) + origin; }
+    [[nodiscard]] Point3D edge1(size_t i) const { return Point3D(e1x[i], e1y[i], e1z[i]); }
+    [[nodiscard]] Point3D edge2(size_t i) const { return Point3D(e2x[i], e2y[i], e2z[i]); }
+    [[nodiscard]] Point3D bounds_min(size_t i) const { return Point3D(min_x[i], min_y[i], min_z[i]) + origin; }
+    [[nodiscard]] Point3D bounds_max(size_t i) const { return Point3D(max_x[i], max_y[i], max_z[i]) + origin; }
+
+    // 由另一缓冲区中选出的三角形构建（indices为源缓冲区下标，保持给定顺序）
+    void gather(const BasicOccluderBuffer& source, const std::vector<uint32_t>& indices) {
+        resize(indices.size());
+        origin = source.origin;
+        ray_bias = source.ray_bias;
+        const auto dst = scalar_arrays();
+        const auto src = source.scalar_arrays();
+        for (size_t a = 0; a < dst.size(); ++a) {
+            for (size_t k = 0; k < indices.size(); ++k) (*dst[a])[k] = (*src[a])[indices[k]];
+        }
+        for (size_t k = 0; k < indices.size(); ++k) ids[k] = source.ids[indices[k]];
+    }
+
+    // 按给定顺序重排（order[k]为新位置k处的原下标）
+    void permute(const std::vector<uint32_t>& order) {
+        for (auto* arr : scalar_arrays()) {
+            AlignedVector<T> tmp(arr->size(), T(0));
+            for (size_t k = 0; k < order.size(); ++k) tmp[k] = (*arr)[order[k]];
+            *arr = std::move(tmp);
+        }
+        AlignedVector<int> tmp_ids(ids.size(), -1);
+        for (size_t k = 0; k < order.size(); ++k) tmp_ids[k] = ids[order[k]];
+        ids = std::move(tmp_ids);
+    }
+
+    // 占用内存（字节）
+    [[nodiscard]] size_t memory_bytes() const {
+        return (count_ + kPadding) * (15 * sizeof(T) + sizeof(int));
+    }
+
+private:
+    size_t count_ = 0;
+
+    std::vector<AlignedVector<T>*> scalar_arrays() {
+        return {&v0x, &v0y, &v0z, &e1x, &e1y, &e1z, &e2x, &e2y, &e2z,
+                &min_x, &min_y, &min_z, &max_x, &max_y, &max_z};
+    }
+
+    [[nodiscard]] std::vector<const AlignedVector<T>*> scalar_arrays() const {
+        return {&v0x, &v0y, &v0z, &e1x, &e1y, &e1z, &e2x, &e2y, &e2z,
+                &min_x, &min_y, &min_z, &max_x, &max_y, &max_z};
+    }
+
+    void resize(size_t n) {
+        count_ = n;
+        for (auto* arr : scalar_arrays()) {
+            arr->assign(n + kPadding, T(0));
+        }
+        ids.assign(n + kPadding, -1);
+    }
+
+    static T round_down(double v) {
+        const T r = static_cast<T>(v);
+        return static_cast<double>(r) > v ? std::nextafter(r, -std::numeric_limits<T>::infinity()) : r;
+    }
+
+    static T round_up(double v) {
+        const T r = static_cast<T>(v);
+        return static_cast<double>(r) < v ? std::nextafter(r, std::numeric_limits<T>::infinity()) : r;
+    }
+
+    void set(size_t i, const Triangle& tri) {
+        const Point3D v0 = tri.vertices[0] - origin;
+        const Point3D e1 = tri.vertices[1] - tri.vertices[0];
+        const Point3D e2 = tri.vertices[2] - tri.vertices[0];
+        v0x[i] = v0.x; v0y[i] = v0.y; v0z[i] = v0.z;
+        e1x[i] = e1.x; e1y[i] = e1.y; e1z[i] = e1.z;
+        e2x[i] = e2.x; e2y[i] = e2.y; e2z[i] = e2.z;
+
+        min_x[i] = max_x[i] = v0.x;
+        min_y[i] = max_y[i] = v0.y;
+        min_z[i] = max_z[i] = v0.z;
+        for (int k = 1; k < 3; ++k) {
+            const Point3D v = tri.vertices[k] - origin;
+            min_x[i] = std::min<T>(min_x[i], v.x); max_x[i] = std::max<T>(max_x[i], v.x);
+            min_y[i] = std::min<T>(min_y[i], v.y); max_y[i] = std::max<T>(max_y[i], v.y);
+            min_z[i] = std::min<T>(min_z[i], v.z); max_z[i] = std::max<T>(max_z[i], v.z);
+        }
+        ids[i] = tri.id;
+    }
+};
+
+using OccluderBuffer = BasicOccluderBuffer<double>;
+using OccluderBufferF = BasicOccluderBuffer<float>;
+
+}
+
+#endif //OCCLUDERBUFFER_H
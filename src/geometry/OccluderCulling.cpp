@@ -0,0 +1,5 @@
+//
+// Created by zhou on 25-7-19.
+//
+
+#include "OccluderCulling.h"
@@ -0,0 +1,268 @@
+//
+// Created by zhou on 25-7-19.
+//
+
+#ifndef OCCLUDERCULLING_H
+#define OCCLUDERCULLING_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "BVH.h"
+#include "OccluderBuffer.h"
+#include "Point3D.h"
+#include "SimdKernel.h"
+#include "TriangleMesh.h"
+
+namespace geom {
+
+// 接收区域：一组接收网格（同一任务单元）的包围盒；若所有面共面且法向一致，同时记录该平面
+struct ReceiverBounds {
+    AABB box;
+    bool planar = false;
+    Point3D normal;       // 平面单位法向
+    double offset = 0.0;  // 平面方程 normal·x = offset
+
+    static ReceiverBounds from_meshes(const SolidMesh& meshes, size_t begin, size_t end) {
+        return from_parents([&](auto&& visit) {
+            for (size_t mesh_idx = begin; mesh_idx < end; ++mesh_idx) {
+                const TriangleMesh mesh = meshes[mesh_idx];
+                if (!mesh.faces.empty()) visit(mesh.vertices, mesh.normal);
+            }
+        });
+    }
+
+    // 流式采样：细分面都在原三角形内，只需原三角形的三个顶点
+    static ReceiverBounds from_samples(const SampleSolid& solid, size_t begin, size_t end) {
+        return from_parents([&](auto&& visit) {
+            for (size_t parent_idx = begin; parent_idx < end; ++parent_idx) {
+                const SampleParent& parent = solid.parents[parent_idx];
+                const Point3D corners[3] = {parent.v1, parent.v2, parent.v3};
+                visit(std::span<const Point3D>(corners), parent.normal);
+            }
+        });
+    }
+
+private:
+    // for_each(visit)对每个父三角形调用visit(顶点序列, 法向量)
+    template <typename ForEach>
+    static ReceiverBounds from_parents(ForEach&& for_each) {
+        ReceiverBounds bounds;
+        bool have_normal = false;
+        bounds.planar = true;
+        for_each([&](std::span<const Point3D> vertices, const Point3D& normal) {
+            for (const auto& v : vertices) {
+                bounds.box.grow(v);
+            }
+            const Point3D unit = normal.normalize();
+            if (!have_normal) {
+                bounds.normal = unit;
+                have_normal = true;
+            } else if (unit.dot(bounds.normal) < 1.0 - 1e-9) {
+                bounds.planar = false;
+            }
+        });
+        if (!have_normal || bounds.box.empty()) {
+            bounds.planar = false;
+            return bounds;
+        }
+
+        // 所有顶点都须落在同一平面上
+        if (bounds.planar) {
+            const Point3D extent = bounds.box.max - bounds.box.min;
+            const double tol = extent.magnitude() * 1e-9 + 1e-9;
+            double lo = std::numeric_limits<double>::max(), hi = -lo;
+            for_each([&](std::span<const Point3D> vertices, const Point3D&) {
+                for (const auto& v : vertices) {
+                    const double d = bounds.normal.dot(v);
+                    lo = std::min(lo, d);
+                    hi = std::max(hi, d);
+                }
+            });
+            bounds.planar = hi - lo <= tol;
+            bounds.offset = lo;
+        }
+        return bounds;
+    }
+};
+
+// 接收区域沿太阳方向扫掠形成的半无限柱体（包围盒沿sun_dir拉伸到无穷远）
+// 从区域内任一点射向太阳的射线都在该柱体内，柱体之外的遮挡物不可能挡住这些射线
+// 判定是保守的：只会多留，不会错删
+class SweptVolume {
+public:
+    SweptVolume(const ReceiverBounds& receiver, const Point3D& sun_dir)
+        : dir_(sun_dir), planar_(receiver.planar), normal_(receiver.normal) {
+        const Point3D helper = std::fabs(dir_.z) < 0.9 ? Point3D(0, 0, 1) : Point3D(1, 0, 0);
+        u_ = helper.cross(dir_).normalize();
+        v_ = dir_.cross(u_);
+
+        // 射线起点沿法向偏移1e-5，外扩量需覆盖该偏移及舍入误差
+        const Point3D extent = receiver.box.max - receiver.box.min;
+        pad_ = extent.magnitude() * 1e-6 + 1e-4;
+        project(receiver.box, u_, u0_, u1_);
+        project(receiver.box, v_, v0_, v1_);
+        double w1 = 0.0;
+        project(receiver.box, dir_, w0_, w1);
+        offset_ = receiver.offset;
+    }
+
+    // 包围盒（BVH节点）是否可能与扫掠体相交
+    [[nodiscard]] bool may_block(const AABB& box) const {
+        double lo, hi;
+        project(box, u_, lo, hi);
+        if (hi < u0_ - pad_ || lo > u1_ + pad_) return false;
+        project(box, v_, lo, hi);
+        if (hi < v0_ - pad_ || lo > v1_ + pad_) return false;
+        project(box, dir_, lo, hi);
+        if (hi < w0_ - pad_) return false;
+        if (planar_) {
+            // 整个包围盒都在接收平面背后
+            project(box, normal_, lo, hi);
+            if (hi < offset_ - pad_) return false;
+        }
+        return true;
+    }
+
+    // 三角形是否可能与扫掠体相交（按顶点投影范围判断，比包围盒更紧）
+    [[nodiscard]] bool may_block(const Point3D& a, const Point3D& b, const Point3D& c) const {
+        const double tri_pad = pad_ + std::max({(b - a).magnitude(), (c - a).magnitude()}) * 1e-6;
+        if (!overlaps(a, b, c, u_, u0_ - tri_pad, u1_ + tri_pad)) return false;
+        if (!overlaps(a, b, c, v_, v0_ - tri_pad, v1_ + tri_pad)) return false;
+        if (std::max({a.dot(dir_), b.dot(dir_), c.dot(dir_)}) < w0_ - tri_pad) return false;
+        if (planar_ && std::max({a.dot(normal_), b.dot(normal_), c.dot(normal_)}) < offset_ - tri_pad) return false;
+        return true;
+    }
+
+private:
+    Point3D dir_, u_, v_;
+    bool planar_;
+    Point3D normal_;
+    double offset_ = 0.0;
+    double u0_ = 0.0, u1_ = 0.0;
+    double v0_ = 0.0, v1_ = 0.0;
+    double w0_ = 0.0;
+    double pad_ = 0.0;
+
+    // 包围盒在轴axis上的投影范围
+    static void project(const AABB& box, const Point3D& axis, double& lo, double& hi) {
+        const Point3D c = box.centroid();
+        const Point3D e = (box.max - box.min) * 0.5;
+        const double center = c.dot(axis);
+        const double radius = e.x * std::fabs(axis.x) + e.y * std::fabs(axis.y) + e.z * std::fabs(axis.z);
+        lo = center - radius;
+        hi = center + radius;
+    }
+
+    static bool overlaps(const Point3D& a, const Point3D& b, const Point3D& c, const Point3D& axis,
+                         double lo, double hi) {
+        const double pa = a.dot(axis), pb = b.dot(axis), pc = c.dot(axis);
+        return std::max({pa, pb, pc}) >= lo && std::min({pa, pb, pc}) <= hi;
+    }
+};
+
+// 一个(太阳方向, 接收区域)的候选遮挡物：剔除后剩余三角形的紧凑副本，
+// 按原BVH叶子分组（每组带收紧后的包围盒），逐面判定只需线性扫描这些分组
+// 分组数超过kMaxLeaves时不启用（剔除效果差，逐面判定继续使用全局BVH）
+// 副本与全局遮挡物缓冲区精度相同
+template <typename T>
+struct BasicOccluderCandidates {
+    static constexpr size_t kMaxLeaves = 256;
+    static constexpr size_t kMaxBruteForce = 64;  // 候选不超过此数时合并为一组，逐面直接向量化求交
+
+    struct Leaf {
+        AABB bounds;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    bool active = false;
+    BasicOccluderBuffer<T> buffer;
+    std::vector<Leaf> leaves;
+    std::vector<uint32_t> indices;  // 候选在全局遮挡物缓冲区中的下标
+
+    void reset() {
+        active = false;
+        leaves.clear();
+        indices.clear();
+    }
+
+    // 射线与候选遮挡物的任意命中查询（跳过id==skip_id的三角形），判定与BVH::any_hit一致
+    // 返回命中三角形在全局遮挡物缓冲区中的下标（无命中返回-1），tests累加求交次数
+    [[nodiscard]] int64_t first_hit(const Point3D& origin, const Point3D& dir, int skip_id, uint64_t& tests) const {
+        const Point3D inv_dir(1.0 / dir.x, 1.0 / dir.y, 1.0 / dir.z);
+        constexpr double t_max = std::numeric_limits<double>::infinity();
+        const Vec3<T> local_origin = buffer.local_point(origin);
+        const Vec3<T> local_dir = buffer.local_dir(dir);
+        for (const Leaf& leaf : leaves) {
+            if (!leaf.bounds.intersect(origin, inv_dir, t_max)) continue;
+            const int64_t hit = simd::first_hit(buffer, leaf.first, leaf.count, local_origin, local_dir, skip_id);
+            if (hit >= 0) {
+                tests += hit - leaf.first + 1;
+                return indices[hit];
+            }
+            tests += leaf.count;
+        }
+        return -1;
+    }
+};
+
+using OccluderCandidates = BasicOccluderCandidates<double>;
+
+// 通过BVH遍历收集可能遮挡接收区域的遮挡物（剪掉与扫掠体不相交的子树）
+template <typename T>
+void cull_occluders(const BasicOccluderBuffer<T>& occluders, const BVH& bvh, const ReceiverBounds& receiver,
+                    const Point3D& sun_dir, BasicOccluderCandidates<T>& candidates) {
+    candidates.reset();
+    if (receiver.box.empty()) return;
+
+    const SweptVolume volume(receiver, sun_dir);
+    const auto& nodes = bvh.nodes();
+    if (!nodes.empty()) {
+        std::vector<uint32_t> stack;
+        stack.push_back(0);
+        while (!stack.empty()) {
+            const BVHNode& node = nodes[stack.back()];
+            stack.pop_back();
+            if (!volume.may_block(node.bounds)) continue;
+
+            if (node.is_leaf()) {
+                typename BasicOccluderCandidates<T>::Leaf leaf{AABB(), static_cast<uint32_t>(candidates.indices.size()), 0};
+                for (uint32_t i = node.left_first; i < node.left_first + node.count; ++i) {
+                    const Point3D a = occluders.vertex0(i);
+                    if (volume.may_block(a, a + occluders.edge1(i), a + occluders.edge2(i))) {
+                        candidates.indices.push_back(i);
+                        leaf.bounds.grow(occluder_bounds(occluders, i));
+                        ++leaf.count;
+                    }
+                }
+                if (leaf.count == 0) continue;
+                // 分组过多时剔除收益有限，直接放弃
+                if (candidates.leaves.size() >= BasicOccluderCandidates<T>::kMaxLeaves) {
+                    candidates.reset();
+                    return;
+                }
+                candidates.leaves.push_back(leaf);
+            } else {
+                stack.push_back(node.left_first);
+                stack.push_back(node.left_first + 1);
+            }
+        }
+    }
+
+    if (candidates.indices.size() <= BasicOccluderCandidates<T>::kMaxBruteForce && candidates.leaves.size() > 1) {
+        typename BasicOccluderCandidates<T>::Leaf all{AABB(), 0, static_cast<uint32_t>(candidates.indices.size())};
+        for (const auto& leaf : candidates.leaves) all.bounds.grow(leaf.bounds);
+        candidates.leaves.assign(1, all);
+    }
+    candidates.buffer.gather(occluders, candidates.indices);
+    candidates.active = true;
+}
+
+}
+
+#endif //OCCLUDERCULLING_H
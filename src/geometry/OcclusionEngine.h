@@ -0,0 +1,228 @@
+//
+// Created by zhou on 25-7-18.
+//
+
+#ifndef OCCLUSIONENGINE_H
+#define OCCLUSIONENGINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "BVH.h"
+#include "OccluderBuffer.h"
+#include "OccluderCulling.h"
+#include "Point3D.h"
+#include "Triangle.h"
+#include "TriangleMesh.h"
+
+namespace geom {
+
+// 遮挡判定方法
+enum class OcclusionMethod {
+    RayCast,  // 每个面向太阳投射一条射线（BVH加速，精确）
+    Raster,   // 沿太阳方向光栅化遮挡物深度图，按深度比较判定（近似，与面数无关）
+};
+
+inline const char* occlusion_method_name(OcclusionMethod method) {
+    return method == OcclusionMethod::Raster ? "raster" : "raycast";
+}
+
+inline OcclusionMethod parse_occlusion_method(const std::string& name) {
+    if (name == "raycast") return OcclusionMethod::RayCast;
+    if (name == "raster") return OcclusionMethod::Raster;
+    throw std::runtime_error("未知的遮挡判定方法: " + name);
+}
+
+// 遮挡求交的浮点精度
+enum class GeometryPrecision {
+    Double,  // 双精度（默认）
+    Float,   // 单精度：遮挡物按局部坐标存放，内存减半、向量宽度加倍
+};
+
+inline const char* geometry_precision_name(GeometryPrecision precision) {
+    return precision == GeometryPrecision::Float ? "float" : "double";
+}
+
+// 遮挡场景：扁平化的遮挡物及射线投射用的BVH（构建BVH时遮挡物按叶子顺序重排）
+// 需要单精度求交时另存一份由双精度缓冲区转换的单精度副本（顺序相同，共用同一BVH）
+// 构建后只读，可在多个分析器、多个引擎之间共享
+struct OccluderScene {
+    OccluderBuffer occluders;
+    OccluderBufferF occluders_f;  // with_float为false时为空
+    BVH bvh;  // with_bvh为false时为空
+
+    [[nodiscard]] bool has_bvh() const { return occluders.empty() || !bvh.nodes().empty(); }
+    [[nodiscard]] bool has_float() const { return occluders_f.size() == occluders.size(); }
+
+    // 指定精度的遮挡物缓冲区
+    template <typename T>
+    [[nodiscard]] const BasicOccluderBuffer<T>& buffer() const {
+        if constexpr (std::is_same_v<T, float>) {
+            return occluders_f;
+        } else {
+            return occluders;
+        }
+    }
+
+    static std::shared_ptr<const OccluderScene> build(OccluderBuffer occluders, bool with_bvh,
+                                                      bool with_float = false) {
+        auto scene = std::make_shared<OccluderScene>();
+        scene->occluders = std::move(occluders);
+        if (with_bvh) {
+            scene->bvh.build(scene->occluders);
+        }
+        // 在BVH重排之后转换，保证两份缓冲区下标一致
+        if (with_float) {
+            scene->occluders_f.convert(scene->occluders);
+        }
+        return scene;
+    }
+
+    // 复制已有场景并补上缺少的BVH或单精度副本（已有的部分保留）
+    static std::shared_ptr<const OccluderScene> extend(const OccluderScene& base, bool with_bvh, bool with_float) {
+        auto scene = std::make_shared<OccluderScene>(base);
+        if (with_bvh && !scene->has_bvh()) {
+            scene->bvh.build(scene->occluders);
+            scene->occluders_f = OccluderBufferF();  // 重排后原副本失效
+        }
+        if ((with_float || base.has_float()) && !scene->has_float()) {
+            scene->occluders_f.convert(scene->occluders);
+        }
+        return scene;
+    }
+
+    static std::shared_ptr<const OccluderScene> build(const StlModel& model, bool with_bvh,
+                                                      bool with_float = false) {
+        OccluderBuffer occluders;
+        occluders.build(model);
+        return build(std::move(occluders), with_bvh, with_float);
+    }
+};
+
+// 遮挡判定统计（用于观察求交次数与命中缓存的效果）
+struct OcclusionStats {
+    uint64_t faces = 0;           // 判定的面数
+    uint64_t rays = 0;            // 实际投射的射线数（不含背向太阳的面）
+    uint64_t triangle_tests = 0;  // 射线-三角形求交次数（含命中缓存的测试）
+    uint64_t cache_tests = 0;     // 命中缓存测试次数
+    uint64_t last_hits = 0;       // 被上一个面的遮挡物挡住
+    uint64_t angle_hits = 0;      // 被相邻太阳角度下本面的遮挡物挡住
+
+    void merge(const OcclusionStats& other) {
+        faces += other.faces;
+        rays += other.rays;
+        triangle_tests += other.triangle_tests;
+        cache_tests += other.cache_tests;
+        last_hits += other.last_hits;
+        angle_hits += other.angle_hits;
+    }
+
+    [[nodiscard]] double tests_per_ray() const {
+        return rays > 0 ? static_cast<double>(triangle_tests) / rays : 0.0;
+    }
+
+    [[nodiscard]] double cache_hit_rate() const {
+        return cache_tests > 0 ? static_cast<double>(last_hits + angle_hits) / cache_tests : 0.0;
+    }
+};
+
+// 逐面判定的上下文（每个任务一份，不跨线程共享）：候选遮挡物、命中缓存与统计
+// 命中缓存记录的是全局遮挡物下标，相邻的面/相邻的太阳角度往往被同一个三角形挡住，先测它
+struct OcclusionContext {
+    OccluderCandidates candidates;
+    BasicOccluderCandidates<float> candidates_f;  // 单精度引擎使用
+    int64_t last_hit = -1;   // 上一个面的遮挡物
+    int64_t angle_hit = -1;  // 本面在上一个太阳角度下的遮挡物（由调用方按面设置）
+    int64_t hit = -1;        // 输出：挡住本面的遮挡物（未遮挡、背向或引擎不提供时为-1）
+    OcclusionStats stats;
+
+    template <typename T>
+    [[nodiscard]] BasicOccluderCandidates<T>& candidates_for() {
+        if constexpr (std::is_same_v<T, float>) {
+            return candidates_f;
+        } else {
+            return candidates;
+        }
+    }
+};
+
+// 遮挡判定引擎接口
+// 使用流程：build(遮挡场景) → 每批太阳方向 prepare(槽位, 方向) → 并发调用 occluded(..., 槽位)
+// 逐面判定前可对每个(太阳方向, 接收区域)调用一次cull，之后用occluded_in判定（剔除+命中缓存）
+class OcclusionEngine {
+public:
+    virtual ~OcclusionEngine() = default;
+
+    [[nodiscard]] virtual OcclusionMethod method() const = 0;
+
+    // 是否需要遮挡场景带BVH
+    [[nodiscard]] virtual bool needs_bvh() const { return false; }
+
+    // 求交精度（单精度引擎需要遮挡场景带单精度副本）
+    [[nodiscard]] virtual GeometryPrecision precision() const { return GeometryPrecision::Double; }
+
+    // 绑定遮挡场景（引擎持有其共享引用），每个场景一次
+    virtual void build(std::shared_ptr<const OccluderScene> scene) = 0;
+
+    // 每批可同时准备的太阳方向数，0表示不限（prepare无开销）
+    [[nodiscard]] virtual size_t batch_size(size_t num_threads) const { return 0; }
+
+    // 预留slots个槽位（在并发prepare之前调用）
+    virtual void reserve(size_t slots) {}
+
+    // 为槽位slot准备太阳方向（不同槽位可并发调用）
+    virtual void prepare(size_t slot, const Point3D& sun_dir) {}
+
+    // 判断采样点是否被遮挡（背向太阳也视为遮挡），slot为prepare时的槽位；可并发调用
+    [[nodiscard]] virtual bool occluded(const SurfaceSample& sample, const Point3D& sun_dir, size_t slot) const = 0;
+
+    // 为一个接收区域剔除不可能产生遮挡的遮挡物，结果写入context.candidates；默认不剔除
+    virtual void cull(const ReceiverBounds& receiver, const Point3D& sun_dir,
+                      OcclusionContext& context) const {
+        context.candidates.reset();
+        context.candidates_f.reset();
+    }
+
+    // 在上下文中判定（使用候选遮挡物和命中缓存），结果与occluded一致
+    [[nodiscard]] virtual bool occluded_in(OcclusionContext& context, const SurfaceSample& sample,
+                                           const Point3D& sun_dir, size_t slot) const {
+        ++context.stats.faces;
+        context.hit = -1;
+        return occluded(sample, sun_dir, slot);
+    }
+};
+
+// 计算单个采样点的受照余弦值（被遮挡时为0），occluded返回是否被遮挡
+inline double face_sunlit_cos(
+    const OcclusionEngine& engine,
+    const SurfaceSample& sample,
+    const Point3D& sun_dir,
+    size_t slot,
+    bool& occluded
+) {
+    occluded = engine.occluded(sample, sun_dir, slot);
+    if (occluded) return 0.0;
+    return sample.normal.dot(sun_dir);
+}
+
+// 同上，在判定上下文中进行
+inline double face_sunlit_cos(
+    const OcclusionEngine& engine,
+    OcclusionContext& context,
+    const SurfaceSample& sample,
+    const Point3D& sun_dir,
+    size_t slot,
+    bool& occluded
+) {
+    occluded = engine.occluded_in(context, sample, sun_dir, slot);
+    if (occluded) return 0.0;
+    return sample.normal.dot(sun_dir);
+}
+
+}
+
+#endif //OCCLUSIONENGINE_H
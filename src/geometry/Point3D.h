@@ -7,64 +7,74 @@
 #include <cmath>
 
 namespace geom {
-    struct Point3D {
-        double x, y, z;
-        explicit Point3D(double x = 0, double y = 0, double z = 0) : x(x), y(y), z(z) {}
-
-        Point3D operator+(const Point3D& other) const {
-            return Point3D(x + other.x, y + other.y, z + other.z);
+    // 三维向量，按标量类型模板化：双精度为默认几何类型，单精度用于平移到局部原点后的遮挡物数据
+    template <typename T>
+    struct Vec3 {
+        T x, y, z;
+        explicit Vec3(T x = 0, T y = 0, T z = 0) : x(x), y(y), z(z) {}
+
+        Vec3 operator+(const Vec3& other) const {
+            return Vec3(x + other.x, y + other.y, z + other.z);
         }
 
-        Point3D operator-(const Point3D& other) const {
-            return Point3D(x - other.x, y - other.y, z - other.z);
+        Vec3 operator-(const Vec3& other) const {
+            return Vec3(x - other.x, y - other.y, z - other.z);
         }
 
         // 新增：一元负号运算符（用于单个点取反方向）
-        Point3D operator-() const {
-            return Point3D(-x, -y, -z);  // 每个分量取相反数
+        Vec3 operator-() const {
+            return Vec3(-x, -y, -z);  // 每个分量取相反数
         }
 
         // 标量乘法
-        Point3D operator*(double s) const {
-            return Point3D(x * s, y * s, z * s);
+        Vec3 operator*(T s) const {
+            return Vec3(x * s, y * s, z * s);
         }
 
-        Point3D operator/(double scalar) const {
-            return Point3D(x / scalar, y / scalar, z / scalar);
+        Vec3 operator/(T scalar) const {
+            return Vec3(x / scalar, y / scalar, z / scalar);
         }
 
         // 向量长度
-        double magnitude() const {
+        T magnitude() const {
             return std::sqrt(x * x + y * y + z * z);
         }
 
         // 归一化
-        Point3D normalize() const {
-            double mag = magnitude();
-            if (mag < 1e-9) return Point3D();
-            return Point3D(x / mag, y / mag, z / mag);
+        Vec3 normalize() const {
+            T mag = magnitude();
+            if (mag < 1e-9) return Vec3();
+            return Vec3(x / mag, y / mag, z / mag);
         }
 
         // 点积
-        double dot(const Point3D& p) const {
+        T dot(const Vec3& p) const {
             return x * p.x + y * p.y + z * p.z;
         }
 
         // 叉积
-        Point3D cross(const Point3D& p) const {
-            return Point3D(
+        Vec3 cross(const Vec3& p) const {
+            return Vec3(
                 y * p.z - z * p.y,
                 z * p.x - x * p.z,
                 x * p.y - y * p.x
             );
         }
 
-
+        // 转换为另一种标量类型
+        template <typename U>
+        Vec3<U> cast() const {
+            return Vec3<U>(static_cast<U>(x), static_cast<U>(y), static_cast<U>(z));
+        }
     };
 
+    using Point3D = Vec3<double>;
+    using Point3F = Vec3<float>;
+
     // 计算叉积
-    inline Point3D cross(const Point3D& a, const Point3D& b) {
-        return Point3D(
+    template <typename T>
+    inline Vec3<T> cross(const Vec3<T>& a, const Vec3<T>& b) {
+        return Vec3<T>(
             a.y * b.z - a.z * b.y,
             a.z * b.x - a.x * b.z,
             a.x * b.y - a.y * b.x
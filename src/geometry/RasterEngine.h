@@ -0,0 +1,229 @@
+//
+// Created by zhou on 25-7-18.
+//
+
+#ifndef RASTERENGINE_H
+#define RASTERENGINE_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "BVH.h"
+#include "OcclusionEngine.h"
+#include "OccluderBuffer.h"
+#include "Point3D.h"
+#include "TriangleMesh.h"
+
+namespace geom {
+
+// 光栅化引擎：沿太阳方向做正交投影，把所有遮挡物光栅化到深度图（shadow map），
+// 再将面中心投影到深度图上做深度比较。开销取决于深度图分辨率而非 面数×遮挡物数，
+// 结果是近似的：小于一个像素的遮挡物可能被漏掉，边缘处有一个像素宽的误差
+class RasterEngine : public OcclusionEngine {
+public:
+    explicit RasterEngine(int resolution = 1024)
+        : resolution_(std::max(16, resolution)) {}
+
+    [[nodiscard]] OcclusionMethod method() const override { return OcclusionMethod::Raster; }
+    [[nodiscard]] int resolution() const { return resolution_; }
+
+    void build(std::shared_ptr<const OccluderScene> scene) override {
+        occluder_scene_ = std::move(scene);
+        occluders_ = &occluder_scene_->occluders;
+        scene_ = AABB();
+        for (size_t i = 0; i < occluders_->size(); ++i) {
+            scene_.grow(occluders_->bounds_min(i));
+            scene_.grow(occluders_->bounds_max(i));
+        }
+    }
+
+    // 每个线程同时光栅化一个方向
+    [[nodiscard]] size_t batch_size(size_t num_threads) const override {
+        return std::max<size_t>(1, num_threads);
+    }
+
+    void prepare(size_t slot, const Point3D& sun_dir) override {
+        ShadowMap& map = maps_.at(slot);
+        setup_projection(map, sun_dir);
+        const size_t texels = static_cast<size_t>(resolution_) * resolution_;
+        map.depth.assign(texels, -std::numeric_limits<float>::infinity());
+        map.depth2.assign(texels, -std::numeric_limits<float>::infinity());
+        map.id.assign(texels, -1);
+
+        if (!occluders_) return;
+        for (size_t i = 0; i < occluders_->size(); ++i) {
+            rasterize(map, i);
+        }
+    }
+
+    void reserve(size_t slots) override {
+        if (maps_.size() < slots) maps_.resize(slots);
+    }
+
+    [[nodiscard]] bool occluded(const SurfaceSample& sample, const Point3D& sun_dir, size_t slot) const override {
+        // 背向太阳的面直接判定为遮挡（与射线投射引擎一致）
+        const Point3D& face_normal = sample.normal;
+        const double cos_theta = face_normal.dot(sun_dir);
+        if (cos_theta <= 1e-8) {
+            return true;
+        }
+
+        const ShadowMap& map = maps_[slot];
+        const Point3D p = sample.center + face_normal * 1e-5;
+        const double x = (p - map.origin).dot(map.axis_u) / map.texel;
+        const double y = (p - map.origin).dot(map.axis_v) / map.texel;
+        if (x < 0 || y < 0 || x >= resolution_ || y >= resolution_) {
+            return false;
+        }
+        const size_t idx = static_cast<size_t>(y) * resolution_ + static_cast<size_t>(x);
+
+        // 跳过面自身所属的三角形（与射线投射的自遮挡判断一致）
+        const float occluder_depth = map.id[idx] != sample.parent_id ? map.depth[idx] : map.depth2[idx];
+        if (!std::isfinite(occluder_depth)) {
+            return false;
+        }
+
+        // 斜率相关的深度偏移：面相对光线越倾斜，同一像素内深度变化越大
+        const double tan_theta = std::sqrt(std::max(0.0, 1.0 - cos_theta * cos_theta)) / cos_theta;
+        const double bias = map.texel * (1.5 * std::min(tan_theta, 10.0)) + depth_epsilon();
+        const double depth = (p - map.origin).dot(sun_dir);
+        return occluder_depth > depth + bias;
+    }
+
+private:
+    // 单个太阳方向的深度图：记录每个像素最靠近太阳的深度及其三角形ID，
+    // 以及ID不同的次靠近深度（用于排除接收面自身）
+    struct ShadowMap {
+        Point3D axis_u, axis_v, axis_w;  // 光空间坐标轴（w为太阳方向）
+        Point3D origin;                  // 深度图左下角（u=v=0）
+        double texel = 1.0;              // 像素边长
+        std::vector<float> depth;
+        std::vector<float> depth2;
+        std::vector<int> id;
+    };
+
+    int resolution_;
+    std::shared_ptr<const OccluderScene> occluder_scene_;
+    const OccluderBuffer* occluders_ = nullptr;
+    AABB scene_;
+    std::vector<ShadowMap> maps_;
+
+    [[nodiscard]] double depth_epsilon() const {
+        const Point3D extent = scene_.empty() ? Point3D() : scene_.max - scene_.min;
+        return extent.magnitude() * 1e-6 + 1e-5;
+    }
+
+    // 以场景包围盒在光空间中的投影范围确定深度图覆盖区域
+    void setup_projection(ShadowMap& map, const Point3D& sun_dir) const {
+        map.axis_w = sun_dir.normalize();
+        const Point3D helper = std::fabs(map.axis_w.z) < 0.9 ? Point3D(0, 0, 1) : Point3D(1, 0, 0);
+        map.axis_u = helper.cross(map.axis_w).normalize();
+        map.axis_v = map.axis_w.cross(map.axis_u);
+
+        if (scene_.empty()) {
+            map.origin = Point3D();
+            map.texel = 1.0;
+            return;
+        }
+
+        double min_u = std::numeric_limits<double>::max(), max_u = -min_u;
+        double min_v = min_u, max_v = -min_u;
+        for (int k = 0; k < 8; ++k) {
+            const Point3D corner((k & 1) ? scene_.max.x : scene_.min.x,
+                                 (k & 2) ? scene_.max.y : scene_.min.y,
+                                 (k & 4) ? scene_.max.z : scene_.min.z);
+            const double u = corner.dot(map.axis_u);
+            const double v = corner.dot(map.axis_v);
+            min_u = std::min(min_u, u); max_u = std::max(max_u, u);
+            min_v = std::min(min_v, v); max_v = std::max(max_v, v);
+        }
+        const double size = std::max({max_u - min_u, max_v - min_v, 1e-6});
+        map.texel = size / resolution_;
+        // 原点取在场景中心所在的深度平面上，深度以此为零点，减小float误差
+        const Point3D center = (scene_.min + scene_.max) * 0.5;
+        map.origin = map.axis_u * min_u + map.axis_v * min_v + map.axis_w * center.dot(map.axis_w);
+    }
+
+    // 按像素中心覆盖规则光栅化第i个遮挡三角形
+    void rasterize(ShadowMap& map, size_t i) const {
+        const Point3D p[3] = {
+            occluders_->vertex0(i),
+            occluders_->vertex0(i) + occluders_->edge1(i),
+            occluders_->vertex0(i) + occluders_->edge2(i)
+        };
+        double x[3], y[3], d[3];
+        for (int k = 0; k < 3; ++k) {
+            const Point3D rel = p[k] - map.origin;
+            x[k] = rel.dot(map.axis_u) / map.texel;
+            y[k] = rel.dot(map.axis_v) / map.texel;
+            d[k] = rel.dot(map.axis_w);
+        }
+
+        // 投影面积过小（三角形与光线平行）时不产生遮挡
+        const double area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (std::fabs(area) < 1e-12) return;
+        const double inv_area = 1.0 / area;
+
+        const int ix0 = std::max(0, static_cast<int>(std::ceil(std::min({x[0], x[1], x[2]}) - 0.5)));
+        const int ix1 = std::min(resolution_ - 1, static_cast<int>(std::floor(std::max({x[0], x[1], x[2]}) - 0.5)));
+        const int iy0 = std::max(0, static_cast<int>(std::ceil(std::min({y[0], y[1], y[2]}) - 0.5)));
+        const int iy1 = std::min(resolution_ - 1, static_cast<int>(std::floor(std::max({y[0], y[1], y[2]}) - 0.5)));
+        const int id = occluders_->ids[i];
+
+        // 重心坐标是像素中心(px, py)的线性函数：w_k = a_k*px + b_k*py + c_k
+        double a[3], b[3], c[3];
+        for (int k = 0; k < 3; ++k) {
+            const int j = (k + 1) % 3, l = (k + 2) % 3;
+            a[k] = (y[j] - y[l]) * inv_area;
+            b[k] = (x[l] - x[j]) * inv_area;
+            c[k] = (x[j] * y[l] - x[l] * y[j]) * inv_area;
+        }
+        const double depth_a = a[0] * d[0] + a[1] * d[1] + a[2] * d[2];
+
+        for (int iy = iy0; iy <= iy1; ++iy) {
+            const double py = iy + 0.5;
+            // 逐行求出三个重心坐标均非负的像素区间（扫描线）
+            double lo = ix0 + 0.5, hi = ix1 + 0.5;
+            double w_row[3];
+            for (int k = 0; k < 3; ++k) {
+                w_row[k] = b[k] * py + c[k];
+                if (a[k] > 0) {
+                    lo = std::max(lo, -w_row[k] / a[k]);
+                } else if (a[k] < 0) {
+                    hi = std::min(hi, -w_row[k] / a[k]);
+                } else if (w_row[k] < 0) {
+                    hi = lo - 1;
+                }
+            }
+            if (hi < lo) continue;
+            const int x_first = std::max(ix0, static_cast<int>(std::ceil(lo - 0.5)));
+            const int x_last = std::min(ix1, static_cast<int>(std::floor(hi - 0.5)));
+            const double depth_row = (b[0] * py + c[0]) * d[0] + (b[1] * py + c[1]) * d[1] + (b[2] * py + c[2]) * d[2];
+
+            for (int ix = x_first; ix <= x_last; ++ix) {
+                const double px = ix + 0.5;
+                // 区间端点处再按重心坐标精确判断一次，避免舍入误差
+                if (ix == x_first || ix == x_last) {
+                    if (a[0] * px + w_row[0] < 0 || a[1] * px + w_row[1] < 0 || a[2] * px + w_row[2] < 0) continue;
+                }
+
+                const auto depth = static_cast<float>(depth_a * px + depth_row);
+                const size_t idx = static_cast<size_t>(iy) * resolution_ + ix;
+                if (depth > map.depth[idx]) {
+                    if (map.id[idx] != id) map.depth2[idx] = map.depth[idx];
+                    map.depth[idx] = depth;
+                    map.id[idx] = id;
+                } else if (map.id[idx] != id && depth > map.depth2[idx]) {
+                    map.depth2[idx] = depth;
+                }
+            }
+        }
+    }
+};
+
+}
+
+#endif //RASTERENGINE_H
@@ -0,0 +1,156 @@
+//
+// Created by zhou on 25-7-18.
+//
+
+#ifndef RAYCASTENGINE_H
+#define RAYCASTENGINE_H
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "BVH.h"
+#include "OcclusionEngine.h"
+#include "OccluderBuffer.h"
+#include "OccluderCulling.h"
+#include "Point3D.h"
+#include "SimdKernel.h"
+#include "TriangleMesh.h"
+
+namespace geom {
+
+// 计算采样点的遮挡判定射线起点；面背向太阳时返回false
+// bias为沿法向的偏移量（单精度缓冲区按坐标量级放大，见OccluderBufferF::ray_bias）
+inline bool face_ray_origin(
+    const SurfaceSample& sample,
+    const Point3D& sun_dir,
+    Point3D& ray_origin,
+    double bias = 1e-5
+) {
+    const Point3D& center = sample.center;
+    const Point3D& face_normal = sample.normal;
+
+    // 背向太阳的面直接判定为遮挡（法向量与太阳方向夹角≥90度）
+    if (face_normal.dot(sun_dir) <= 1e-8) {
+        return false;
+    }
+
+    // 射线起点偏移：沿法向量方向微小偏移，避免与自身面相交
+    ray_origin = center + face_normal * bias;
+    return true;
+}
+
+// 判断单个采样点是否被遮挡（核心逻辑）
+template <typename T>
+bool is_face_occluded(
+    const BasicOccluderBuffer<T>& occluders,
+    const BVH& bvh,
+    const SurfaceSample& sample,
+    const Point3D& sun_dir
+) {
+    Point3D ray_origin;
+    if (!face_ray_origin(sample, sun_dir, ray_origin, occluders.ray_bias)) {
+        return true;
+    }
+
+    // 通过BVH查询是否存在有效遮挡（射线方向与太阳方向相同，跳过同一表面的三角形）
+    return bvh.any_hit(occluders, ray_origin, sun_dir, sample.parent_id);
+}
+
+// 射线投射引擎：每个面从中心向太阳投射一条射线，通过BVH查询遮挡
+// T为叶子内求交的精度，BVH遍历与射线起点计算始终使用双精度
+template <typename T>
+class BasicRayCastEngine : public OcclusionEngine {
+public:
+    [[nodiscard]] OcclusionMethod method() const override { return OcclusionMethod::RayCast; }
+
+    [[nodiscard]] bool needs_bvh() const override { return true; }
+
+    [[nodiscard]] GeometryPrecision precision() const override {
+        return std::is_same_v<T, float> ? GeometryPrecision::Float : GeometryPrecision::Double;
+    }
+
+    void build(std::shared_ptr<const OccluderScene> scene) override {
+        if (!scene->has_bvh()) {
+            throw std::runtime_error("射线投射引擎需要带BVH的遮挡场景");
+        }
+        if (std::is_same_v<T, float> && !scene->has_float()) {
+            throw std::runtime_error("单精度射线投射引擎需要带单精度副本的遮挡场景");
+        }
+        scene_ = std::move(scene);
+        occluders_ = &scene_->template buffer<T>();
+        bvh_ = &scene_->bvh;
+    }
+
+    [[nodiscard]] bool occluded(const SurfaceSample& sample, const Point3D& sun_dir, size_t /*slot*/) const override {
+        return is_face_occluded(*occluders_, *bvh_, sample, sun_dir);
+    }
+
+    void cull(const ReceiverBounds& receiver, const Point3D& sun_dir,
+              OcclusionContext& context) const override {
+        cull_occluders(*occluders_, *bvh_, receiver, sun_dir, context.template candidates_for<T>());
+    }
+
+    // 依次测试：上一个面的遮挡物 → 本面在相邻太阳角度下的遮挡物 → 候选遮挡物（或全局BVH）
+    [[nodiscard]] bool occluded_in(OcclusionContext& context, const SurfaceSample& sample,
+                                   const Point3D& sun_dir, size_t /*slot*/) const override {
+        OcclusionStats& stats = context.stats;
+        ++stats.faces;
+        context.hit = -1;
+
+        Point3D ray_origin;
+        if (!face_ray_origin(sample, sun_dir, ray_origin, occluders_->ray_bias)) {
+            return true;
+        }
+        ++stats.rays;
+
+        const int skip_id = sample.parent_id;
+        const auto& candidates = context.template candidates_for<T>();
+        // 候选遮挡物不超过一个向量宽度时，完整求交与单独测试代价相同，不必查缓存
+        const bool use_cache = !candidates.active || candidates.indices.size() > kCacheThreshold;
+        if (use_cache && context.last_hit >= 0 && test_one(context.last_hit, ray_origin, sun_dir, skip_id, stats)) {
+            ++stats.last_hits;
+            context.hit = context.last_hit;
+            return true;
+        }
+        if (use_cache && context.angle_hit >= 0 && context.angle_hit != context.last_hit &&
+            test_one(context.angle_hit, ray_origin, sun_dir, skip_id, stats)) {
+            ++stats.angle_hits;
+            context.hit = context.last_hit = context.angle_hit;
+            return true;
+        }
+
+        const int64_t hit = candidates.active
+            ? candidates.first_hit(ray_origin, sun_dir, skip_id, stats.triangle_tests)
+            : bvh_->first_hit(*occluders_, ray_origin, sun_dir, skip_id, stats.triangle_tests);
+        if (hit < 0) return false;
+        context.hit = context.last_hit = hit;
+        return true;
+    }
+
+    [[nodiscard]] const BVH& bvh() const { return *bvh_; }
+
+private:
+    static constexpr size_t kCacheThreshold = 8;
+
+    std::shared_ptr<const OccluderScene> scene_;
+    const BasicOccluderBuffer<T>* occluders_ = nullptr;
+    const BVH* bvh_ = nullptr;
+
+    // 单独测试一个遮挡三角形（命中缓存），与批量求交使用同一内核，判定结果一致
+    [[nodiscard]] bool test_one(int64_t idx, const Point3D& origin, const Point3D& dir, int skip_id,
+                                OcclusionStats& stats) const {
+        ++stats.cache_tests;
+        ++stats.triangle_tests;
+        return simd::first_hit(*occluders_, static_cast<uint32_t>(idx), 1, occluders_->local_point(origin),
+                               occluders_->local_dir(dir), skip_id) >= 0;
+    }
+};
+
+using RayCastEngine = BasicRayCastEngine<double>;
+using RayCastEngineF = BasicRayCastEngine<float>;
+
+}
+
+#endif //RAYCASTENGINE_H
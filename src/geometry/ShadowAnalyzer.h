@@ -5,10 +5,22 @@
 #ifndef SHADOWANALYZER_H
 #define SHADOWANALYZER_H
 #include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <ranges>
+#include <sstream>
+#include <tuple>
 #include <vector>
 
+#include <ThreadPool.h>
+
+#include "BVH.h"
 #include "Point3D.h"
+#include "RasterEngine.h"
+#include "RayCastEngine.h"
+#include "ShadowQuadTree.h"
+#include "ShadowTable.h"
 #include "Triangle.h"
 #include "TriangleMesh.h"
 
@@ -35,130 +47,132 @@ inline Point3D sun_angle_to_direction(double altitude_deg, double azimuth_deg) {
     return dir.normalize();
 }
 
-// 射线-三角形相交检测（Möller-Trumbore算法）
-inline bool ray_triangle_intersection(
-    const Point3D& ray_origin,
-    const Point3D& ray_dir,  // 单位向量
-    const Triangle& triangle,
-    double& t,               // 射线起点到交点的距离
-    const double epsilon = 1e-8  // 精度阈值
-) {
-    const Point3D& v0 = triangle.vertices[0];
-    const Point3D& v1 = triangle.vertices[1];
-    const Point3D& v2 = triangle.vertices[2];
-
-    const Point3D edge1 = v1 - v0;
-    const Point3D edge2 = v2 - v0;
-    const Point3D h = ray_dir.cross(edge2);
-    const double a = edge1.dot(h);
-
-    // 射线与三角形平行或共面
-    if (std::fabs(a) < epsilon) return false;
-
-    const double f = 1.0 / a;
-    const Point3D s = ray_origin - v0;
-    const double u = f * s.dot(h);
-
-    // u不在[0,1]范围内，无交点
-    if (u < -epsilon || u > 1.0 + epsilon) return false;
-
-    const Point3D q = s.cross(edge1);
-    const double v = f * ray_dir.dot(q);
-
-    // v不在[0,1]或u+v>1，无交点
-    if (v < -epsilon || u + v > 1.0 + epsilon) return false;
-
-    // 计算交点距离
-    t = f * edge2.dot(q);
-    return t > epsilon;  // 交点在射线前方
-}
-
-// 收集遮挡物并设置ID（确保每个三角形的id正确对应其所属表面）
-inline std::vector<std::shared_ptr<Triangle>> collect_occluders(const StlModel& model) {
-    std::vector<std::shared_ptr<Triangle>> occluders;
-
-    for (const auto& [solidName, triangles] : model) {
-        for (const auto& tri : triangles) {
-            // 复制三角形并设置其所属表面ID
-            auto occluder = std::make_shared<Triangle>(tri);
-
-            occluders.push_back(occluder);
-        }
-
-    }
+// 收集遮挡物：将STL模型中的所有三角形写入扁平化缓冲区（id对应其所属表面）
+inline OccluderBuffer collect_occluders(const StlModel& model) {
+    OccluderBuffer occluders;
+    occluders.build(model);
     return occluders;
 }
 
-// 判断单个三角面是否被遮挡（核心逻辑）
-inline bool is_face_occluded(
-    const std::vector<std::shared_ptr<Triangle>>& occluders,
-    const TriangleMesh& mesh,
-    size_t face_idx,
-    const Point3D& sun_dir
-) {
-
-    // 检查面索引有效性
-    if (face_idx >= mesh.faces.size() || face_idx >= mesh.centers.size() || face_idx >= mesh.normals.size()) {
-        throw std::out_of_range("无效的面索引: " + std::to_string(face_idx));
-    }
-
-    // 当前网格所属表面ID（用于自遮挡判断）
-    const int current_parent_id = mesh.parent_id;
-    const Point3D center = mesh.centers[face_idx];
-    const Point3D face_normal = mesh.normals[face_idx].normalize();
-
-    // 背向太阳的面直接判定为遮挡（法向量与太阳方向夹角≥90度）
-    if (face_normal.dot(sun_dir) <= 1e-8) {
-        return true;
-    }
-
-    // 射线方向：与太阳方向相同
-    const Point3D ray_dir = sun_dir;
-    // 射线起点偏移：沿法向量方向微小偏移，避免与自身面相交
-    const double bias = 1e-5;
-    const Point3D ray_origin = center + face_normal * bias;
-
+// 由STL模型构建遮挡场景（射线投射引擎需要BVH，单精度引擎还需要单精度副本）
+inline std::shared_ptr<const OccluderScene> collect_occluder_scene(const StlModel& model, bool with_bvh,
+                                                                   bool with_float = false) {
+    return OccluderScene::build(collect_occluders(model), with_bvh, with_float);
+}
 
-    // 遍历所有遮挡物，检测是否有有效遮挡
-    for (const auto& occluder_ptr : occluders) {
-        if (!occluder_ptr) continue;  // 跳过空指针
+// 渐进分层采样：每个父三角形先取start_level层点阵的子三角形中心作为采样点，按停止判据逐层加密，
+// 直到判据满足或达到该三角形的细分层数（只用于流式采样源）
+// 加密是嵌套的：上一层的采样点恰是下一层中间子三角形的中心，沿用其结果，每层只判定新增的3/4采样点
+// 停止判据是启发式的：把已判定的采样点当作二项分布样本（加0.5个伪计数）估计受照比例的"标准误差"，
+// 点阵是确定的而非随机样本，这个值不是误差界，只用来决定何时停止加密
+struct ProgressiveSampling {
+    double tolerance = 0.0;  // 停止判据的容差，0为不启用
+    int start_level = 2;     // 起始层数（4^start_level个采样点）
 
-        const auto& occluder = *occluder_ptr;
-        //std::cout<<occluder_ptr->id<<" "<<current_parent_id<<std::endl;
-        // 自遮挡判断：遮挡物与当前面属于同一表面，直接跳过
-        if (occluder.id == current_parent_id) {
-            //std::cout<<"检查到自身表面"<<occluder_ptr->id<<std::endl;
-            continue;
-        }
+    [[nodiscard]] bool enabled() const { return tolerance > 0; }
+};
 
-        // 检测射线是否与遮挡物相交
-        double t;
-        if (ray_triangle_intersection(ray_origin, ray_dir, occluder, t)) {
-            return true;  // 存在有效遮挡
-        }
+// 渐进采样的逐表面统计（累计所有已计算的太阳方向，不含计算视角系数的方向）
+// 误差为各向阳父三角形受照比例的标准误差估计，与停止判据的估计相同，只是估计而不是误差界
+struct SurfaceSampling {
+    uint64_t samples = 0;       // 判定的采样点数
+    uint64_t full_samples = 0;  // 按全密度细分需要判定的采样点数
+    double max_error = 0.0;     // 标准误差估计的最大值
+    double error_area = 0.0;    // 标准误差估计×父三角形面积之和
+    double lit_side_area = 0.0;  // 向阳父三角形的面积之和
+
+    // 标准误差估计的面积加权平均
+    [[nodiscard]] double mean_error() const {
+        return lit_side_area > 0 ? error_area / lit_side_area : 0.0;
     }
-
-    return false;  // 无遮挡
-}
+};
 
 // 阴影分析器类
 class ShadowAnalyzer {
 private:
     //Point3D sun_dir_;  // 太阳方向向量（单位向量）
-    std::vector<std::shared_ptr<Triangle>> occluders_;  // 所有遮挡物
+    std::shared_ptr<const OccluderScene> scene_;         // 所有遮挡物（扁平化缓冲区，按引擎需要的顺序排列）及BVH
+    std::shared_ptr<const OccluderScene> shared_scene_;  // 外部提供的共享遮挡场景（为空时由模型构建）
+    std::unique_ptr<OcclusionEngine> engine_ = std::make_unique<RayCastEngine>();  // 遮挡判定引擎
     std::map<std::string, std::vector<std::vector<bool>>> results_;  // 遮挡结果：solid名→网格→面是否被遮挡
     std::map<std::string, std::vector<std::vector<double>>> results_cos;  // 遮挡结果：余弦值
-    std::shared_ptr<const std::map<std::string, std::vector<TriangleMesh>>> meshMap_ptr_;  // 分析的网格数据
-
-    // 定义查询键：(高度角, 方位角, 表面名)
-    using Key = std::tuple<double, double, std::string>;
-    // 全局映射表，存储从CSV读取的数据
-    std::map<Key, double> shadow_table;
+    std::shared_ptr<const std::map<std::string, SolidMesh>> meshMap_ptr_;  // 分析的网格数据（不复制，可不持有所有权）
+
+    std::shared_ptr<util::ThreadPool> pool_;  // 并行执行用线程池（外部共用，单线程时为空）
+
+    // 任务单元中的一个面：所在网格、面下标及其在单元内按网格、面顺序的序号
+    struct FaceRef {
+        uint32_t mesh_idx;
+        uint32_t face_idx;
+        uint32_t pos;
+    };
+
+    // 并行任务单元：某个solid中连续的一段网格（边界只取决于几何，与线程数无关）
+    // 网格来自细分好的SolidMesh，或来自流式采样源SampleSolid（二者其一）
+    struct WorkUnit {
+        size_t solid_idx;
+        const SolidMesh* meshes;
+        const SampleSolid* samples;
+        size_t mesh_begin;
+        size_t mesh_end;
+        ReceiverBounds bounds;        // 接收区域（用于按太阳方向剔除遮挡物）
+        std::vector<FaceRef> order;   // 面的访问顺序（面中心的Morton序，空间上相邻的面连续访问）；流式采样时在任务内生成
+    };
+
+    // 一个任务中任务单元的采样点（按网格、面的顺序存放）及访问顺序
+    // 流式采样时采样点只在任务期间存在，内存只与任务单元大小有关
+    struct UnitSamples {
+        std::vector<SurfaceSample> samples;
+        std::vector<double> areas;
+        std::vector<uint32_t> order;
+    };
+    static constexpr size_t kFacesPerUnit = 4096;     // 每个任务单元大约包含的面数
+    static constexpr size_t kDirectionsPerTask = 16;  // 每个任务连续计算的太阳方向数（相邻角度复用命中缓存）
+    // 计算视角系数的采样方向数（天空半球/地面半球）；天空散射远大于地面反射，天空方向取得更密
+    static constexpr size_t kSkyViewDirections = 64;
+    static constexpr size_t kGroundViewDirections = 32;
+
+    // 任务单元的面积累计（总面积、未遮挡面积×余弦）；渐进采样时另记判定的采样点数与受照比例的误差估计
+    struct UnitSums {
+        double total_area = 0.0;
+        double lit_area_cos = 0.0;
+        uint64_t samples = 0;
+        double max_error = 0.0;   // 父三角形受照比例标准误差估计的最大值
+        double error_area = 0.0;  // 标准误差估计×父三角形面积之和（只计向阳的父三角形）
+        double lit_side_area = 0.0;  // 向阳父三角形的面积之和
+    };
+
+    // 批量计算结果：每个表面一张(高度角, 方位角)稠密网格
+    ShadowTable shadow_table_;
+
+    // 自适应模式：均匀网格之上按角点差异细分的四叉树（查询时优先使用）
+    bool adaptive_ = false;
+    ShadowQuadTree quadtree_;
+
+    // 累计的遮挡判定统计
+    OcclusionStats stats_;
+
+    // 渐进采样设置
+    ProgressiveSampling progressive_;
+    std::vector<SurfaceSampling> sampling_;  // 按表面ID
+
+    // 按需计算模式：查询到未计算的网格节点时才计算并记忆
+    bool on_demand_ = false;
+    std::vector<WorkUnit> demand_units_;  // 指向调用方持有的网格
+    // 计算节点期间一直持有（引擎的逐方向数据不能被两次计算同时使用）；持锁时在线程池上并行计算，
+    // 等待的线程只执行本次计算的任务，不会进入另一个组件对同一分析器的查询而重复加锁
+    std::mutex demand_mutex_;
+
+    // 网格节点（高度角下标, 方位角下标）
+    struct GridNode {
+        int alt_idx;
+        int azi_idx;
+    };
 
     // 计算单个solid的面积加权遮挡率（内部使用）
     double calculateSolidOcclusionRate(
         const std::vector<std::vector<bool>>& solid_results,
-        const std::vector<TriangleMesh>& meshes
+        const SolidMesh& meshes
     ) const {
         double total_area = 0.0;
         double occluded_area = 0.0;
@@ -167,7 +181,7 @@ private:
             if (mesh_idx >= meshes.size()) break;  // 避免越界
 
             const auto& mesh_results = solid_results[mesh_idx];
-            const auto& mesh = meshes[mesh_idx];
+            const TriangleMesh mesh = meshes[mesh_idx];
 
             for (size_t face_idx = 0; face_idx < mesh_results.size(); ++face_idx) {
                 if (face_idx >= mesh.areas.size()) break;  // 避免越界
@@ -186,7 +200,7 @@ private:
     double calculateSolidOcclusionCosAve(
         const std::vector<std::vector<bool>>& solid_results,
         const std::vector<std::vector<double>>& solid_results_cos,
-        const std::vector<TriangleMesh>& meshes
+        const SolidMesh& meshes
     ) const {
         double total_area = 0.0;
         double occluded_area_cos = 0.0;
@@ -196,7 +210,7 @@ private:
 
             const auto& mesh_results = solid_results[mesh_idx];
             const auto& mesh_results_cos = solid_results_cos[mesh_idx];
-            const auto& mesh = meshes[mesh_idx];
+            const TriangleMesh mesh = meshes[mesh_idx];
 
             for (size_t face_idx = 0; face_idx < mesh_results.size(); ++face_idx) {
                 if (face_idx >= mesh.areas.size()) break;  // 避免越界
@@ -214,65 +228,689 @@ private:
         return (total_area > 1e-9) ? (occluded_area_cos / total_area) : 0.0;
     }
 
+    // 10位整数的比特间隔展开（每位之间插入两个0），用于三维Morton编码
+    static uint32_t spread_bits_3d(uint32_t x) {
+        x &= 0x3ff;
+        x = (x | (x << 16)) & 0x030000ff;
+        x = (x | (x << 8)) & 0x0300f00f;
+        x = (x | (x << 4)) & 0x030c30c3;
+        x = (x | (x << 2)) & 0x09249249;
+        return x;
+    }
+
+    // 面中心在单元包围盒内量化为每轴10位后的Morton码
+    static uint32_t morton_code(const Point3D& p, const AABB& box) {
+        const Point3D extent = box.max - box.min;
+        auto quantize = [](double v, double lo, double size) {
+            if (size <= 0) return 0u;
+            return static_cast<uint32_t>(std::clamp((v - lo) / size, 0.0, 1.0) * 1023.0);
+        };
+        return spread_bits_3d(quantize(p.x, box.min.x, extent.x)) |
+               (spread_bits_3d(quantize(p.y, box.min.y, extent.y)) << 1) |
+               (spread_bits_3d(quantize(p.z, box.min.z, extent.z)) << 2);
+    }
+
+    // 采样点按中心的Morton码稳定排序后的序号
+    static std::vector<uint32_t> morton_order(const std::vector<Point3D>& centers, const AABB& box) {
+        std::vector<std::pair<uint32_t, uint32_t>> keyed;
+        keyed.reserve(centers.size());
+        for (size_t pos = 0; pos < centers.size(); ++pos) {
+            keyed.emplace_back(morton_code(centers[pos], box), static_cast<uint32_t>(pos));
+        }
+        std::stable_sort(keyed.begin(), keyed.end(),
+                         [](const auto& a, const auto& b) { return a.first < b.first; });
+        std::vector<uint32_t> order;
+        order.reserve(keyed.size());
+        for (const auto& [code, pos] : keyed) {
+            order.push_back(pos);
+        }
+        return order;
+    }
+
+    static WorkUnit make_unit(size_t solid_idx, const SolidMesh& meshes, size_t begin, size_t end) {
+        WorkUnit unit{solid_idx, &meshes, nullptr, begin, end, ReceiverBounds::from_meshes(meshes, begin, end), {}};
+        std::vector<FaceRef> refs;
+        std::vector<Point3D> centers;
+        uint32_t pos = 0;
+        for (size_t mesh_idx = begin; mesh_idx < end; ++mesh_idx) {
+            const TriangleMesh mesh = meshes[mesh_idx];
+            for (size_t face_idx = 0; face_idx < mesh.faces.size(); ++face_idx) {
+                refs.push_back({static_cast<uint32_t>(mesh_idx), static_cast<uint32_t>(face_idx), pos++});
+                centers.push_back(mesh.centers[face_idx]);
+            }
+        }
+        unit.order.reserve(refs.size());
+        for (const uint32_t p : morton_order(centers, unit.bounds.box)) {
+            unit.order.push_back(refs[p]);
+        }
+        return unit;
+    }
+
+    static WorkUnit make_unit(size_t solid_idx, const SampleSolid& samples, size_t begin, size_t end) {
+        return {solid_idx, nullptr, &samples, begin, end, ReceiverBounds::from_samples(samples, begin, end), {}};
+    }
+
+    // 按面数把每个solid的父三角形切分为任务单元（Solid为SolidMesh或SampleSolid）
+    template <typename Solid>
+    static std::vector<WorkUnit> make_work_units(const std::map<std::string, Solid>& solids) {
+        std::vector<WorkUnit> units;
+        size_t solid_idx = 0;
+        for (const auto& [solidName, meshes] : solids) {
+            size_t begin = 0;
+            size_t faces = 0;
+            for (size_t mesh_idx = 0; mesh_idx < meshes.size(); ++mesh_idx) {
+                faces += meshes.parents[mesh_idx].face_count;
+                if (faces >= kFacesPerUnit) {
+                    units.push_back(make_unit(solid_idx, meshes, begin, mesh_idx + 1));
+                    begin = mesh_idx + 1;
+                    faces = 0;
+                }
+            }
+            if (begin < meshes.size()) {
+                units.push_back(make_unit(solid_idx, meshes, begin, meshes.size()));
+            }
+            ++solid_idx;
+        }
+        return units;
+    }
+
+    static size_t unit_face_count(const WorkUnit& unit) {
+        size_t faces = 0;
+        for (size_t i = unit.mesh_begin; i < unit.mesh_end; ++i) {
+            faces += unit.meshes ? unit.meshes->parents[i].face_count : unit.samples->parents[i].face_count;
+        }
+        return faces;
+    }
+
+    // 取出任务单元的采样点：网格模式从SolidMesh读取，流式采样模式现场生成并按Morton序排序
+    static void load_samples(const WorkUnit& unit, UnitSamples& out) {
+        out.samples.clear();
+        out.areas.clear();
+        out.order.clear();
+        if (unit.meshes) {
+            for (size_t mesh_idx = unit.mesh_begin; mesh_idx < unit.mesh_end; ++mesh_idx) {
+                const TriangleMesh mesh = (*unit.meshes)[mesh_idx];
+                SurfaceSample sample{Point3D(), mesh.normal.normalize(), mesh.parent_id};
+                for (size_t face_idx = 0; face_idx < mesh.faces.size(); ++face_idx) {
+                    sample.center = mesh.centers[face_idx];
+                    out.samples.push_back(sample);
+                    out.areas.push_back(mesh.areas[face_idx]);
+                }
+            }
+            for (const FaceRef& ref : unit.order) {
+                out.order.push_back(ref.pos);
+            }
+            return;
+        }
+
+        std::vector<Point3D> centers;
+        for (size_t parent_idx = unit.mesh_begin; parent_idx < unit.mesh_end; ++parent_idx) {
+            for_each_sample(unit.samples->parents[parent_idx], [&](const SurfaceSample& sample, double area) {
+                out.samples.push_back(sample);
+                out.areas.push_back(area);
+                centers.push_back(sample.center);
+            });
+        }
+        out.order = morton_order(centers, unit.bounds.box);
+    }
+
+    // 依次计算一个任务单元在若干太阳方向下的面积数据，第k个方向的结果写入sums[k]
+    // 每个方向先剔除一次遮挡物，面按Morton序访问；命中缓存在相邻的面、相邻的方向之间复用
+    // 各面的结果先按序号存放，再按网格、面的顺序累加，结果与访问顺序无关
+    void evaluate_unit(const WorkUnit& unit, const Point3D* sun_dirs, const size_t* slots, size_t count,
+                       UnitSums* const* sums, OcclusionStats& stats) const {
+        OcclusionContext context;
+        UnitSamples unit_samples;
+        load_samples(unit, unit_samples);
+        const auto& samples = unit_samples.samples;
+        const auto& areas = unit_samples.areas;
+        std::vector<int64_t> angle_hits(samples.size(), -1);
+        std::vector<double> lit(samples.size());
+
+        for (size_t k = 0; k < count; ++k) {
+            engine_->cull(unit.bounds, sun_dirs[k], context);
+            context.last_hit = -1;
+            for (const uint32_t pos : unit_samples.order) {
+                context.angle_hit = angle_hits[pos];
+                bool occluded = false;
+                const double cos_val = face_sunlit_cos(*engine_, context, samples[pos], sun_dirs[k], slots[k], occluded);
+                lit[pos] = occluded ? 0.0 : areas[pos] * cos_val;
+                if (context.hit >= 0) angle_hits[pos] = context.hit;
+            }
+
+            UnitSums& out = *sums[k];
+            out = UnitSums();
+            for (size_t pos = 0; pos < lit.size(); ++pos) {
+                out.total_area += areas[pos];
+                out.lit_area_cos += lit[pos];
+            }
+        }
+        stats.merge(context.stats);
+    }
+
+    // 渐进采样版本：逐个父三角形按层嵌套加密采样点，受照比例取已判定的全部采样点（即最后一层点阵）的结果
+    // 达到该三角形的细分层数时采样点与全密度细分相同（沿用的采样点位置只差舍入误差），判定次数也相同
+    // 同一父三角形的各采样点法向相同，受照余弦只差一个是否遮挡的因子
+    void evaluate_unit_progressive(const WorkUnit& unit, const Point3D* sun_dirs, const size_t* slots, size_t count,
+                                   UnitSums* const* sums, OcclusionStats& stats) const {
+        OcclusionContext context;
+        const auto& parents = unit.samples->parents;
+        std::vector<int64_t> angle_hits(unit.mesh_end - unit.mesh_begin, -1);
+
+        for (size_t k = 0; k < count; ++k) {
+            engine_->cull(unit.bounds, sun_dirs[k], context);
+            context.last_hit = -1;
+            UnitSums& out = *sums[k];
+            out = UnitSums();
+            for (size_t parent_idx = unit.mesh_begin; parent_idx < unit.mesh_end; ++parent_idx) {
+                const SampleParent& parent = parents[parent_idx];
+                out.total_area += parent.original_area;
+                const double cos_val = parent.normal.normalize().dot(sun_dirs[k]);
+                if (cos_val <= 1e-8) continue;  // 背向太阳，全部遮挡
+
+                int64_t& angle_hit = angle_hits[parent_idx - unit.mesh_begin];
+                int level = std::min(progressive_.start_level, parent.level);
+                size_t lit_count = 0, sample_count = 0;  // 跨层累计（同一层的采样点面积相同）
+                auto judge = [&](const SurfaceSample& sample, double) {
+                    context.angle_hit = angle_hit;
+                    if (!engine_->occluded_in(context, sample, sun_dirs[k], slots[k])) ++lit_count;
+                    if (context.hit >= 0) angle_hit = context.hit;
+                    ++sample_count;
+                };
+                for_each_sample(parent, level, judge);
+                // 达到细分层数即为全密度结果；否则按停止判据决定是否加密：
+                // 加0.5个伪计数的二项分布标准误差，采样点全部受照或全部遮挡时仍大于0，
+                // 避免较少的采样点漏掉小片阴影后直接停止
+                while (level < parent.level) {
+                    const double smoothed = (lit_count + 0.5) / (sample_count + 1.0);
+                    if (std::sqrt(smoothed * (1.0 - smoothed) / sample_count) <= progressive_.tolerance) break;
+                    ++level;
+                    for_each_refined_sample(parent, level, judge);
+                }
+                const double fraction = static_cast<double>(lit_count) / sample_count;
+                out.lit_area_cos += parent.original_area * cos_val * fraction;
+                // 误差估计与停止判据相同（达到细分层数时即全密度结果，记为0）
+                double error = 0.0;
+                if (level < parent.level) {
+                    const double smoothed = (lit_count + 0.5) / (sample_count + 1.0);
+                    error = std::sqrt(smoothed * (1.0 - smoothed) / sample_count);
+                }
+                out.samples += sample_count;
+                out.max_error = std::max(out.max_error, error);
+                out.error_area += error * parent.original_area;
+                out.lit_side_area += parent.original_area;
+            }
+        }
+        stats.merge(context.stats);
+    }
+
+    // 计算一组太阳方向下各表面的面积加权受照余弦，结果按[方向][表面]存放
+    // 任务 = (任务单元, 连续的一段方向)，每个任务写入自己的结果槽位，按固定顺序归并，结果与线程数无关
+    // 引擎需要按方向准备数据（如深度图）时分批进行：先并行准备一批方向，再并行计算该批方向
+    std::vector<double> evaluate_directions(const std::vector<WorkUnit>& units, size_t solid_count,
+                                            const std::vector<Point3D>& sun_dirs) {
+        std::vector<UnitSums> sums(sun_dirs.size() * units.size());
+        size_t batch = engine_->batch_size(getNumThreads());
+        if (batch == 0) batch = std::max<size_t>(1, sun_dirs.size());
+        engine_->reserve(batch);
+
+        for (size_t first = 0; first < sun_dirs.size(); first += batch) {
+            const size_t count = std::min(batch, sun_dirs.size() - first);
+            run_tasks(count, [&](size_t slot) {
+                engine_->prepare(slot, sun_dirs[first + slot]);
+            });
+
+            const size_t chunks = (count + kDirectionsPerTask - 1) / kDirectionsPerTask;
+            std::vector<OcclusionStats> task_stats(chunks * units.size());
+            run_tasks(chunks * units.size(), [&](size_t task_idx) {
+                const size_t unit_idx = task_idx % units.size();
+                const size_t slot_begin = task_idx / units.size() * kDirectionsPerTask;
+                const size_t slot_count = std::min(kDirectionsPerTask, count - slot_begin);
+                size_t slots[kDirectionsPerTask];
+                UnitSums* outs[kDirectionsPerTask];
+                for (size_t k = 0; k < slot_count; ++k) {
+                    slots[k] = slot_begin + k;
+                    outs[k] = &sums[(first + slot_begin + k) * units.size() + unit_idx];
+                }
+                const WorkUnit& unit = units[unit_idx];
+                if (progressive_.enabled() && unit.samples) {
+                    evaluate_unit_progressive(unit, &sun_dirs[first + slot_begin], slots, slot_count, outs,
+                                              task_stats[task_idx]);
+                } else {
+                    evaluate_unit(unit, &sun_dirs[first + slot_begin], slots, slot_count, outs,
+                                  task_stats[task_idx]);
+                }
+            });
+            for (const auto& s : task_stats) {
+                stats_.merge(s);
+            }
+        }
+
+        std::vector<double> rates(sun_dirs.size() * solid_count, 0.0);
+        if (progressive_.enabled()) sampling_.resize(solid_count);
+        for (size_t dir_idx = 0; dir_idx < sun_dirs.size(); ++dir_idx) {
+            std::vector<UnitSums> solid_sums(solid_count);
+            for (size_t unit_idx = 0; unit_idx < units.size(); ++unit_idx) {
+                const UnitSums& part = sums[dir_idx * units.size() + unit_idx];
+                auto& total = solid_sums[units[unit_idx].solid_idx];
+                total.total_area += part.total_area;
+                total.lit_area_cos += part.lit_area_cos;
+                if (progressive_.enabled()) {
+                    auto& sampling = sampling_[units[unit_idx].solid_idx];
+                    sampling.samples += part.samples;
+                    sampling.max_error = std::max(sampling.max_error, part.max_error);
+                    sampling.error_area += part.error_area;
+                    sampling.lit_side_area += part.lit_side_area;
+                }
+            }
+            for (size_t solid_idx = 0; solid_idx < solid_count; ++solid_idx) {
+                const auto& total = solid_sums[solid_idx];
+                if (total.total_area <= 1e-9) continue;
+                rates[dir_idx * solid_count + solid_idx] = total.lit_area_cos / total.total_area;
+            }
+        }
+        if (progressive_.enabled()) {
+            for (const auto& unit : units) {
+                if (unit.samples) sampling_[unit.solid_idx].full_samples += unit_face_count(unit) * sun_dirs.size();
+            }
+        }
+        return rates;
+    }
+
+    // 上下半球分别分层的近似均匀方向（半球上的Fibonacci螺旋点阵，z按等面积分层），
+    // 天空半球sky_count个、地面半球ground_count个，没有方向落在地平面上
+    static std::vector<Point3D> view_directions(size_t sky_count, size_t ground_count) {
+        const double golden_angle = M_PI * (3.0 - std::sqrt(5.0));
+        std::vector<Point3D> dirs;
+        dirs.reserve(sky_count + ground_count);
+        for (const auto& [count, sign] : {std::pair{sky_count, 1.0}, std::pair{ground_count, -1.0}}) {
+            for (size_t i = 0; i < count; ++i) {
+                const double z = sign * (1.0 - (i + 0.5) / count);
+                const double r = std::sqrt(std::max(0.0, 1.0 - z * z));
+                const double phi = golden_angle * i;
+                dirs.emplace_back(r * std::cos(phi), r * std::sin(phi), z);
+            }
+        }
+        return dirs;
+    }
+
+    // 计算各表面的天空/地面视角系数：F = (1/π)∫V(ω)·max(0, n·ω)dω，
+    // 按方向在地平面之上或之下分别积分（地平面之下未被遮挡视为看到地面）
+    // 被积函数的面积加权平均正是各方向的受照余弦，因此把球面方向当作太阳方向批量计算即可
+    // 方向数较少（与太阳角度网格相当），按半球把遮挡后与无遮挡时的余弦和之比乘以无遮挡时的精确值(1±cosβ)/2，
+    // 消去余弦积分本身的离散误差，无遮挡表面的结果与各向同性公式一致
+    void compute_view_factors(const std::vector<WorkUnit>& units, size_t solid_count) {
+        const auto dirs = view_directions(kSkyViewDirections, kGroundViewDirections);
+        // 视角系数不计入渐进采样的统计
+        auto sampling = sampling_;
+        const auto rates = evaluate_directions(units, solid_count, dirs);
+        sampling_ = std::move(sampling);
+
+        const auto orientations = surface_orientations(units, solid_count);
+        std::vector<double> sky(solid_count, 0.0), ground(solid_count, 0.0);
+        std::vector<double> sky_unshaded(solid_count, 0.0), ground_unshaded(solid_count, 0.0);
+        for (size_t dir_idx = 0; dir_idx < dirs.size(); ++dir_idx) {
+            const bool above = dirs[dir_idx].z > 0;
+            auto& factors = above ? sky : ground;
+            auto& unshaded = above ? sky_unshaded : ground_unshaded;
+            for (size_t solid_idx = 0; solid_idx < solid_count; ++solid_idx) {
+                factors[solid_idx] += rates[dir_idx * solid_count + solid_idx];
+                unshaded[solid_idx] += orientations[solid_idx].unshaded_cos(dirs[dir_idx]);
+            }
+        }
+        for (size_t solid_idx = 0; solid_idx < solid_count; ++solid_idx) {
+            const auto [sky_exact, ground_exact] = orientations[solid_idx].unshaded_view_factors();
+            sky[solid_idx] = sky_unshaded[solid_idx] > 1e-12
+                ? std::clamp(sky_exact * sky[solid_idx] / sky_unshaded[solid_idx], 0.0, sky_exact) : 0.0;
+            ground[solid_idx] = ground_unshaded[solid_idx] > 1e-12
+                ? std::clamp(ground_exact * ground[solid_idx] / ground_unshaded[solid_idx], 0.0, ground_exact) : 0.0;
+        }
+        shadow_table_.setViewFactors(std::move(sky), std::move(ground));
+        std::cout << "视角系数计算完成（" << dirs.size() << " 个方向）" << std::endl;
+    }
+
+    // 各表面的朝向：单位法向→面积（同一法向的父三角形合并），用于计算无遮挡时的受照余弦
+    struct SurfaceOrientation {
+        std::map<std::tuple<double, double, double>, double> normals;
+        double total_area = 0.0;
+
+        void add(const Point3D& normal, double area) {
+            const Point3D n = normal.normalize();
+            normals[{n.x, n.y, n.z}] += area;
+            total_area += area;
+        }
+
+        // 无遮挡时受照余弦的面积加权平均
+        [[nodiscard]] double unshaded_cos(const Point3D& sun_dir) const {
+            if (total_area <= 1e-9) return 0.0;
+            double sum = 0.0;
+            for (const auto& [n, area] : normals) {
+                sum += area * std::max(0.0, Point3D(std::get<0>(n), std::get<1>(n), std::get<2>(n)).dot(sun_dir));
+            }
+            return sum / total_area;
+        }
+
+        // 无遮挡时的天空/地面视角系数（各向同性）：(1+cosβ)/2与(1-cosβ)/2的面积加权平均
+        [[nodiscard]] std::pair<double, double> unshaded_view_factors() const {
+            if (total_area <= 1e-9) return {0.0, 0.0};
+            double sky = 0.0;
+            for (const auto& [n, area] : normals) {
+                sky += area * 0.5 * (1.0 + std::get<2>(n));
+            }
+            sky /= total_area;
+            return {sky, 1.0 - sky};
+        }
+    };
+
+    static std::vector<SurfaceOrientation> surface_orientations(const std::vector<WorkUnit>& units, size_t solid_count) {
+        std::vector<SurfaceOrientation> orientations(solid_count);
+        for (const auto& unit : units) {
+            for (size_t i = unit.mesh_begin; i < unit.mesh_end; ++i) {
+                if (unit.meshes) {
+                    orientations[unit.solid_idx].add(unit.meshes->parents[i].normal, unit.meshes->parents[i].original_area);
+                } else {
+                    orientations[unit.solid_idx].add(unit.samples->parents[i].normal, unit.samples->parents[i].original_area);
+                }
+            }
+        }
+        return orientations;
+    }
+
+    // 自适应细分：以已算好的均匀网格为根层，逐层找出角点受照比例差异超过容差的叶子并四分，
+    // 同一层新产生的顶点一次批量计算（与均匀网格共用并行与剔除流程）
+    // 受照比例为顶点值除以无遮挡时的受照余弦，无遮挡的表面不细分
+    void refine(const std::vector<WorkUnit>& units, const AdaptiveRefinement& refinement, std::ostream& csv_file) {
+        quadtree_.build(shadow_table_);
+        const size_t solid_count = shadow_table_.surfaceNames().size();
+        size_t evaluated = 0;
+
+        // 各顶点无遮挡时的受照余弦（按[顶点][表面]存放，随细分追加）
+        const auto orientations = surface_orientations(units, solid_count);
+        std::vector<double> unshaded;
+        size_t unshaded_vertices = 0;
+        auto update_unshaded = [&] {
+            const auto& vertices = quadtree_.vertices();
+            for (; unshaded_vertices < vertices.size(); ++unshaded_vertices) {
+                const auto& vertex = vertices[unshaded_vertices];
+                const Point3D sun_dir = sun_angle_to_direction(vertex.altitude, vertex.azimuth);
+                for (const auto& orientation : orientations) {
+                    unshaded.push_back(orientation.unshaded_cos(sun_dir));
+                }
+            }
+        };
+
+        for (int depth = 0; depth < refinement.max_depth; ++depth) {
+            update_unshaded();
+            std::vector<int32_t> new_vertices;
+            const auto node_count = static_cast<int32_t>(quadtree_.nodes().size());
+            for (int32_t node_idx = 0; node_idx < node_count; ++node_idx) {
+                const auto& node = quadtree_.nodes()[node_idx];
+                if (node.first_child < 0 && node.depth == depth &&
+                    quadtree_.spread(node_idx, unshaded) > refinement.tolerance) {
+                    quadtree_.subdivide(node_idx, new_vertices);
+                }
+            }
+            if (new_vertices.empty()) break;
+
+            std::vector<Point3D> sun_dirs;
+            sun_dirs.reserve(new_vertices.size());
+            for (const int32_t v : new_vertices) {
+                const auto& vertex = quadtree_.vertices()[v];
+                sun_dirs.push_back(sun_angle_to_direction(vertex.altitude, vertex.azimuth));
+            }
+            const auto rates = evaluate_directions(units, solid_count, sun_dirs);
+            for (size_t i = 0; i < new_vertices.size(); ++i) {
+                const auto& vertex = quadtree_.vertices()[new_vertices[i]];
+                csv_file << std::fixed << std::setprecision(4) << vertex.altitude << "," << vertex.azimuth;
+                for (size_t solid_idx = 0; solid_idx < solid_count; ++solid_idx) {
+                    const double rate = rates[i * solid_count + solid_idx];
+                    quadtree_.setValue(new_vertices[i], static_cast<int>(solid_idx), rate);
+                    csv_file << "," << rate;
+                }
+                csv_file << "\n";
+            }
+            evaluated += new_vertices.size();
+        }
+        adaptive_ = true;
+
+        // 与最细层级的均匀网格比较所需的太阳角度数
+        const auto& alt = shadow_table_.altitudeGrid();
+        const auto& azi = shadow_table_.azimuthGrid();
+        const size_t scale = size_t{1} << quadtree_.maxDepth();
+        const size_t alt_nodes = (alt.count - 1) * scale + 1;
+        const size_t azi_nodes = shadow_table_.wraps() ? azi.count * scale : (azi.count - 1) * scale + 1;
+        std::cout << "自适应细分: 容差 " << refinement.tolerance << ", 最大深度 " << quadtree_.maxDepth()
+                  << ", 叶子 " << quadtree_.leafCount() << " 个, 共计算 " << alt.count * azi.count + evaluated
+                  << " 个太阳角度（同精度均匀网格需 " << alt_nodes * azi_nodes << " 个）" << std::endl;
+        printOcclusionStats();
+        printSamplingStats();
+    }
+
+    // 计算并记录一批网格节点（按需计算模式）
+    void compute_nodes(const std::vector<GridNode>& nodes) {
+        if (nodes.empty()) return;
+        const auto& alt_grid = shadow_table_.altitudeGrid();
+        const auto& azi_grid = shadow_table_.azimuthGrid();
+        std::vector<Point3D> sun_dirs;
+        sun_dirs.reserve(nodes.size());
+        for (const auto& node : nodes) {
+            sun_dirs.push_back(sun_angle_to_direction(alt_grid.value(node.alt_idx), azi_grid.value(node.azi_idx)));
+        }
+
+        const size_t solid_count = shadow_table_.surfaceNames().size();
+        const auto rates = evaluate_directions(demand_units_, solid_count, sun_dirs);
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            for (size_t solid_idx = 0; solid_idx < solid_count; ++solid_idx) {
+                shadow_table_.set(static_cast<int>(solid_idx), nodes[i].alt_idx, nodes[i].azi_idx,
+                                  rates[i * solid_count + solid_idx]);
+            }
+        }
+    }
+
+    // 收集网格单元中尚未计算的角点（mark用于去重）
+    void collect_missing(const ShadowTable::Cell& cell, std::vector<uint8_t>& mark, std::vector<GridNode>& nodes) const {
+        const int azi_count = shadow_table_.azimuthGrid().count;
+        for (const int a : {cell.a0, cell.a1}) {
+            for (const int z : {cell.z0, cell.z1}) {
+                const size_t idx = static_cast<size_t>(a) * azi_count + z;
+                if (!shadow_table_.known(a, z) && !mark[idx]) {
+                    mark[idx] = 1;
+                    nodes.push_back({a, z});
+                }
+            }
+        }
+    }
+
+    // 有线程池时并行执行，否则在当前线程顺序执行
+    template <typename Fn>
+    void run_tasks(size_t count, Fn&& fn) {
+        if (pool_) {
+            pool_->parallel_for(count, fn);
+        } else {
+            for (size_t i = 0; i < count; ++i) fn(i);
+        }
+    }
+
 public:
     // 构造函数：通过太阳高度角和方位角初始化
     ShadowAnalyzer()= default;
 
+    // 设置计算用的线程池（为空时串行）；线程池由外部创建并在各分析器、网格细分和组件调度间共用，
+    // 分析器不自行创建线程
+    void setThreadPool(std::shared_ptr<util::ThreadPool> pool) {
+        pool_ = std::move(pool);
+    }
 
-    // 加载遮挡物（从STL模型）
-    void loadOccluders(const StlModel& model) {
-        occluders_ = collect_occluders(model);
+    [[nodiscard]] size_t getNumThreads() const {
+        return pool_ ? pool_->size() : 1;
     }
 
-    // 分析网格的遮挡情况
-    void analyze(const std::map<std::string, std::vector<TriangleMesh>>& meshMap, double sun_altitude, double sun_azimuth) {
-        meshMap_ptr_ = std::make_shared<const std::map<std::string, std::vector<TriangleMesh>>>(meshMap);
-        results_.clear();
+    // 线程池（单线程时为空），供网格细分等预处理共用
+    [[nodiscard]] util::ThreadPool* threadPool() const {
+        return pool_.get();
+    }
 
-        Point3D sun_dir_=sun_angle_to_direction(sun_altitude, sun_azimuth);
+    [[nodiscard]] const std::shared_ptr<util::ThreadPool>& sharedThreadPool() const {
+        return pool_;
+    }
 
 
-        for (const auto& [solidName, meshes] : meshMap) {
-            std::vector<std::vector<bool>> solid_results;
-            solid_results.reserve(meshes.size());
+    // 选择遮挡判定引擎（raster_resolution为光栅化深度图的边长像素数，precision为射线求交精度，光栅化不受影响）
+    void setOcclusionMethod(OcclusionMethod method, int raster_resolution = 1024,
+                            GeometryPrecision precision = GeometryPrecision::Double) {
+        if (method == OcclusionMethod::Raster) {
+            engine_ = std::make_unique<RasterEngine>(raster_resolution);
+        } else if (precision == GeometryPrecision::Float) {
+            engine_ = std::make_unique<RayCastEngineF>();
+        } else {
+            engine_ = std::make_unique<RayCastEngine>();
+        }
+        if (scene_) {
+            buildEngine();
+        }
+    }
 
-            std::vector<std::vector<double>> solid_results_cos;
-            solid_results_cos.reserve(meshes.size());
+    [[nodiscard]] OcclusionMethod getOcclusionMethod() const {
+        return engine_->method();
+    }
 
-            for (const auto& mesh : meshes) {
-                std::vector<bool> mesh_results(mesh.faces.size(), false);
+    [[nodiscard]] GeometryPrecision getGeometryPrecision() const {
+        return engine_->precision();
+    }
 
-                std::vector<double> mesh_results_cos(mesh.faces.size(), 0.0);
+    // 累计的遮挡判定统计（求交次数、命中缓存命中率）
+    [[nodiscard]] const OcclusionStats& occlusionStats() const {
+        return stats_;
+    }
 
-                for (size_t face_idx = 0; face_idx < mesh.faces.size(); ++face_idx) {
-                    try {
-                        mesh_results[face_idx] = is_face_occluded(occluders_, mesh, face_idx, sun_dir_);
-                        auto normal = mesh.normals[face_idx].normalize();
-                        if (!mesh_results[face_idx]) {
-                            double cos_val = normal.dot(sun_dir_);
-                            mesh_results_cos[face_idx]=cos_val;
-                        }
-                    } catch (const std::exception& e) {
-                        std::cerr << "警告：处理面 " << face_idx << " 时出错: " << e.what() << "，默认标记为未遮挡\n";
-                        mesh_results[face_idx] = false;
-                    }
+    void resetOcclusionStats() {
+        stats_ = OcclusionStats();
+    }
 
-                    // 进度提示（每100个面刷新一次，避免输出过于频繁）
-                    // if (face_idx % 100 == 0) {
-                    //     std::cout << "处理 " << solidName << " 网格，面 " << face_idx
-                    //               << "/" << mesh.faces.size() << "\r" << std::flush;
-                    // }
-                }
-                // std::cout << "处理 " << solidName << " 网格，面 " << mesh.faces.size()
-                //           << "/" << mesh.faces.size() << " 完成          \n";
+    // 设置渐进分层采样（对流式采样源生效，须在batchCalculate/prepareOnDemand之前设置）
+    void setProgressiveSampling(const ProgressiveSampling& sampling) {
+        progressive_ = sampling;
+    }
+
+    [[nodiscard]] const ProgressiveSampling& progressiveSampling() const {
+        return progressive_;
+    }
+
+    // 渐进采样的逐表面统计（按表面ID，未启用或尚未计算时为空）
+    [[nodiscard]] const std::vector<SurfaceSampling>& samplingStats() const {
+        return sampling_;
+    }
 
-                solid_results.push_back(mesh_results);
-                solid_results_cos.push_back(mesh_results_cos);
+    // 打印渐进采样的采样点数，以及各表面的采样点数与受照比例的标准误差估计（见SurfaceSampling）
+    void printSamplingStats() const {
+        if (!progressive_.enabled() || sampling_.empty()) return;
+        uint64_t samples = 0, full_samples = 0;
+        for (const auto& sampling : sampling_) {
+            samples += sampling.samples;
+            full_samples += sampling.full_samples;
+        }
+        std::ostringstream out;
+        out << "渐进采样: 停止判据容差 " << progressive_.tolerance << ", 判定 " << samples
+            << " 个采样点（全密度需 " << full_samples << " 个）";
+        const auto& names = shadow_table_.surfaceNames();
+        for (size_t i = 0; i < sampling_.size() && i < names.size(); ++i) {
+            const auto& sampling = sampling_[i];
+            out << "\n  " << names[i] << ": 判定 " << sampling.samples << "/" << sampling.full_samples
+                << " 个采样点, 受照比例标准误差估计 最大 " << std::setprecision(3) << sampling.max_error
+                << ", 面积加权平均 " << sampling.mean_error();
+        }
+        std::cout << out.str() << std::endl;
+    }
+
+    void printOcclusionStats() const {
+        std::ostringstream line;
+        line << "遮挡判定统计: " << stats_.faces << " 个面, " << stats_.rays << " 条射线, 平均每条射线求交 "
+             << std::fixed << std::setprecision(2) << stats_.tests_per_ray() << " 次, 命中缓存 "
+             << stats_.last_hits << "(相邻面) + " << stats_.angle_hits << "(相邻角度) / "
+             << stats_.cache_tests << " 次测试, 命中率 " << stats_.cache_hit_rate() * 100 << "%";
+        std::cout << line.str() << std::endl;
+    }
+
+    // 使用外部构建的遮挡场景（如同一STL的多个表面分组共享），此后加载遮挡物时不再由模型重建
+    void setOccluderScene(std::shared_ptr<const OccluderScene> scene) {
+        shared_scene_ = std::move(scene);
+    }
+
+    // 加载遮挡物（从STL模型，设置了共享遮挡场景时直接使用）
+    void loadOccluders(const StlModel& model) {
+        const bool with_float = engine_->precision() == GeometryPrecision::Float;
+        scene_ = shared_scene_ ? shared_scene_ : collect_occluder_scene(model, engine_->needs_bvh(), with_float);
+        buildEngine();
+    }
+
+    // 把当前遮挡场景绑定到引擎；引擎需要BVH而场景没有时，复制一份遮挡物构建BVH（缓冲区随之按叶子顺序重排），
+    // 需要单精度副本而场景没有时同样复制一份补上
+    void buildEngine() {
+        const bool with_float = engine_->precision() == GeometryPrecision::Float;
+        if ((engine_->needs_bvh() && !scene_->has_bvh()) || (with_float && !scene_->has_float())) {
+            scene_ = OccluderScene::extend(*scene_, engine_->needs_bvh(), with_float);
+        }
+        engine_->build(scene_);
+    }
+
+    // 分析网格的遮挡情况（各任务单元写入各自的结果槽位，可并行）
+    // 只保存网格的引用，不复制：调用方须在打印、导出结果之前保持meshMap有效
+    void analyze(const std::map<std::string, SolidMesh>& meshMap, double sun_altitude, double sun_azimuth) {
+        // 不持有所有权的shared_ptr（别名构造，控制块为空）
+        analyze(std::shared_ptr<const std::map<std::string, SolidMesh>>(
+                    std::shared_ptr<const std::map<std::string, SolidMesh>>(), &meshMap),
+                sun_altitude, sun_azimuth);
+    }
+
+    // 共享网格的所有权（结果查询期间网格保持有效）
+    void analyze(std::shared_ptr<const std::map<std::string, SolidMesh>> meshMap, double sun_altitude, double sun_azimuth) {
+        meshMap_ptr_ = std::move(meshMap);
+        results_.clear();
+        results_cos.clear();
+
+        const Point3D sun_dir_=sun_angle_to_direction(sun_altitude, sun_azimuth);
+
+        // 预先分配结果空间
+        std::vector<std::vector<std::vector<bool>>*> solid_results;
+        std::vector<std::vector<std::vector<double>>*> solid_results_cos;
+        for (const auto& [solidName, meshes] : *meshMap_ptr_) {
+            auto& res = results_[solidName];
+            auto& res_cos = results_cos[solidName];
+            res.reserve(meshes.size());
+            res_cos.reserve(meshes.size());
+            for (const auto& parent : meshes.parents) {
+                res.emplace_back(parent.face_count, false);
+                res_cos.emplace_back(parent.face_count, 0.0);
             }
+            solid_results.push_back(&res);
+            solid_results_cos.push_back(&res_cos);
+        }
 
-            results_[solidName] = solid_results;
-            results_cos[solidName] = solid_results_cos;
-            //std::cout << solidName << " 处理完成，共 " << solid_results.size() << " 个网格\n";
+        engine_->reserve(1);
+        engine_->prepare(0, sun_dir_);
+        const auto units = make_work_units(*meshMap_ptr_);
+        std::vector<OcclusionStats> task_stats(units.size());
+        run_tasks(units.size(), [&](size_t unit_idx) {
+            const WorkUnit& unit = units[unit_idx];
+            auto& res = *solid_results[unit.solid_idx];
+            auto& res_cos = *solid_results_cos[unit.solid_idx];
+            OcclusionContext context;
+            engine_->cull(unit.bounds, sun_dir_, context);
+            for (const FaceRef& ref : unit.order) {
+                const TriangleMesh mesh = (*unit.meshes)[ref.mesh_idx];
+                try {
+                    bool occluded = false;
+                    res_cos[ref.mesh_idx][ref.face_idx] = face_sunlit_cos(*engine_, context, mesh.sample(ref.face_idx), sun_dir_, 0, occluded);
+                    res[ref.mesh_idx][ref.face_idx] = occluded;
+                } catch (const std::exception& e) {
+                    std::cerr << "警告：处理面 " << ref.face_idx << " 时出错: " << e.what() << "，默认标记为未遮挡\n";
+                    res[ref.mesh_idx][ref.face_idx] = false;
+                }
+            }
+            task_stats[unit_idx] = context.stats;
+        });
+        for (const auto& s : task_stats) {
+            stats_.merge(s);
         }
     }
 
@@ -300,7 +938,7 @@ public:
                 if (mesh_idx >= meshes.size()) break;
 
                 const auto& mesh_results = solid_results[mesh_idx];
-                const auto& mesh = meshes[mesh_idx];
+                const TriangleMesh mesh = meshes[mesh_idx];
                 for (size_t face_idx = 0; face_idx < mesh_results.size(); ++face_idx) {
                     if (face_idx >= mesh.areas.size()) break;
 
@@ -349,7 +987,7 @@ public:
                 if (mesh_idx >= meshes.size()) break;
 
                 const auto& mesh_results = solid_results[mesh_idx];
-                const auto& mesh = meshes[mesh_idx];
+                const TriangleMesh mesh = meshes[mesh_idx];
                 for (size_t face_idx = 0; face_idx < mesh_results.size(); ++face_idx) {
                     if (face_idx >= mesh.areas.size()) break;
                     const double face_area = mesh.areas[face_idx];
@@ -372,12 +1010,15 @@ public:
     }
 
     // 批量计算不同太阳角度的遮挡率并导出CSV
+    // meshMap为细分网格（SolidMesh）或流式采样源（SampleSolid），两者结果相同
+    template <typename Solid>
     void batchCalculate(
         const StlModel& model,
-        const std::map<std::string, std::vector<TriangleMesh>>& meshMap,
+        const std::map<std::string, Solid>& meshMap,
         double start_altitude, double end_altitude, double step_altitude,
         double start_azimuth, double end_azimuth, double step_azimuth,
-        const std::string& output_file
+        const std::string& output_file,
+        const AdaptiveRefinement& refinement = {}
     ) {
         // 验证输入参数有效性
         if (step_altitude <= 0 || step_azimuth <= 0 || start_altitude > end_altitude || start_azimuth > end_azimuth) {
@@ -403,218 +1044,178 @@ public:
         }
         csv_file << "\n";
 
-        // 预收集遮挡物（避免重复计算）
-        const auto occluders = collect_occluders(model);
-
-        // 遍历所有角度组合
+        // 预收集遮挡物并构建遮挡判定引擎（所有角度共用）
+        loadOccluders(model);
+
+        // 所有角度组合（同时记录网格下标）
+        struct Angle {
+            double altitude, azimuth;
+            int alt_idx, azi_idx;
+        };
+        std::vector<Angle> angles;
+        AngleGrid alt_grid{start_altitude, step_altitude, 0};
+        AngleGrid azi_grid{start_azimuth, step_azimuth, 0};
         for (double altitude = start_altitude; altitude <= end_altitude + 1e-6; altitude += step_altitude) {
+            azi_grid.count = 0;
             for (double azimuth = start_azimuth; azimuth <= end_azimuth + 1e-6; azimuth += step_azimuth) {
-                // 创建分析器并计算当前角度的遮挡率
-
-                occluders_ = occluders;  // 复用预收集的遮挡物
-                analyze(meshMap, altitude, azimuth);
-
-                // 获取各表面的遮挡率（比例，非百分比）
-                // const auto rates = getSolidOcclusionRates();
-
-                const auto rates = getSolidOcclusionCos();
-
-
-                // 写入CSV行
-                csv_file << std::fixed << std::setprecision(1) << altitude << "," << azimuth;
-                for (const auto& name : solid_names) {
-                    const auto it = rates.find(name);
-                    const double rate = (it != rates.end()) ? it->second : 0.0;
-                    csv_file << "," << std::setprecision(4) << rate;
-
-                    //记录表格
-                    Key key = std::make_tuple(altitude, azimuth, name);
-                    shadow_table[key] = rate;
-                }
-                csv_file << "\n";
-
-
-
-
-                // 打印进度
-                std::cout << "已计算: 高度角=" << std::setprecision(1) << altitude
-                          << "°, 方位角=" << std::setprecision(1) << azimuth << "°\r" << std::flush;
+                angles.push_back({altitude, azimuth, alt_grid.count, azi_grid.count++});
             }
+            ++alt_grid.count;
         }
-
-        std::cout << "\n批量计算完成，结果已导出至: " << output_file << std::endl;
-    }
-
-    static double angle_distance(double alt1, double azi1, double alt2, double azi2) {
-        // 高度角差值（非周期性）
-        double d_alt = alt1 - alt2;
-
-        // 方位角差值（考虑周期性，取最小差值）
-        double d_azi = std::fabs(azi1 - azi2);
-        d_azi = std::min(d_azi, 360.0 - d_azi);  // 如350°与10°的差值为20°
-
-        // 欧氏距离（高度角和方位角权重相同）
-        return std::sqrt(d_alt * d_alt + d_azi * d_azi);
-    }
-
-    //双线性差值
-    // 计算两个角度对之间的球面距离（考虑方位角的周期性）
-    double angular_distance(double alt1, double azi1, double alt2, double azi2) {
-        // 处理方位角的周期性（确保差值在-180°到180°之间）
-        double d_azi = std::fmod(azi2 - azi1 + 540.0, 360.0) - 180.0;
-        double d_alt = alt2 - alt1;
-
-        // 使用球面余弦定律简化版（适用于小角度）
-        // 对于大角度，建议使用完整的球面距离公式
-        return std::sqrt(d_alt * d_alt + d_azi * d_azi * std::cos((alt1 + alt2) * M_PI / 360.0));
-    }
-
-    // 查找最近的4个点并进行双线性插值
-    double find_quad_interpolation(double target_alt, double target_azi, const std::string& surface) {
-        // 收集该表面名下的所有角度对和对应值
-        std::vector<std::tuple<double, double, double, double>> candidates;  // (alt, azi, value, distance)
-        for (const auto& [key, value] : shadow_table) {
-            auto [alt, azi, s] = key;
-            if (s == surface) {
-                double dist = angular_distance(target_alt, target_azi, alt, azi);
-                candidates.emplace_back(alt, azi, value, dist);
-            }
-        }
-
-        // 若数据不足，抛出异常
-        if (candidates.size() < 4) {
-            throw std::out_of_range("表面 " + surface + " 的数据点不足(需要至少4个)");
-        }
-
-        // 按距离升序排序
-        std::sort(candidates.begin(), candidates.end(),
-                  [](const auto& a, const auto& b) { return std::get<3>(a) < std::get<3>(b); });
-
-        // 取最近的4个点
-        std::vector<std::tuple<double, double, double>> nearest;  // (alt, azi, value)
-        for (int i = 0; i < 4; ++i) {
-            nearest.emplace_back(
-                std::get<0>(candidates[i]),
-                std::get<1>(candidates[i]),
-                std::get<2>(candidates[i])
-            );
+        shadow_table_.reset(solid_names, alt_grid, azi_grid);
+        on_demand_ = false;
+        sampling_.clear();
+
+        const auto units = make_work_units(meshMap);
+        std::cout << "共 " << angles.size() << " 个太阳角度, " << units.size()
+                  << " 个任务单元, 线程数: " << getNumThreads() << std::endl;
+
+        std::vector<Point3D> sun_dirs;
+        sun_dirs.reserve(angles.size());
+        for (const auto& angle : angles) {
+            sun_dirs.push_back(sun_angle_to_direction(angle.altitude, angle.azimuth));
         }
+        const auto rates = evaluate_directions(units, solid_names.size(), sun_dirs);
+        printOcclusionStats();
+        printSamplingStats();
+        compute_view_factors(units, solid_names.size());
 
-        // 检查这4个点是否能形成一个合理的四边形（简化版）
-        // 这里仅检查是否有两个不同的高度角和方位角
-        std::vector<double> alts = {std::get<0>(nearest[0]), std::get<0>(nearest[1]),
-                                   std::get<0>(nearest[2]), std::get<0>(nearest[3])};
-        std::vector<double> azis = {std::get<1>(nearest[0]), std::get<1>(nearest[1]),
-                                   std::get<1>(nearest[2]), std::get<1>(nearest[3])};
+        for (size_t angle_idx = 0; angle_idx < angles.size(); ++angle_idx) {
+            const Angle& angle = angles[angle_idx];
 
-        // 排序后检查唯一值数量
-        std::sort(alts.begin(), alts.end());
-        std::sort(azis.begin(), azis.end());
-        size_t unique_alts = std::unique(alts.begin(), alts.end()) - alts.begin();
-        size_t unique_azis = std::unique(azis.begin(), azis.end()) - azis.begin();
-
-        if (unique_alts < 2 || unique_azis < 2) {
-            // 无法形成四边形，退化为反距离权重插值
-            double sum_weights = 0.0;
-            double weighted_value = 0.0;
-
-            for (const auto& [alt, azi, value] : nearest) {
-                double dist = angular_distance(target_alt, target_azi, alt, azi);
-                double weight = 1.0 / (dist * dist + 1e-9);  // 反距离平方权重
+            // 写入CSV行
+            csv_file << std::fixed << std::setprecision(1) << angle.altitude << "," << angle.azimuth;
+            for (size_t solid_idx = 0; solid_idx < solid_names.size(); ++solid_idx) {
+                const double rate = rates[angle_idx * solid_names.size() + solid_idx];
+                csv_file << "," << std::setprecision(4) << rate;
 
-                sum_weights += weight;
-                weighted_value += weight * value;
+                //记录表格
+                shadow_table_.set(static_cast<int>(solid_idx), angle.alt_idx, angle.azi_idx, rate);
             }
+            csv_file << "\n";
+        }
 
-            return weighted_value / sum_weights;
+        // 自适应模式：在均匀网格之上逐层细分，细分产生的角度追加到CSV末尾
+        adaptive_ = false;
+        if (refinement.enabled()) {
+            refine(units, refinement, csv_file);
         }
 
-        // 双线性插值（假设4个点能形成矩形网格）
-        // 1. 找到最接近的两个高度角和方位角
-        double min_alt = std::min(alts[0], alts[1]);
-        double max_alt = std::max(alts[2], alts[3]);
-        double min_azi = std::min(azis[0], azis[1]);
-        double max_azi = std::max(azis[2], azis[3]);
+        std::cout << "\n批量计算完成，结果已导出至: " << output_file << std::endl;
+    }
 
-        // 2. 将目标点归一化到[0,1]范围
-        double u = (target_alt - min_alt) / (max_alt - min_alt);
-        double v = (target_azi - min_azi) / (max_azi - min_azi);
+    // 表面名→整数ID（找不到返回-1），调用方应在初始化时解析一次并缓存
+    [[nodiscard]] int surfaceId(const std::string& surface) const {
+        return shadow_table_.surfaceId(surface);
+    }
 
-        // 3. 确保归一化值在有效范围内
-        u = std::clamp(u, 0.0, 1.0);
-        v = std::clamp(v, 0.0, 1.0);
+    [[nodiscard]] const ShadowTable& shadowTable() const {
+        return shadow_table_;
+    }
 
-        // 4. 查找4个角点的值（简化版，实际应按网格位置匹配）
-        double q11 = 0.0, q12 = 0.0, q21 = 0.0, q22 = 0.0;
+    // 直接设置遮挡表（如从缓存加载），替代batchCalculate
+    void setShadowTable(ShadowTable table) {
+        shadow_table_ = std::move(table);
+        on_demand_ = false;
+        adaptive_ = false;
+    }
 
-        // 这里简化处理，假设已按高度角和方位角排序
-        // 实际应用中可能需要更复杂的匹配逻辑
-        q11 = std::get<2>(nearest[0]);  // 左下角
-        q12 = std::get<2>(nearest[1]);  // 左上角
-        q21 = std::get<2>(nearest[2]);  // 右下角
-        q22 = std::get<2>(nearest[3]);  // 右上角
+    [[nodiscard]] bool adaptive() const {
+        return adaptive_;
+    }
 
-        // 5. 执行双线性插值
-        double result = (1 - u) * (1 - v) * q11 +
-                        u * (1 - v) * q21 +
-                        (1 - u) * v * q12 +
-                        u * v * q22;
+    [[nodiscard]] const ShadowQuadTree& quadTree() const {
+        return quadtree_;
+    }
 
-        return result;
+    // 设置自适应四叉树（如从缓存加载），此后查询走四叉树
+    void setQuadTree(ShadowQuadTree tree) {
+        quadtree_ = std::move(tree);
+        adaptive_ = !quadtree_.empty();
     }
 
-    double find_closest_value(double target_alt, double target_azi, const std::string& surface) {
-        // 收集该表面名下的所有角度对和对应值
-        std::vector<std::tuple<double, double, double>> candidates;  // (alt, azi, value)
-        for (const auto& [key, value] : shadow_table) {
-            auto [alt, azi, s] = key;
-            if (s == surface) {
-                candidates.emplace_back(alt, azi, value);  // 假设shadow_table的值现在是double
-            }
-        }
+    // 进入按需计算模式：只构建遮挡物和空网格，网格节点在首次用到时计算并记忆
+    // meshMap（SolidMesh或SampleSolid）由调用方持有，须在分析器使用期间保持有效；initial非空时沿用其中已计算的节点
+    template <typename Solid>
+    void prepareOnDemand(
+        const StlModel& model,
+        const std::map<std::string, Solid>& meshMap,
+        const AngleGrid& altitude, const AngleGrid& azimuth,
+        const ShadowTable* initial = nullptr
+    ) {
+        loadOccluders(model);
+        demand_units_ = make_work_units(meshMap);
 
-        // 若该表面无任何数据，抛出异常
-        if (candidates.empty()) {
-            throw std::out_of_range("无表面 " + surface + " 的任何数据");
+        std::vector<std::string> solid_names;
+        for (const auto& [name, _] : meshMap) {
+            solid_names.push_back(name);
         }
-
-        // 查找距离最小的候选者
-        double min_distance = std::numeric_limits<double>::max();
-        double best_value = -1.0;  // 改为double类型
-
-        for (const auto& [alt, azi, value] : candidates) {
-            double dist = angle_distance(target_alt, target_azi, alt, azi);
-            if (dist < min_distance) {
-                min_distance = dist;
-                best_value = value;
-            }
+        if (initial && initial->surfaceNames() == solid_names) {
+            shadow_table_ = *initial;
+        } else {
+            shadow_table_.reset(solid_names, altitude, azimuth);
         }
+        sampling_.clear();
+        on_demand_ = true;
+        adaptive_ = false;
+        if (!shadow_table_.hasViewFactors()) {
+            compute_view_factors(demand_units_, solid_names.size());
+        }
+    }
 
-        // 输出查找结果（便于调试）
-        // std::cout << "警告：未找到精确匹配，使用最相近数据（距离=" << min_distance << "°）\n";
-        return best_value;
+    [[nodiscard]] bool onDemand() const {
+        return on_demand_;
     }
 
-    double get_shadow_value(double altitude, double azimuth, const std::string& surface) {
-        //std::cout<<altitude<< azimuth<<surface<<std::endl;
-        // 处理方位角360°等效于0°
-        if (std::abs(azimuth - 360.0) < 1e-6) {
-            azimuth = 0.0;
+    // 按需计算模式下，一次性批量计算给定太阳位置(高度角, 方位角)所在网格单元的角点
+    // 返回新计算的节点数
+    size_t precompute(const std::vector<std::pair<double, double>>& sun_positions) {
+        if (!on_demand_) return 0;
+        std::lock_guard<std::mutex> lock(demand_mutex_);
+
+        std::vector<uint8_t> mark(shadow_table_.knownMask().size(), 0);
+        std::vector<GridNode> nodes;
+        for (const auto& [altitude, azimuth] : sun_positions) {
+            if (altitude <= 0) continue;
+            collect_missing(shadow_table_.cell(altitude, azimuth), mark, nodes);
         }
+        compute_nodes(nodes);
+        return nodes.size();
+    }
 
+    // 查询遮挡值：在稠密网格上双线性插值，方位角按360°回绕
+    // 自适应模式下在四叉树叶子内插值；按需计算模式下，所在单元的角点未计算时先计算
+    [[nodiscard]] double get_shadow_value(double altitude, double azimuth, int surface_id) {
         if (altitude<=0) {
             return 0.0;
         }
+        if (adaptive_) {
+            return quadtree_.lookup(surface_id, altitude, azimuth);
+        }
+        if (shadow_table_.empty()) {
+            throw std::runtime_error("尚未进行批量计算，遮挡表为空");
+        }
+        const auto cell = shadow_table_.cell(altitude, azimuth);
+        if (on_demand_) {
+            std::lock_guard<std::mutex> lock(demand_mutex_);
+            if (!shadow_table_.known(cell.a0, cell.z0) || !shadow_table_.known(cell.a0, cell.z1) ||
+                !shadow_table_.known(cell.a1, cell.z0) || !shadow_table_.known(cell.a1, cell.z1)) {
+                std::vector<uint8_t> mark(shadow_table_.knownMask().size(), 0);
+                std::vector<GridNode> nodes;
+                collect_missing(cell, mark, nodes);
+                compute_nodes(nodes);
+            }
+            return shadow_table_.lookup(surface_id, cell);
+        }
+        return shadow_table_.lookup(surface_id, cell);
+    }
 
-        Key key = std::make_tuple(altitude, azimuth, surface);
-        auto it = shadow_table.find(key);
-
-        if (it != shadow_table.end()) {
-            return it->second;
+    [[nodiscard]] double get_shadow_value(double altitude, double azimuth, const std::string& surface) {
+        const int id = surfaceId(surface);
+        if (id < 0) {
+            throw std::out_of_range("无表面 " + surface + " 的任何数据");
         }
-        // 4. 精确匹配不存在，查找最相近的值
-        //return find_closest_value(altitude, azimuth, surface);
-        return find_quad_interpolation(altitude, azimuth, surface);
+        return get_shadow_value(altitude, azimuth, id);
     }
 
 private:
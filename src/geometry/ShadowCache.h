@@ -0,0 +1,359 @@
+//
+// Created by zhou on 25-7-17.
+//
+
+#ifndef SHADOWCACHE_H
+#define SHADOWCACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <MappedFile.h>
+
+#include "ShadowQuadTree.h"
+#include "ShadowTable.h"
+
+namespace geom {
+
+// 64位FNV-1a哈希（用于几何内容和计算参数的指纹）
+class Fnv1a64 {
+public:
+    void update(const void* data, size_t size) {
+        const auto* p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash_ ^= p[i];
+            hash_ *= 0x100000001b3ULL;
+        }
+    }
+
+    template <typename T>
+    void update_value(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "只能对平凡类型直接取哈希");
+        update(&value, sizeof(T));
+    }
+
+    // 字符串带长度写入，避免"ab"+"c"与"a"+"bc"冲突
+    void update_string(const std::string& s) {
+        update_value<uint64_t>(s.size());
+        update(s.data(), s.size());
+    }
+
+    [[nodiscard]] uint64_t digest() const { return hash_; }
+
+private:
+    uint64_t hash_ = 0xcbf29ce484222325ULL;
+};
+
+// 文件内容哈希
+inline uint64_t hash_file_content(const std::string& path) {
+    const util::MappedFile file(path);
+    Fnv1a64 h;
+    h.update(file.data(), file.size());
+    return h.digest();
+}
+
+// 遮挡表缓存的键：STL内容、分析表面、细分参数、角度网格共同决定计算结果
+struct ShadowCacheKey {
+    uint64_t stl_hash = 0;
+    std::vector<std::string> surface_names;
+    double max_area = 0.0;
+    int max_level = 0;
+    double altitude[3] = {0, 0, 0};  // 起始、结束、步长
+    double azimuth[3] = {0, 0, 0};
+    int occlusion_method = 0;   // 遮挡判定引擎
+    int raster_resolution = 0;  // 光栅化引擎的深度图分辨率（射线投射时为0）
+    double adaptive_tolerance = 0.0;  // 自适应细分容差与最大深度（不细分时为0）
+    int adaptive_depth = 0;
+    double progressive_tolerance = 0.0;  // 渐进采样的误差容差与起始层数（不启用时为0）
+    int progressive_start_level = 0;
+    int geometry_precision = 0;  // 射线求交精度（双精度为0，单精度为1）
+
+    [[nodiscard]] uint64_t digest() const {
+        Fnv1a64 h;
+        h.update_value(stl_hash);
+        h.update_value<uint64_t>(surface_names.size());
+        for (const auto& name : surface_names) {
+            h.update_string(name);
+        }
+        h.update_value(max_area);
+        h.update_value(max_level);
+        h.update(altitude, sizeof(altitude));
+        h.update(azimuth, sizeof(azimuth));
+        h.update_value(occlusion_method);
+        h.update_value(raster_resolution);
+        h.update_value(adaptive_tolerance);
+        h.update_value(adaptive_depth);
+        h.update_value(progressive_tolerance);
+        h.update_value(progressive_start_level);
+        h.update_value(geometry_precision);
+        return h.digest();
+    }
+};
+
+// 缓存文件格式（小端、按原生布局存放，可直接mmap读取）：
+//   [ShadowCacheHeader][表面名: uint32长度+字节]...[补齐到64字节][double网格值][uint8节点已计算标记]
+//   [补齐到8字节][double天空视角系数][double地面视角系数]（各表面一个）
+//   [补齐到64字节][四叉树节点][四叉树顶点][double四叉树顶点值]（仅自适应模式）
+// checksum为整个文件（checksum字段按0计）的FNV-1a哈希，读取时校验，截断或损坏的文件不会被使用
+struct ShadowCacheHeader {
+    static constexpr char kMagic[8] = {'B', 'C', 'S', 'H', 'D', 'T', 'B', 'L'};
+    static constexpr uint32_t kVersion = 6;
+    static constexpr uint32_t kByteOrder = 0x01020304;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t key;
+    int32_t surface_count;
+    int32_t alt_count;
+    int32_t azi_count;
+    int32_t reserved;
+    double alt_start;
+    double alt_step;
+    double azi_start;
+    double azi_step;
+    uint64_t values_offset;
+    uint64_t values_count;
+    uint64_t known_offset;
+    uint64_t known_count;
+    uint64_t view_offset;
+    uint64_t view_count;  // 表面数（天空、地面视角系数各一组；未计算时为0）
+    uint64_t tree_node_offset;
+    uint64_t tree_node_count;
+    uint64_t tree_vertex_offset;
+    uint64_t tree_vertex_count;
+    uint64_t tree_value_offset;
+    uint64_t tree_value_count;
+    uint64_t checksum;
+};
+static_assert(std::is_trivially_copyable_v<ShadowCacheHeader>);
+
+// 缓存中的一段定长记录数组：检查范围后拷出
+template <typename T>
+inline bool read_cache_array(const util::MappedFile& file, uint64_t offset, uint64_t count, std::vector<T>& out) {
+    if (offset > file.size() || (file.size() - offset) / sizeof(T) < count) {
+        return false;
+    }
+    out.resize(count);
+    std::memcpy(out.data(), file.data() + offset, count * sizeof(T));
+    return true;
+}
+
+// 缓存文件的校验和（checksum字段按0计）
+inline uint64_t shadow_cache_checksum(const ShadowCacheHeader& header, const char* body, size_t body_size) {
+    ShadowCacheHeader zeroed = header;
+    zeroed.checksum = 0;
+    Fnv1a64 h;
+    h.update_value(zeroed);
+    h.update(body, body_size);
+    return h.digest();
+}
+
+// 读取缓存；文件不存在、键不匹配或内容损坏时返回false
+// tree非空且缓存中含自适应四叉树时一并读取
+inline bool read_shadow_cache(const std::string& path, uint64_t key, ShadowTable& table,
+                              ShadowQuadTree* tree = nullptr) {
+    if (!std::filesystem::exists(path)) {
+        return false;
+    }
+
+    try {
+        const util::MappedFile file(path);
+        ShadowCacheHeader header{};
+        if (file.size() < sizeof(header)) {
+            std::cerr << "警告：遮挡表缓存文件损坏: " << path << std::endl;
+            return false;
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+
+        if (std::memcmp(header.magic, ShadowCacheHeader::kMagic, sizeof(header.magic)) != 0 ||
+            header.version != ShadowCacheHeader::kVersion ||
+            header.byte_order != ShadowCacheHeader::kByteOrder) {
+            std::cerr << "警告：遮挡表缓存格式不兼容: " << path << std::endl;
+            return false;
+        }
+        if (header.key != key) {
+            std::cout << "几何或计算参数已变化，遮挡表缓存失效: " << path << std::endl;
+            return false;
+        }
+        if (header.checksum != shadow_cache_checksum(header, file.data() + sizeof(header), file.size() - sizeof(header))) {
+            std::cerr << "警告：遮挡表缓存文件损坏（校验和不符）: " << path << std::endl;
+            return false;
+        }
+        // 网格大小与数组长度一致且在文件范围内，才按网格大小分配内存
+        const uint64_t node_count = static_cast<uint64_t>(std::max(header.alt_count, 0)) *
+                                    static_cast<uint64_t>(std::max(header.azi_count, 0));
+        if (header.surface_count < 0 || node_count == 0 || header.known_count != node_count ||
+            header.values_count / node_count != static_cast<uint64_t>(header.surface_count) ||
+            header.values_count % node_count != 0 ||
+            header.values_count > file.size() / sizeof(double)) {
+            std::cerr << "警告：遮挡表缓存文件损坏: " << path << std::endl;
+            return false;
+        }
+
+        // 表面名
+        const char* p = file.data() + sizeof(header);
+        const char* end = file.end();
+        std::vector<std::string> names;
+        for (int32_t i = 0; i < header.surface_count; ++i) {
+            uint32_t len = 0;
+            if (end - p < static_cast<std::ptrdiff_t>(sizeof(len))) return false;
+            std::memcpy(&len, p, sizeof(len));
+            p += sizeof(len);
+            if (end - p < static_cast<std::ptrdiff_t>(len)) return false;
+            names.emplace_back(p, len);
+            p += len;
+        }
+
+        table.reset(names,
+                    AngleGrid{header.alt_start, header.alt_step, header.alt_count},
+                    AngleGrid{header.azi_start, header.azi_step, header.azi_count});
+
+        auto& values = table.values();
+        if (header.values_count != values.size() ||
+            header.values_offset > file.size() ||
+            (file.size() - header.values_offset) / sizeof(double) < header.values_count) {
+            std::cerr << "警告：遮挡表缓存文件损坏: " << path << std::endl;
+            return false;
+        }
+        std::memcpy(values.data(), file.data() + header.values_offset, values.size() * sizeof(double));
+
+        auto& known = table.knownMask();
+        if (header.known_count != known.size() ||
+            header.known_offset > file.size() ||
+            file.size() - header.known_offset < header.known_count) {
+            std::cerr << "警告：遮挡表缓存文件损坏: " << path << std::endl;
+            return false;
+        }
+        std::memcpy(known.data(), file.data() + header.known_offset, known.size());
+
+        if (header.view_count > 0) {
+            std::vector<double> view;
+            if (header.view_count != names.size() ||
+                !read_cache_array(file, header.view_offset, header.view_count * 2, view)) {
+                std::cerr << "警告：遮挡表缓存文件损坏: " << path << std::endl;
+                return false;
+            }
+            table.setViewFactors(std::vector<double>(view.begin(), view.begin() + header.view_count),
+                                 std::vector<double>(view.begin() + header.view_count, view.end()));
+        }
+
+        if (tree && header.tree_node_count > 0) {
+            std::vector<ShadowQuadTree::Node> nodes;
+            std::vector<ShadowQuadTree::Vertex> vertices;
+            std::vector<double> tree_values;
+            if (!read_cache_array(file, header.tree_node_offset, header.tree_node_count, nodes) ||
+                !read_cache_array(file, header.tree_vertex_offset, header.tree_vertex_count, vertices) ||
+                !read_cache_array(file, header.tree_value_offset, header.tree_value_count, tree_values)) {
+                std::cerr << "警告：遮挡表缓存文件损坏: " << path << std::endl;
+                return false;
+            }
+            tree->assign(names, table.altitudeGrid(), table.azimuthGrid(), table.wraps(),
+                         std::move(nodes), std::move(vertices), std::move(tree_values));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "警告：读取遮挡表缓存失败: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 写入缓存（先写临时文件再改名，避免并发运行时读到半个文件）
+// tree非空时同时写入自适应四叉树
+inline void write_shadow_cache(const std::string& path, uint64_t key, const ShadowTable& table,
+                               const ShadowQuadTree* tree = nullptr) {
+    const auto& names = table.surfaceNames();
+    const auto& values = table.values();
+
+    ShadowCacheHeader header{};
+    std::memcpy(header.magic, ShadowCacheHeader::kMagic, sizeof(header.magic));
+    header.version = ShadowCacheHeader::kVersion;
+    header.byte_order = ShadowCacheHeader::kByteOrder;
+    header.key = key;
+    header.surface_count = static_cast<int32_t>(names.size());
+    header.alt_count = table.altitudeGrid().count;
+    header.azi_count = table.azimuthGrid().count;
+    header.alt_start = table.altitudeGrid().start;
+    header.alt_step = table.altitudeGrid().step;
+    header.azi_start = table.azimuthGrid().start;
+    header.azi_step = table.azimuthGrid().step;
+    header.values_count = values.size();
+    header.known_count = table.knownMask().size();
+    header.view_count = table.hasViewFactors() ? names.size() : 0;
+
+    std::string name_block;
+    for (const auto& name : names) {
+        const auto len = static_cast<uint32_t>(name.size());
+        name_block.append(reinterpret_cast<const char*>(&len), sizeof(len));
+        name_block.append(name);
+    }
+    const size_t names_end = sizeof(header) + name_block.size();
+    header.values_offset = (names_end + 63) / 64 * 64;
+    header.known_offset = header.values_offset + values.size() * sizeof(double);
+    uint64_t body_end = header.known_offset + header.known_count;
+    if (header.view_count > 0) {
+        header.view_offset = (body_end + 7) / 8 * 8;
+        body_end = header.view_offset + header.view_count * 2 * sizeof(double);
+    }
+    if (tree && !tree->empty()) {
+        header.tree_node_count = tree->nodes().size();
+        header.tree_vertex_count = tree->vertices().size();
+        header.tree_value_count = tree->values().size();
+        header.tree_node_offset = (body_end + 63) / 64 * 64;
+        header.tree_vertex_offset = header.tree_node_offset + header.tree_node_count * sizeof(ShadowQuadTree::Node);
+        header.tree_value_offset = header.tree_vertex_offset + header.tree_vertex_count * sizeof(ShadowQuadTree::Vertex);
+    }
+
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            throw std::runtime_error("无法写入遮挡表缓存: " + tmp_path);
+        }
+        // 头部最后写入（校验和在写完内容后才知道），校验和从头部（checksum按0计）开始累计，与shadow_cache_checksum一致
+        Fnv1a64 hash;
+        hash.update_value(header);
+        out.seekp(sizeof(header));
+        auto emit = [&out, &hash](const void* data, size_t size) {
+            hash.update(data, size);
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        };
+        emit(name_block.data(), name_block.size());
+        const std::string padding(header.values_offset - names_end, '\0');
+        emit(padding.data(), padding.size());
+        emit(values.data(), values.size() * sizeof(double));
+        emit(table.knownMask().data(), table.knownMask().size());
+        if (header.view_count > 0) {
+            const std::string view_padding(header.view_offset - header.known_offset - header.known_count, '\0');
+            emit(view_padding.data(), view_padding.size());
+            emit(table.skyViewFactors().data(), header.view_count * sizeof(double));
+            emit(table.groundViewFactors().data(), header.view_count * sizeof(double));
+        }
+        if (header.tree_node_count > 0) {
+            const std::string tree_padding(header.tree_node_offset - body_end, '\0');
+            emit(tree_padding.data(), tree_padding.size());
+            emit(tree->nodes().data(), tree->nodes().size() * sizeof(ShadowQuadTree::Node));
+            emit(tree->vertices().data(), tree->vertices().size() * sizeof(ShadowQuadTree::Vertex));
+            emit(tree->values().data(), tree->values().size() * sizeof(double));
+        }
+
+        header.checksum = hash.digest();
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (!out) {
+            throw std::runtime_error("写入遮挡表缓存失败: " + tmp_path);
+        }
+    }
+    std::filesystem::rename(tmp_path, path);
+}
+
+}
+
+#endif //SHADOWCACHE_H
@@ -0,0 +1,309 @@
+//
+// Created by zhou on 25-7-20.
+//
+
+#ifndef SHADOWQUADTREE_H
+#define SHADOWQUADTREE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ShadowTable.h"
+
+namespace geom {
+
+// 自适应细分参数：角点受照比例（任一表面，除去无遮挡时的余弦）相差超过tolerance的角度单元递归四分，最多max_depth层
+struct AdaptiveRefinement {
+    double tolerance = 0.02;
+    int max_depth = 0;  // 0表示不细分（均匀网格）
+
+    [[nodiscard]] bool enabled() const { return max_depth > 0; }
+};
+
+// 自适应遮挡表：以均匀粗网格的每个单元为根的(高度角, 方位角)四叉树
+// 顶点（细分产生的角度节点）在相邻单元间共享，每个顶点存放所有表面的值
+// 查询时O(1)定位根单元，再沿四叉树下降O(log n)到叶子，在叶子内双线性插值
+class ShadowQuadTree {
+public:
+    // 四叉树节点；子节点连续存放，顺序为(低高度角,低方位角)、(低,高)、(高,低)、(高,高)
+    struct Node {
+        double alt0, alt1;
+        double azi0, azi1;
+        int32_t corner[4];    // 角点顶点下标，顺序同子节点
+        int32_t first_child;  // -1为叶子
+        int32_t depth;
+    };
+
+    struct Vertex {
+        double altitude;
+        double azimuth;
+    };
+
+    ShadowQuadTree() = default;
+
+    [[nodiscard]] bool empty() const { return nodes_.empty(); }
+    [[nodiscard]] const std::vector<std::string>& surfaceNames() const { return names_; }
+    [[nodiscard]] const AngleGrid& altitudeGrid() const { return alt_; }
+    [[nodiscard]] const AngleGrid& azimuthGrid() const { return azi_; }
+    [[nodiscard]] bool wraps() const { return wraps_; }
+    [[nodiscard]] const std::vector<Node>& nodes() const { return nodes_; }
+    [[nodiscard]] const std::vector<Vertex>& vertices() const { return vertices_; }
+    // 顶点值，按[顶点][表面]存放
+    [[nodiscard]] const std::vector<double>& values() const { return values_; }
+
+    [[nodiscard]] size_t leafCount() const {
+        return static_cast<size_t>(std::count_if(nodes_.begin(), nodes_.end(),
+                                                 [](const Node& n) { return n.first_child < 0; }));
+    }
+
+    [[nodiscard]] int maxDepth() const {
+        int depth = 0;
+        for (const auto& node : nodes_) depth = std::max(depth, node.depth);
+        return depth;
+    }
+
+    // 以均匀网格（已全部计算）为根层建立四叉树
+    void build(const ShadowTable& table) {
+        if (!table.complete()) {
+            throw std::runtime_error("遮挡表尚未全部计算，无法建立自适应四叉树");
+        }
+        init(table.surfaceNames(), table.altitudeGrid(), table.azimuthGrid(), table.wraps());
+
+        // 根层顶点即均匀网格节点
+        for (int i = 0; i < alt_.count; ++i) {
+            for (int j = 0; j < azi_.count; ++j) {
+                const int32_t v = add_vertex(alt_.value(i), azi_.value(j));
+                for (size_t s = 0; s < names_.size(); ++s) {
+                    values_[static_cast<size_t>(v) * names_.size() + s] = table.at(static_cast<int>(s), i, j);
+                }
+            }
+        }
+
+        // 根单元
+        for (int i = 0; i < alt_.count - 1; ++i) {
+            for (int j = 0; j < azimuth_cells(); ++j) {
+                const int j1 = (j + 1) % azi_.count;
+                Node node{};
+                node.alt0 = alt_.value(i);
+                node.alt1 = alt_.value(i + 1);
+                node.azi0 = azi_.value(j);
+                node.azi1 = azi_.value(j + 1);
+                node.corner[0] = grid_vertex(i, j);
+                node.corner[1] = grid_vertex(i, j1);
+                node.corner[2] = grid_vertex(i + 1, j);
+                node.corner[3] = grid_vertex(i + 1, j1);
+                node.first_child = -1;
+                node.depth = 0;
+                nodes_.push_back(node);
+            }
+        }
+    }
+
+    // 从缓存恢复
+    void assign(const std::vector<std::string>& surface_names, const AngleGrid& altitude, const AngleGrid& azimuth,
+                bool wraps, std::vector<Node> nodes, std::vector<Vertex> vertices, std::vector<double> values) {
+        init(surface_names, altitude, azimuth, wraps);
+        if (values.size() != vertices.size() * names_.size()) {
+            throw std::runtime_error("自适应遮挡表数据不一致");
+        }
+        for (const auto& node : nodes) {
+            for (const int32_t c : node.corner) {
+                if (c < 0 || static_cast<size_t>(c) >= vertices.size()) {
+                    throw std::runtime_error("自适应遮挡表数据不一致");
+                }
+            }
+            if (node.first_child >= 0 && static_cast<size_t>(node.first_child) + 4 > nodes.size()) {
+                throw std::runtime_error("自适应遮挡表数据不一致");
+            }
+        }
+        if (nodes.size() < root_count()) {
+            throw std::runtime_error("自适应遮挡表数据不一致");
+        }
+        nodes_ = std::move(nodes);
+        vertices_ = std::move(vertices);
+        values_ = std::move(values);
+        for (size_t v = 0; v < vertices_.size(); ++v) {
+            vertex_ids_[vertex_key(vertices_[v].altitude, vertices_[v].azimuth)] = static_cast<int32_t>(v);
+        }
+    }
+
+    // 节点角点受照比例的最大差（所有表面中的最大值）
+    // 顶点值是受照余弦的面积加权平均，没有遮挡时也随太阳方向变化，比较前除以无遮挡时的值
+    // （reference，按[顶点][表面]存放），只有遮挡的变化才引起细分
+    // 无遮挡值很小（背向或掠射）的角点受照比例没有意义，不参与比较
+    [[nodiscard]] double spread(int32_t node_idx, const std::vector<double>& reference) const {
+        constexpr double kMinReference = 1e-3;
+        const Node& node = nodes_[node_idx];
+        double result = 0.0;
+        for (size_t s = 0; s < names_.size(); ++s) {
+            double lo = 1.0, hi = 0.0;
+            for (const int32_t c : node.corner) {
+                const double ref = reference[static_cast<size_t>(c) * names_.size() + s];
+                if (ref < kMinReference) continue;
+                const double fraction = std::clamp(value(c, s) / ref, 0.0, 1.0);
+                lo = std::min(lo, fraction);
+                hi = std::max(hi, fraction);
+            }
+            result = std::max(result, hi - lo);
+        }
+        return result;
+    }
+
+    // 将叶子四分，新产生的顶点（尚无值）追加到new_vertices
+    void subdivide(int32_t node_idx, std::vector<int32_t>& new_vertices) {
+        if (nodes_[node_idx].first_child >= 0) return;
+        const Node parent = nodes_[node_idx];
+        const double alt_mid = 0.5 * (parent.alt0 + parent.alt1);
+        const double azi_mid = 0.5 * (parent.azi0 + parent.azi1);
+
+        auto vertex_at = [&](double altitude, double azimuth) {
+            const size_t before = vertices_.size();
+            const int32_t v = add_vertex(altitude, azimuth);
+            if (vertices_.size() > before) new_vertices.push_back(v);
+            return v;
+        };
+        const int32_t left = vertex_at(alt_mid, parent.azi0);
+        const int32_t right = vertex_at(alt_mid, parent.azi1);
+        const int32_t bottom = vertex_at(parent.alt0, azi_mid);
+        const int32_t top = vertex_at(parent.alt1, azi_mid);
+        const int32_t center = vertex_at(alt_mid, azi_mid);
+
+        const auto first = static_cast<int32_t>(nodes_.size());
+        const double alts[3] = {parent.alt0, alt_mid, parent.alt1};
+        const double azis[3] = {parent.azi0, azi_mid, parent.azi1};
+        const int32_t grid[3][3] = {
+            {parent.corner[0], bottom, parent.corner[1]},
+            {left, center, right},
+            {parent.corner[2], top, parent.corner[3]},
+        };
+        for (int a = 0; a < 2; ++a) {
+            for (int z = 0; z < 2; ++z) {
+                Node child{};
+                child.alt0 = alts[a];
+                child.alt1 = alts[a + 1];
+                child.azi0 = azis[z];
+                child.azi1 = azis[z + 1];
+                child.corner[0] = grid[a][z];
+                child.corner[1] = grid[a][z + 1];
+                child.corner[2] = grid[a + 1][z];
+                child.corner[3] = grid[a + 1][z + 1];
+                child.first_child = -1;
+                child.depth = parent.depth + 1;
+                nodes_.push_back(child);
+            }
+        }
+        nodes_[node_idx].first_child = first;
+    }
+
+    void setValue(int32_t vertex, int surface_id, double v) {
+        values_[static_cast<size_t>(vertex) * names_.size() + surface_id] = v;
+    }
+
+    [[nodiscard]] double value(int32_t vertex, size_t surface_id) const {
+        return values_[static_cast<size_t>(vertex) * names_.size() + surface_id];
+    }
+
+    // 查询：定位根单元后沿四叉树下降到叶子，在叶子内双线性插值
+    [[nodiscard]] double lookup(int surface_id, double altitude, double azimuth) const {
+        if (surface_id < 0 || surface_id >= static_cast<int>(names_.size())) {
+            throw std::out_of_range("无效的表面ID: " + std::to_string(surface_id));
+        }
+        if (nodes_.empty()) {
+            throw std::runtime_error("自适应遮挡表为空");
+        }
+
+        // 高度角截断到网格范围，方位角整圆时回绕，否则截断
+        altitude = std::clamp(altitude, alt_.start, alt_.end());
+        if (wraps_) {
+            azimuth = std::fmod(azimuth - azi_.start, 360.0);
+            if (azimuth < 0) azimuth += 360.0;
+            azimuth += azi_.start;
+        } else {
+            azimuth = std::clamp(azimuth, azi_.start, azi_.end());
+        }
+        const int i = std::clamp(static_cast<int>((altitude - alt_.start) / alt_.step), 0, alt_.count - 2);
+        const int j = std::clamp(static_cast<int>((azimuth - azi_.start) / azi_.step), 0, azimuth_cells() - 1);
+
+        const Node* node = &nodes_[static_cast<size_t>(i) * azimuth_cells() + j];
+        while (node->first_child >= 0) {
+            const int a = altitude >= 0.5 * (node->alt0 + node->alt1) ? 1 : 0;
+            const int z = azimuth >= 0.5 * (node->azi0 + node->azi1) ? 1 : 0;
+            node = &nodes_[node->first_child + a * 2 + z];
+        }
+
+        const double fa = std::clamp((altitude - node->alt0) / (node->alt1 - node->alt0), 0.0, 1.0);
+        const double fz = std::clamp((azimuth - node->azi0) / (node->azi1 - node->azi0), 0.0, 1.0);
+        const double q00 = value(node->corner[0], surface_id);
+        const double q01 = value(node->corner[1], surface_id);
+        const double q10 = value(node->corner[2], surface_id);
+        const double q11 = value(node->corner[3], surface_id);
+        return (1 - fa) * (1 - fz) * q00 +
+               fa * (1 - fz) * q10 +
+               (1 - fa) * fz * q01 +
+               fa * fz * q11;
+    }
+
+private:
+    std::vector<std::string> names_;
+    AngleGrid alt_;
+    AngleGrid azi_;
+    bool wraps_ = false;
+    std::vector<Node> nodes_;       // 前root_count()个为根单元，按[高度角][方位角]存放
+    std::vector<Vertex> vertices_;
+    std::vector<double> values_;    // [顶点][表面]
+    std::map<std::pair<double, double>, int32_t> vertex_ids_;  // 角度→顶点下标（建树时去重）
+
+    void init(const std::vector<std::string>& surface_names, const AngleGrid& altitude, const AngleGrid& azimuth,
+              bool wraps) {
+        names_ = surface_names;
+        alt_ = altitude;
+        azi_ = azimuth;
+        wraps_ = wraps;
+        if (alt_.count < 2 || azimuth_cells() < 1) {
+            throw std::invalid_argument("自适应遮挡表至少需要一个角度单元");
+        }
+        nodes_.clear();
+        vertices_.clear();
+        values_.clear();
+        vertex_ids_.clear();
+    }
+
+    [[nodiscard]] int azimuth_cells() const {
+        return wraps_ ? azi_.count : azi_.count - 1;
+    }
+
+    [[nodiscard]] size_t root_count() const {
+        return static_cast<size_t>(alt_.count - 1) * azimuth_cells();
+    }
+
+    [[nodiscard]] int32_t grid_vertex(int alt_idx, int azi_idx) const {
+        return alt_idx * azi_.count + azi_idx;
+    }
+
+    // 整圆时360°与0°为同一方位角
+    [[nodiscard]] std::pair<double, double> vertex_key(double altitude, double azimuth) const {
+        if (wraps_ && azimuth >= azi_.start + 360.0 - 1e-9) azimuth -= 360.0;
+        return {altitude, azimuth};
+    }
+
+    int32_t add_vertex(double altitude, double azimuth) {
+        const auto key = vertex_key(altitude, azimuth);
+        const auto it = vertex_ids_.find(key);
+        if (it != vertex_ids_.end()) return it->second;
+        const auto v = static_cast<int32_t>(vertices_.size());
+        vertices_.push_back({key.first, key.second});
+        values_.resize(values_.size() + names_.size(), 0.0);
+        vertex_ids_.emplace(key, v);
+        return v;
+    }
+};
+
+}
+
+#endif //SHADOWQUADTREE_H
@@ -0,0 +1,5 @@
+//
+// Created by zhou on 25-7-16.
+//
+
+#include "ShadowTable.h"
@@ -0,0 +1,222 @@
+//
+// Created by zhou on 25-7-16.
+//
+
+#ifndef SHADOWTABLE_H
+#define SHADOWTABLE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace geom {
+
+// 均匀角度网格：start + i*step，i∈[0, count)
+struct AngleGrid {
+    double start = 0.0;
+    double step = 1.0;
+    int count = 0;
+
+    [[nodiscard]] double value(int i) const { return start + i * step; }
+    [[nodiscard]] double end() const { return value(count - 1); }
+
+    // 由[start, end]范围和步长构造（包含端点）
+    static AngleGrid from_range(double start, double end, double step) {
+        return {start, step, static_cast<int>(std::floor((end - start) / step + 1e-6)) + 1};
+    }
+};
+
+// 稠密遮挡查询表：每个表面一张(高度角, 方位角)二维网格，O(1)双线性插值
+// 方位角覆盖整圆时按360°周期回绕，否则在边界处截断
+// 每个网格节点记录是否已计算（所有表面同时计算），按需计算模式下只填充用到的节点
+class ShadowTable {
+public:
+    // 查询点所在的网格单元：四个角点下标及单元内插值系数
+    struct Cell {
+        int a0, a1;  // 高度角下标
+        int z0, z1;  // 方位角下标
+        double fa, fz;
+    };
+
+    ShadowTable() = default;
+
+    // 初始化表格；方位角网格若首尾相差360°，最后一列与第一列重合，只保留一份
+    void reset(const std::vector<std::string>& surface_names, const AngleGrid& altitude, const AngleGrid& azimuth) {
+        if (altitude.count < 1 || azimuth.count < 1 || altitude.step <= 0 || azimuth.step <= 0) {
+            throw std::invalid_argument("无效的遮挡表网格");
+        }
+        names_ = surface_names;
+        ids_.clear();
+        for (size_t i = 0; i < names_.size(); ++i) {
+            ids_[names_[i]] = static_cast<int>(i);
+        }
+
+        alt_ = altitude;
+        azi_ = azimuth;
+        wraps_ = false;
+        if (azi_.count > 1 && std::fabs(azi_.end() - azi_.start - 360.0) < 1e-6) {
+            azi_.count -= 1;
+            wraps_ = true;
+        } else if (std::fabs(azi_.count * azi_.step - 360.0) < 1e-6) {
+            wraps_ = true;
+        }
+        values_.assign(names_.size() * alt_.count * azi_.count, 0.0);
+        known_.assign(static_cast<size_t>(alt_.count) * azi_.count, 0);
+        sky_view_.clear();
+        ground_view_.clear();
+    }
+
+    [[nodiscard]] bool empty() const { return values_.empty(); }
+    [[nodiscard]] const AngleGrid& altitudeGrid() const { return alt_; }
+    [[nodiscard]] const AngleGrid& azimuthGrid() const { return azi_; }
+    [[nodiscard]] const std::vector<std::string>& surfaceNames() const { return names_; }
+    // 方位角是否按360°回绕
+    [[nodiscard]] bool wraps() const { return wraps_; }
+    // 全部网格值，按[表面][高度角][方位角]连续存放（用于缓存读写）
+    [[nodiscard]] const std::vector<double>& values() const { return values_; }
+    [[nodiscard]] std::vector<double>& values() { return values_; }
+    // 各网格节点是否已计算，按[高度角][方位角]存放
+    [[nodiscard]] const std::vector<uint8_t>& knownMask() const { return known_; }
+    [[nodiscard]] std::vector<uint8_t>& knownMask() { return known_; }
+
+    [[nodiscard]] bool known(int alt_idx, int azi_idx) const {
+        return known_[static_cast<size_t>(alt_idx) * azi_.count + azi_idx] != 0;
+    }
+
+    // 已计算的节点数
+    [[nodiscard]] size_t knownCount() const {
+        return static_cast<size_t>(std::count(known_.begin(), known_.end(), uint8_t{1}));
+    }
+
+    [[nodiscard]] bool complete() const {
+        return !known_.empty() && knownCount() == known_.size();
+    }
+
+    // 表面名→整数ID（找不到返回-1），应在初始化阶段解析一次
+    [[nodiscard]] int surfaceId(const std::string& surface) const {
+        const auto it = ids_.find(surface);
+        return it == ids_.end() ? -1 : it->second;
+    }
+
+    // 各表面的天空/地面视角系数（与太阳方向无关，每个表面一个值）
+    [[nodiscard]] bool hasViewFactors() const { return !sky_view_.empty(); }
+    [[nodiscard]] const std::vector<double>& skyViewFactors() const { return sky_view_; }
+    [[nodiscard]] const std::vector<double>& groundViewFactors() const { return ground_view_; }
+
+    void setViewFactors(std::vector<double> sky, std::vector<double> ground) {
+        if (sky.size() != names_.size() || ground.size() != names_.size()) {
+            throw std::invalid_argument("视角系数个数与表面数不一致");
+        }
+        sky_view_ = std::move(sky);
+        ground_view_ = std::move(ground);
+    }
+
+    [[nodiscard]] double skyViewFactor(int surface_id) const {
+        return view_factor(sky_view_, surface_id);
+    }
+
+    [[nodiscard]] double groundViewFactor(int surface_id) const {
+        return view_factor(ground_view_, surface_id);
+    }
+
+    // 写入网格点(alt_idx, azi_idx)的值并标记为已计算；回绕时azi_idx==count对应第0列
+    void set(int surface_id, int alt_idx, int azi_idx, double value) {
+        if (wraps_ && azi_idx == azi_.count) {
+            // 360°与0°为同一列，保留先写入的0°
+            return;
+        }
+        values_[index(surface_id, alt_idx, azi_idx)] = value;
+        known_[static_cast<size_t>(alt_idx) * azi_.count + azi_idx] = 1;
+    }
+
+    [[nodiscard]] double at(int surface_id, int alt_idx, int azi_idx) const {
+        return values_[index(surface_id, alt_idx, azi_idx)];
+    }
+
+    // 定位查询点所在的网格单元
+    [[nodiscard]] Cell cell(double altitude, double azimuth) const {
+        Cell c{};
+        // 高度角：截断到网格范围
+        locate(alt_, altitude, false, c.a0, c.a1, c.fa);
+        // 方位角：整圆时回绕，否则截断
+        locate(azi_, azimuth, wraps_, c.z0, c.z1, c.fz);
+        return c;
+    }
+
+    // 双线性插值查询
+    [[nodiscard]] double lookup(int surface_id, double altitude, double azimuth) const {
+        return lookup(surface_id, cell(altitude, azimuth));
+    }
+
+    [[nodiscard]] double lookup(int surface_id, const Cell& c) const {
+        if (surface_id < 0 || surface_id >= static_cast<int>(names_.size())) {
+            throw std::out_of_range("无效的表面ID: " + std::to_string(surface_id));
+        }
+
+        const double q00 = at(surface_id, c.a0, c.z0);
+        const double q01 = at(surface_id, c.a0, c.z1);
+        const double q10 = at(surface_id, c.a1, c.z0);
+        const double q11 = at(surface_id, c.a1, c.z1);
+        return (1 - c.fa) * (1 - c.fz) * q00 +
+               c.fa * (1 - c.fz) * q10 +
+               (1 - c.fa) * c.fz * q01 +
+               c.fa * c.fz * q11;
+    }
+
+private:
+    std::vector<std::string> names_;
+    std::map<std::string, int> ids_;
+    AngleGrid alt_;
+    AngleGrid azi_;
+    bool wraps_ = false;
+    std::vector<double> values_;  // [表面][高度角][方位角]
+    std::vector<uint8_t> known_;  // [高度角][方位角]
+    std::vector<double> sky_view_;     // [表面]
+    std::vector<double> ground_view_;  // [表面]
+
+    static double view_factor(const std::vector<double>& factors, int surface_id) {
+        if (surface_id < 0 || surface_id >= static_cast<int>(factors.size())) {
+            throw std::out_of_range("无效的表面ID或尚未计算视角系数: " + std::to_string(surface_id));
+        }
+        return factors[surface_id];
+    }
+
+    [[nodiscard]] size_t index(int surface_id, int alt_idx, int azi_idx) const {
+        return (static_cast<size_t>(surface_id) * alt_.count + alt_idx) * azi_.count + azi_idx;
+    }
+
+    // 计算角度所在的网格单元及单元内的插值系数
+    static void locate(const AngleGrid& grid, double angle, bool wrap, int& i0, int& i1, double& frac) {
+        double pos = (angle - grid.start) / grid.step;
+        if (wrap) {
+            pos = std::fmod(pos, static_cast<double>(grid.count));
+            if (pos < 0) pos += grid.count;
+            i0 = std::min(static_cast<int>(pos), grid.count - 1);
+            i1 = (i0 + 1) % grid.count;
+            frac = pos - i0;
+            return;
+        }
+        if (grid.count == 1 || pos <= 0) {
+            i0 = i1 = 0;
+            frac = 0.0;
+            return;
+        }
+        if (pos >= grid.count - 1) {
+            i0 = i1 = grid.count - 1;
+            frac = 0.0;
+            return;
+        }
+        i0 = static_cast<int>(pos);
+        i1 = i0 + 1;
+        frac = pos - i0;
+    }
+};
+
+}
+
+#endif //SHADOWTABLE_H
@@ -0,0 +1,67 @@
+//
+// Created by zhou on 25-7-21.
+//
+
+#ifndef SHAREDGEOMETRY_H
+#define SHAREDGEOMETRY_H
+
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "OcclusionEngine.h"
+#include "ShadowAnalyzer.h"
+#include "ShadowCache.h"
+#include "Triangle.h"
+
+namespace geom {
+
+// 一个STL文件的几何数据：解析后的模型、内容哈希，以及按需构建的遮挡场景
+// 解析后只读，由使用它的各表面分组共同持有
+class SharedGeometry {
+public:
+    // 解析STL文件（path应为规范路径，content_hash为文件内容哈希）
+    SharedGeometry(std::string path, uint64_t content_hash)
+        : path_(std::move(path)), content_hash_(content_hash) {
+        std::cout << "正在解析STL文件: " << path_ << std::endl;
+        model_ = parseStlFile(path_);
+        std::cout << "解析完成，模型包含 " << model_.size() << " 个三角面\n";
+    }
+
+    [[nodiscard]] const std::string& path() const { return path_; }
+    [[nodiscard]] uint64_t contentHash() const { return content_hash_; }
+    [[nodiscard]] const StlModel& model() const { return model_; }
+
+    // 遮挡场景（首次请求时构建，之后共享；射线投射引擎需要带BVH的场景，单精度引擎还需要单精度副本）
+    [[nodiscard]] std::shared_ptr<const OccluderScene> occluderScene(bool with_bvh, bool with_float = false) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& scene = scenes_[(with_bvh ? 1 : 0) + (with_float ? 2 : 0)];
+        if (!scene) {
+            // 已有同样带/不带BVH的双精度场景时只补单精度副本，不再重建BVH
+            const auto& base = scenes_[with_bvh ? 1 : 0];
+            scene = with_float && base ? OccluderScene::extend(*base, with_bvh, true)
+                                       : collect_occluder_scene(model_, with_bvh, with_float);
+        }
+        return scene;
+    }
+
+private:
+    std::string path_;
+    uint64_t content_hash_;
+    StlModel model_;
+
+    mutable std::mutex mutex_;
+    mutable std::shared_ptr<const OccluderScene> scenes_[4];  // [不带BVH, 带BVH] × [双精度, 含单精度副本]
+};
+
+// 直接由文件路径创建（不经过注册表，不与其他分组共享）
+inline std::shared_ptr<const SharedGeometry> load_geometry(const std::string& path) {
+    return std::make_shared<const SharedGeometry>(path, hash_file_content(path));
+}
+
+}
+
+#endif //SHAREDGEOMETRY_H
@@ -0,0 +1,460 @@
+//
+// Created by zhou on 25-7-12.
+//
+
+#include "SimdKernel.h"
+
+#include <atomic>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GEOM_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace geom::simd {
+
+    namespace {
+        constexpr double kEpsilon = 1e-8;
+        constexpr float kEpsilonF = 1e-8f;
+
+        using FirstHitFn = int64_t (*)(const OccluderBuffer&, uint32_t, uint32_t, const Point3D&, const Point3D&, int);
+        using FirstHitFnF = int64_t (*)(const OccluderBufferF&, uint32_t, uint32_t, const Point3F&, const Point3F&, int);
+
+        // 有效通道掩码：在范围内且不属于自身表面
+        template <typename T>
+        inline unsigned lane_mask(const BasicOccluderBuffer<T>& occluders, uint32_t i, uint32_t end, int width, int skip_id) {
+            unsigned mask = 0;
+            for (int k = 0; k < width; ++k) {
+                if (i + k < end && occluders.ids[i + k] != skip_id) mask |= 1u << k;
+            }
+            return mask;
+        }
+
+#ifdef GEOM_SIMD_X86
+        // 以下各实现的运算顺序与Point3D::cross/dot完全相同，比较使用相同语义（含NaN时的行为），
+        // 因此命中结果与标量版本逐位一致
+
+        __attribute__((target("sse2")))
+        int64_t first_hit_sse2(const OccluderBuffer& occluders, uint32_t first, uint32_t count,
+                               const Point3D& origin, const Point3D& dir, int skip_id) {
+            const __m128d eps = _mm_set1_pd(kEpsilon);
+            const __m128d neg_eps = _mm_set1_pd(-kEpsilon);
+            const __m128d one_eps = _mm_set1_pd(1.0 + kEpsilon);
+            const __m128d one = _mm_set1_pd(1.0);
+            const __m128d abs_mask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+            const __m128d dx = _mm_set1_pd(dir.x), dy = _mm_set1_pd(dir.y), dz = _mm_set1_pd(dir.z);
+            const __m128d ox = _mm_set1_pd(origin.x), oy = _mm_set1_pd(origin.y), oz = _mm_set1_pd(origin.z);
+
+            const uint32_t end = first + count;
+            for (uint32_t i = first; i < end; i += 2) {
+                const unsigned valid = lane_mask(occluders, i, end, 2, skip_id);
+                if (!valid) continue;
+
+                const __m128d e1x = _mm_loadu_pd(&occluders.e1x[i]), e1y = _mm_loadu_pd(&occluders.e1y[i]), e1z = _mm_loadu_pd(&occluders.e1z[i]);
+                const __m128d e2x = _mm_loadu_pd(&occluders.e2x[i]), e2y = _mm_loadu_pd(&occluders.e2y[i]), e2z = _mm_loadu_pd(&occluders.e2z[i]);
+
+                const __m128d hx = _mm_sub_pd(_mm_mul_pd(dy, e2z), _mm_mul_pd(dz, e2y));
+                const __m128d hy = _mm_sub_pd(_mm_mul_pd(dz, e2x), _mm_mul_pd(dx, e2z));
+                const __m128d hz = _mm_sub_pd(_mm_mul_pd(dx, e2y), _mm_mul_pd(dy, e2x));
+                const __m128d a = _mm_add_pd(_mm_add_pd(_mm_mul_pd(e1x, hx), _mm_mul_pd(e1y, hy)), _mm_mul_pd(e1z, hz));
+                const __m128d f = _mm_div_pd(one, a);
+
+                const __m128d sx = _mm_sub_pd(ox, _mm_loadu_pd(&occluders.v0x[i]));
+                const __m128d sy = _mm_sub_pd(oy, _mm_loadu_pd(&occluders.v0y[i]));
+                const __m128d sz = _mm_sub_pd(oz, _mm_loadu_pd(&occluders.v0z[i]));
+                const __m128d u = _mm_mul_pd(f, _mm_add_pd(_mm_add_pd(_mm_mul_pd(sx, hx), _mm_mul_pd(sy, hy)), _mm_mul_pd(sz, hz)));
+
+                const __m128d qx = _mm_sub_pd(_mm_mul_pd(sy, e1z), _mm_mul_pd(sz, e1y));
+                const __m128d qy = _mm_sub_pd(_mm_mul_pd(sz, e1x), _mm_mul_pd(sx, e1z));
+                const __m128d qz = _mm_sub_pd(_mm_mul_pd(sx, e1y), _mm_mul_pd(sy, e1x));
+                const __m128d v = _mm_mul_pd(f, _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, qx), _mm_mul_pd(dy, qy)), _mm_mul_pd(dz, qz)));
+                const __m128d t = _mm_mul_pd(f, _mm_add_pd(_mm_add_pd(_mm_mul_pd(e2x, qx), _mm_mul_pd(e2y, qy)), _mm_mul_pd(e2z, qz)));
+
+                __m128d hit = _mm_cmpnlt_pd(_mm_and_pd(a, abs_mask), eps);
+                hit = _mm_and_pd(hit, _mm_cmpnlt_pd(u, neg_eps));
+                hit = _mm_and_pd(hit, _mm_cmpngt_pd(u, one_eps));
+                hit = _mm_and_pd(hit, _mm_cmpnlt_pd(v, neg_eps));
+                hit = _mm_and_pd(hit, _mm_cmpngt_pd(_mm_add_pd(u, v), one_eps));
+                hit = _mm_and_pd(hit, _mm_cmpgt_pd(t, eps));
+
+                if (const unsigned lanes = static_cast<unsigned>(_mm_movemask_pd(hit)) & valid) return i + __builtin_ctz(lanes);
+            }
+            return -1;
+        }
+
+        __attribute__((target("avx2")))
+        int64_t first_hit_avx2(const OccluderBuffer& occluders, uint32_t first, uint32_t count,
+                               const Point3D& origin, const Point3D& dir, int skip_id) {
+            const __m256d eps = _mm256_set1_pd(kEpsilon);
+            const __m256d neg_eps = _mm256_set1_pd(-kEpsilon);
+            const __m256d one_eps = _mm256_set1_pd(1.0 + kEpsilon);
+            const __m256d one = _mm256_set1_pd(1.0);
+            const __m256d abs_mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+            const __m256d dx = _mm256_set1_pd(dir.x), dy = _mm256_set1_pd(dir.y), dz = _mm256_set1_pd(dir.z);
+            const __m256d ox = _mm256_set1_pd(origin.x), oy = _mm256_set1_pd(origin.y), oz = _mm256_set1_pd(origin.z);
+
+            const uint32_t end = first + count;
+            for (uint32_t i = first; i < end; i += 4) {
+                const unsigned valid = lane_mask(occluders, i, end, 4, skip_id);
+                if (!valid) continue;
+
+                const __m256d e1x = _mm256_loadu_pd(&occluders.e1x[i]), e1y = _mm256_loadu_pd(&occluders.e1y[i]), e1z = _mm256_loadu_pd(&occluders.e1z[i]);
+                const __m256d e2x = _mm256_loadu_pd(&occluders.e2x[i]), e2y = _mm256_loadu_pd(&occluders.e2y[i]), e2z = _mm256_loadu_pd(&occluders.e2z[i]);
+
+                const __m256d hx = _mm256_sub_pd(_mm256_mul_pd(dy, e2z), _mm256_mul_pd(dz, e2y));
+                const __m256d hy = _mm256_sub_pd(_mm256_mul_pd(dz, e2x), _mm256_mul_pd(dx, e2z));
+                const __m256d hz = _mm256_sub_pd(_mm256_mul_pd(dx, e2y), _mm256_mul_pd(dy, e2x));
+                const __m256d a = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(e1x, hx), _mm256_mul_pd(e1y, hy)), _mm256_mul_pd(e1z, hz));
+                const __m256d f = _mm256_div_pd(one, a);
+
+                const __m256d sx = _mm256_sub_pd(ox, _mm256_loadu_pd(&occluders.v0x[i]));
+                const __m256d sy = _mm256_sub_pd(oy, _mm256_loadu_pd(&occluders.v0y[i]));
+                const __m256d sz = _mm256_sub_pd(oz, _mm256_loadu_pd(&occluders.v0z[i]));
+                const __m256d u = _mm256_mul_pd(f, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(sx, hx), _mm256_mul_pd(sy, hy)), _mm256_mul_pd(sz, hz)));
+
+                const __m256d qx = _mm256_sub_pd(_mm256_mul_pd(sy, e1z), _mm256_mul_pd(sz, e1y));
+                const __m256d qy = _mm256_sub_pd(_mm256_mul_pd(sz, e1x), _mm256_mul_pd(sx, e1z));
+                const __m256d qz = _mm256_sub_pd(_mm256_mul_pd(sx, e1y), _mm256_mul_pd(sy, e1x));
+                const __m256d v = _mm256_mul_pd(f, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, qx), _mm256_mul_pd(dy, qy)), _mm256_mul_pd(dz, qz)));
+                const __m256d t = _mm256_mul_pd(f, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(e2x, qx), _mm256_mul_pd(e2y, qy)), _mm256_mul_pd(e2z, qz)));
+
+                __m256d hit = _mm256_cmp_pd(_mm256_and_pd(a, abs_mask), eps, _CMP_NLT_UQ);
+                hit = _mm256_and_pd(hit, _mm256_cmp_pd(u, neg_eps, _CMP_NLT_UQ));
+                hit = _mm256_and_pd(hit, _mm256_cmp_pd(u, one_eps, _CMP_NGT_UQ));
+                hit = _mm256_and_pd(hit, _mm256_cmp_pd(v, neg_eps, _CMP_NLT_UQ));
+                hit = _mm256_and_pd(hit, _mm256_cmp_pd(_mm256_add_pd(u, v), one_eps, _CMP_NGT_UQ));
+                hit = _mm256_and_pd(hit, _mm256_cmp_pd(t, eps, _CMP_GT_OQ));
+
+                if (const unsigned lanes = static_cast<unsigned>(_mm256_movemask_pd(hit)) & valid) return i + __builtin_ctz(lanes);
+            }
+            return -1;
+        }
+
+        __attribute__((target("avx512f")))
+        int64_t first_hit_avx512(const OccluderBuffer& occluders, uint32_t first, uint32_t count,
+                                 const Point3D& origin, const Point3D& dir, int skip_id) {
+            const __m512d eps = _mm512_set1_pd(kEpsilon);
+            const __m512d neg_eps = _mm512_set1_pd(-kEpsilon);
+            const __m512d one_eps = _mm512_set1_pd(1.0 + kEpsilon);
+            const __m512d one = _mm512_set1_pd(1.0);
+            const __m512d dx = _mm512_set1_pd(dir.x), dy = _mm512_set1_pd(dir.y), dz = _mm512_set1_pd(dir.z);
+            const __m512d ox = _mm512_set1_pd(origin.x), oy = _mm512_set1_pd(origin.y), oz = _mm512_set1_pd(origin.z);
+
+            const uint32_t end = first + count;
+            for (uint32_t i = first; i < end; i += 8) {
+                const unsigned valid = lane_mask(occluders, i, end, 8, skip_id);
+                if (!valid) continue;
+
+                const __m512d e1x = _mm512_loadu_pd(&occluders.e1x[i]), e1y = _mm512_loadu_pd(&occluders.e1y[i]), e1z = _mm512_loadu_pd(&occluders.e1z[i]);
+                const __m512d e2x = _mm512_loadu_pd(&occluders.e2x[i]), e2y = _mm512_loadu_pd(&occluders.e2y[i]), e2z = _mm512_loadu_pd(&occluders.e2z[i]);
+
+                const __m512d hx = _mm512_sub_pd(_mm512_mul_pd(dy, e2z), _mm512_mul_pd(dz, e2y));
+                const __m512d hy = _mm512_sub_pd(_mm512_mul_pd(dz, e2x), _mm512_mul_pd(dx, e2z));
+                const __m512d hz = _mm512_sub_pd(_mm512_mul_pd(dx, e2y), _mm512_mul_pd(dy, e2x));
+                const __m512d a = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(e1x, hx), _mm512_mul_pd(e1y, hy)), _mm512_mul_pd(e1z, hz));
+                const __m512d f = _mm512_div_pd(one, a);
+
+                const __m512d sx = _mm512_sub_pd(ox, _mm512_loadu_pd(&occluders.v0x[i]));
+                const __m512d sy = _mm512_sub_pd(oy, _mm512_loadu_pd(&occluders.v0y[i]));
+                const __m512d sz = _mm512_sub_pd(oz, _mm512_loadu_pd(&occluders.v0z[i]));
+                const __m512d u = _mm512_mul_pd(f, _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(sx, hx), _mm512_mul_pd(sy, hy)), _mm512_mul_pd(sz, hz)));
+
+                const __m512d qx = _mm512_sub_pd(_mm512_mul_pd(sy, e1z), _mm512_mul_pd(sz, e1y));
+                const __m512d qy = _mm512_sub_pd(_mm512_mul_pd(sz, e1x), _mm512_mul_pd(sx, e1z));
+                const __m512d qz = _mm512_sub_pd(_mm512_mul_pd(sx, e1y), _mm512_mul_pd(sy, e1x));
+                const __m512d v = _mm512_mul_pd(f, _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(dx, qx), _mm512_mul_pd(dy, qy)), _mm512_mul_pd(dz, qz)));
+                const __m512d t = _mm512_mul_pd(f, _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(e2x, qx), _mm512_mul_pd(e2y, qy)), _mm512_mul_pd(e2z, qz)));
+
+                __mmask8 hit = _mm512_cmp_pd_mask(_mm512_abs_pd(a), eps, _CMP_NLT_UQ);
+                hit &= _mm512_cmp_pd_mask(u, neg_eps, _CMP_NLT_UQ);
+                hit &= _mm512_cmp_pd_mask(u, one_eps, _CMP_NGT_UQ);
+                hit &= _mm512_cmp_pd_mask(v, neg_eps, _CMP_NLT_UQ);
+                hit &= _mm512_cmp_pd_mask(_mm512_add_pd(u, v), one_eps, _CMP_NGT_UQ);
+                hit &= _mm512_cmp_pd_mask(t, eps, _CMP_GT_OQ);
+
+                if (const unsigned lanes = static_cast<unsigned>(hit) & valid) return i + __builtin_ctz(lanes);
+            }
+            return -1;
+        }
+
+        // 单精度版本：与上面逐行对应，只是改用_ps指令、向量宽度加倍
+
+        __attribute__((target("sse2")))
+        int64_t first_hit_sse2_f(const OccluderBufferF& occluders, uint32_t first, uint32_t count,
+                                 const Point3F& origin, const Point3F& dir, int skip_id) {
+            const __m128 eps = _mm_set1_ps(kEpsilonF);
+            const __m128 neg_eps = _mm_set1_ps(-kEpsilonF);
+            const __m128 one_eps = _mm_set1_ps(1.0f + kEpsilonF);
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+            const __m128 dx = _mm_set1_ps(dir.x), dy = _mm_set1_ps(dir.y), dz = _mm_set1_ps(dir.z);
+            const __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+
+            const uint32_t end = first + count;
+            for (uint32_t i = first; i < end; i += 4) {
+                const unsigned valid = lane_mask(occluders, i, end, 4, skip_id);
+                if (!valid) continue;
+
+                const __m128 e1x = _mm_loadu_ps(&occluders.e1x[i]), e1y = _mm_loadu_ps(&occluders.e1y[i]), e1z = _mm_loadu_ps(&occluders.e1z[i]);
+                const __m128 e2x = _mm_loadu_ps(&occluders.e2x[i]), e2y = _mm_loadu_ps(&occluders.e2y[i]), e2z = _mm_loadu_ps(&occluders.e2z[i]);
+
+                const __m128 hx = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+                const __m128 hy = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+                const __m128 hz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+                const __m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, hx), _mm_mul_ps(e1y, hy)), _mm_mul_ps(e1z, hz));
+                const __m128 f = _mm_div_ps(one, a);
+
+                const __m128 sx = _mm_sub_ps(ox, _mm_loadu_ps(&occluders.v0x[i]));
+                const __m128 sy = _mm_sub_ps(oy, _mm_loadu_ps(&occluders.v0y[i]));
+                const __m128 sz = _mm_sub_ps(oz, _mm_loadu_ps(&occluders.v0z[i]));
+                const __m128 u = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, hx), _mm_mul_ps(sy, hy)), _mm_mul_ps(sz, hz)));
+
+                const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+                const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+                const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+                const __m128 v = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)));
+                const __m128 t = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)));
+
+                __m128 hit = _mm_cmpnlt_ps(_mm_and_ps(a, abs_mask), eps);
+                hit = _mm_and_ps(hit, _mm_cmpnlt_ps(u, neg_eps));
+                hit = _mm_and_ps(hit, _mm_cmpngt_ps(u, one_eps));
+                hit = _mm_and_ps(hit, _mm_cmpnlt_ps(v, neg_eps));
+                hit = _mm_and_ps(hit, _mm_cmpngt_ps(_mm_add_ps(u, v), one_eps));
+                hit = _mm_and_ps(hit, _mm_cmpgt_ps(t, eps));
+
+                if (const unsigned lanes = static_cast<unsigned>(_mm_movemask_ps(hit)) & valid) return i + __builtin_ctz(lanes);
+            }
+            return -1;
+        }
+
+        __attribute__((target("avx2")))
+        int64_t first_hit_avx2_f(const OccluderBufferF& occluders, uint32_t first, uint32_t count,
+                                 const Point3F& origin, const Point3F& dir, int skip_id) {
+            const __m256 eps = _mm256_set1_ps(kEpsilonF);
+            const __m256 neg_eps = _mm256_set1_ps(-kEpsilonF);
+            const __m256 one_eps = _mm256_set1_ps(1.0f + kEpsilonF);
+            const __m256 one = _mm256_set1_ps(1.0f);
+            const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+            const __m256 dx = _mm256_set1_ps(dir.x), dy = _mm256_set1_ps(dir.y), dz = _mm256_set1_ps(dir.z);
+            const __m256 ox = _mm256_set1_ps(origin.x), oy = _mm256_set1_ps(origin.y), oz = _mm256_set1_ps(origin.z);
+
+            const uint32_t end = first + count;
+            for (uint32_t i = first; i < end; i += 8) {
+                const unsigned valid = lane_mask(occluders, i, end, 8, skip_id);
+                if (!valid) continue;
+
+                const __m256 e1x = _mm256_loadu_ps(&occluders.e1x[i]), e1y = _mm256_loadu_ps(&occluders.e1y[i]), e1z = _mm256_loadu_ps(&occluders.e1z[i]);
+                const __m256 e2x = _mm256_loadu_ps(&occluders.e2x[i]), e2y = _mm256_loadu_ps(&occluders.e2y[i]), e2z = _mm256_loadu_ps(&occluders.e2z[i]);
+
+                const __m256 hx = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+                const __m256 hy = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+                const __m256 hz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+                const __m256 a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, hx), _mm256_mul_ps(e1y, hy)), _mm256_mul_ps(e1z, hz));
+                const __m256 f = _mm256_div_ps(one, a);
+
+                const __m256 sx = _mm256_sub_ps(ox, _mm256_loadu_ps(&occluders.v0x[i]));
+                const __m256 sy = _mm256_sub_ps(oy, _mm256_loadu_ps(&occluders.v0y[i]));
+                const __m256 sz = _mm256_sub_ps(oz, _mm256_loadu_ps(&occluders.v0z[i]));
+                const __m256 u = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, hx), _mm256_mul_ps(sy, hy)), _mm256_mul_ps(sz, hz)));
+
+                const __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+                const __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+                const __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+                const __m256 v = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)));
+                const __m256 t = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)));
+
+                __m256 hit = _mm256_cmp_ps(_mm256_and_ps(a, abs_mask), eps, _CMP_NLT_UQ);
+                hit = _mm256_and_ps(hit, _mm256_cmp_ps(u, neg_eps, _CMP_NLT_UQ));
+                hit = _mm256_and_ps(hit, _mm256_cmp_ps(u, one_eps, _CMP_NGT_UQ));
+                hit = _mm256_and_ps(hit, _mm256_cmp_ps(v, neg_eps, _CMP_NLT_UQ));
+                hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_add_ps(u, v), one_eps, _CMP_NGT_UQ));
+                hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, eps, _CMP_GT_OQ));
+
+                if (const unsigned lanes = static_cast<unsigned>(_mm256_movemask_ps(hit)) & valid) return i + __builtin_ctz(lanes);
+            }
+            return -1;
+        }
+
+        __attribute__((target("avx512f")))
+        int64_t first_hit_avx512_f(const OccluderBufferF& occluders, uint32_t first, uint32_t count,
+                                   const Point3F& origin, const Point3F& dir, int skip_id) {
+            const __m512 eps = _mm512_set1_ps(kEpsilonF);
+            const __m512 neg_eps = _mm512_set1_ps(-kEpsilonF);
+            const __m512 one_eps = _mm512_set1_ps(1.0f + kEpsilonF);
+            const __m512 one = _mm512_set1_ps(1.0f);
+            const __m512 dx = _mm512_set1_ps(dir.x), dy = _mm512_set1_ps(dir.y), dz = _mm512_set1_ps(dir.z);
+            const __m512 ox = _mm512_set1_ps(origin.x), oy = _mm512_set1_ps(origin.y), oz = _mm512_set1_ps(origin.z);
+
+            const uint32_t end = first + count;
+            for (uint32_t i = first; i < end; i += 16) {
+                const unsigned valid = lane_mask(occluders, i, end, 16, skip_id);
+                if (!valid) continue;
+
+                const __m512 e1x = _mm512_loadu_ps(&occluders.e1x[i]), e1y = _mm512_loadu_ps(&occluders.e1y[i]), e1z = _mm512_loadu_ps(&occluders.e1z[i]);
+                const __m512 e2x = _mm512_loadu_ps(&occluders.e2x[i]), e2y = _mm512_loadu_ps(&occluders.e2y[i]), e2z = _mm512_loadu_ps(&occluders.e2z[i]);
+
+                const __m512 hx = _mm512_sub_ps(_mm512_mul_ps(dy, e2z), _mm512_mul_ps(dz, e2y));
+                const __m512 hy = _mm512_sub_ps(_mm512_mul_ps(dz, e2x), _mm512_mul_ps(dx, e2z));
+                const __m512 hz = _mm512_sub_ps(_mm512_mul_ps(dx, e2y), _mm512_mul_ps(dy, e2x));
+                const __m512 a = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(e1x, hx), _mm512_mul_ps(e1y, hy)), _mm512_mul_ps(e1z, hz));
+                const __m512 f = _mm512_div_ps(one, a);
+
+                const __m512 sx = _mm512_sub_ps(ox, _mm512_loadu_ps(&occluders.v0x[i]));
+                const __m512 sy = _mm512_sub_ps(oy, _mm512_loadu_ps(&occluders.v0y[i]));
+                const __m512 sz = _mm512_sub_ps(oz, _mm512_loadu_ps(&occluders.v0z[i]));
+                const __m512 u = _mm512_mul_ps(f, _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(sx, hx), _mm512_mul_ps(sy, hy)), _mm512_mul_ps(sz, hz)));
+
+                const __m512 qx = _mm512_sub_ps(_mm512_mul_ps(sy, e1z), _mm512_mul_ps(sz, e1y));
+                const __m512 qy = _mm512_sub_ps(_mm512_mul_ps(sz, e1x), _mm512_mul_ps(sx, e1z));
+                const __m512 qz = _mm512_sub_ps(_mm512_mul_ps(sx, e1y), _mm512_mul_ps(sy, e1x));
+                const __m512 v = _mm512_mul_ps(f, _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, qx), _mm512_mul_ps(dy, qy)), _mm512_mul_ps(dz, qz)));
+                const __m512 t = _mm512_mul_ps(f, _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(e2x, qx), _mm512_mul_ps(e2y, qy)), _mm512_mul_ps(e2z, qz)));
+
+                __mmask16 hit = _mm512_cmp_ps_mask(_mm512_abs_ps(a), eps, _CMP_NLT_UQ);
+                hit &= _mm512_cmp_ps_mask(u, neg_eps, _CMP_NLT_UQ);
+                hit &= _mm512_cmp_ps_mask(u, one_eps, _CMP_NGT_UQ);
+                hit &= _mm512_cmp_ps_mask(v, neg_eps, _CMP_NLT_UQ);
+                hit &= _mm512_cmp_ps_mask(_mm512_add_ps(u, v), one_eps, _CMP_NGT_UQ);
+                hit &= _mm512_cmp_ps_mask(t, eps, _CMP_GT_OQ);
+
+                if (const unsigned lanes = static_cast<unsigned>(hit) & valid) return i + __builtin_ctz(lanes);
+            }
+            return -1;
+        }
+#endif
+
+        FirstHitFn kernel_for(Isa isa) {
+#ifdef GEOM_SIMD_X86
+            switch (isa) {
+                case Isa::AVX512: return first_hit_avx512;
+                case Isa::AVX2:   return first_hit_avx2;
+                case Isa::SSE2:   return first_hit_sse2;
+                default: break;
+            }
+#endif
+            return first_hit_scalar;
+        }
+
+        FirstHitFnF kernel_for_f(Isa isa) {
+#ifdef GEOM_SIMD_X86
+            switch (isa) {
+                case Isa::AVX512: return first_hit_avx512_f;
+                case Isa::AVX2:   return first_hit_avx2_f;
+                case Isa::SSE2:   return first_hit_sse2_f;
+                default: break;
+            }
+#endif
+            return first_hit_scalar;
+        }
+
+        // 标量实现（双精度与单精度共用）
+        template <typename T>
+        int64_t first_hit_scalar_impl(const BasicOccluderBuffer<T>& occluders, uint32_t first, uint32_t count,
+                                      const Vec3<T>& origin, const Vec3<T>& dir, int skip_id) {
+            constexpr T eps = static_cast<T>(kEpsilon);
+            for (uint32_t i = first; i < first + count; ++i) {
+                if (occluders.ids[i] == skip_id) continue;
+
+                const Vec3<T> edge1(occluders.e1x[i], occluders.e1y[i], occluders.e1z[i]);
+                const Vec3<T> edge2(occluders.e2x[i], occluders.e2y[i], occluders.e2z[i]);
+                const Vec3<T> h = dir.cross(edge2);
+                const T a = edge1.dot(h);
+                if (std::fabs(a) < eps) continue;
+
+                const T f = T(1) / a;
+                const Vec3<T> s = origin - Vec3<T>(occluders.v0x[i], occluders.v0y[i], occluders.v0z[i]);
+                const T u = f * s.dot(h);
+                if (u < -eps || u > T(1) + eps) continue;
+
+                const Vec3<T> q = s.cross(edge1);
+                const T v = f * dir.dot(q);
+                if (v < -eps || u + v > T(1) + eps) continue;
+
+                if (f * edge2.dot(q) > eps) return i;
+            }
+            return -1;
+        }
+
+        std::atomic<int> g_isa{-1};
+        std::atomic<FirstHitFn> g_kernel{nullptr};
+        std::atomic<FirstHitFnF> g_kernel_f{nullptr};
+    }
+
+    Isa detect_isa() {
+#ifdef GEOM_SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return Isa::AVX512;
+        if (__builtin_cpu_supports("avx2")) return Isa::AVX2;
+        if (__builtin_cpu_supports("sse2")) return Isa::SSE2;
+#endif
+        return Isa::Scalar;
+    }
+
+    Isa active_isa() {
+        int isa = g_isa.load(std::memory_order_acquire);
+        if (isa < 0) {
+            set_isa(detect_isa());
+            isa = g_isa.load(std::memory_order_acquire);
+        }
+        return static_cast<Isa>(isa);
+    }
+
+    void set_isa(Isa isa) {
+        // 不能超过CPU实际支持的指令集
+        const Isa best = detect_isa();
+        if (static_cast<int>(isa) > static_cast<int>(best)) isa = best;
+        g_kernel.store(kernel_for(isa), std::memory_order_release);
+        g_kernel_f.store(kernel_for_f(isa), std::memory_order_release);
+        g_isa.store(static_cast<int>(isa), std::memory_order_release);
+    }
+
+    const char* isa_name(Isa isa) {
+        switch (isa) {
+            case Isa::AVX512: return "AVX-512";
+            case Isa::AVX2:   return "AVX2";
+            case Isa::SSE2:   return "SSE2";
+            default:          return "Scalar";
+        }
+    }
+
+    int64_t first_hit(const OccluderBuffer& occluders, uint32_t first, uint32_t count,
+                      const Point3D& origin, const Point3D& dir, int skip_id) {
+        FirstHitFn kernel = g_kernel.load(std::memory_order_acquire);
+        if (!kernel) {
+            active_isa();
+            kernel = g_kernel.load(std::memory_order_acquire);
+        }
+        return kernel(occluders, first, count, origin, dir, skip_id);
+    }
+
+    bool any_hit(const OccluderBuffer& occluders, uint32_t first, uint32_t count,
+                 const Point3D& origin, const Point3D& dir, int skip_id) {
+        return first_hit(occluders, first, count, origin, dir, skip_id) >= 0;
+    }
+
+    int64_t first_hit_scalar(const OccluderBuffer& occluders, uint32_t first, uint32_t count,
+                             const Point3D& origin, const Point3D& dir, int skip_id) {
+        return first_hit_scalar_impl(occluders, first, count, origin, dir, skip_id);
+    }
+
+    bool any_hit_scalar(const OccluderBuffer& occluders, uint32_t first, uint32_t count,
+                        const Point3D& origin, const Point3D& dir, int skip_id) {
+        return first_hit_scalar(occluders, first, count, origin, dir, skip_id) >= 0;
+    }
+
+    int64_t first_hit(const OccluderBufferF& occluders, uint32_t first, uint32_t count,
+                      const Point3F& origin, const Point3F& dir, int skip_id) {
+        FirstHitFnF kernel = g_kernel_f.load(std::memory_order_acquire);
+        if (!kernel) {
+            active_isa();
+            kernel = g_kernel_f.load(std::memory_order_acquire);
+        }
+        return kernel(occluders, first, count, origin, dir, skip_id);
+    }
+
+    int64_t first_hit_scalar(const OccluderBufferF& occluders, uint32_t first, uint32_t count,
+                             const Point3F& origin, const Point3F& dir, int skip_id) {
+        return first_hit_scalar_impl(occluders, first, count, origin, dir, skip_id);
+    }
+}
@@ -0,0 +1,58 @@
+//
+// Created by zhou on 25-7-12.
+//
+
+#ifndef SIMDKERNEL_H
+#define SIMDKERNEL_H
+
+#include <cstdint>
+
+#include "OccluderBuffer.h"
+#include "Point3D.h"
+
+namespace geom {
+
+namespace simd {
+
+    // 可用的指令集
+    enum class Isa { Scalar, SSE2, AVX2, AVX512 };
+
+    // 检测当前CPU支持的最佳指令集
+    Isa detect_isa();
+
+    // 当前使用的指令集（首次调用时自动检测）
+    Isa active_isa();
+
+    // 强制使用指定指令集（用于校验和性能对比），不支持时回退到检测结果
+    void set_isa(Isa isa);
+
+    const char* isa_name(Isa isa);
+
+    // 射线与[first, first+count)范围内的遮挡三角形求交，跳过id==skip_id的三角形
+    // 判定条件与ray_triangle_intersection完全一致（epsilon=1e-8）
+    bool any_hit(const OccluderBuffer& occluders, uint32_t first, uint32_t count,
+                 const Point3D& origin, const Point3D& dir, int skip_id);
+
+    // 同any_hit，返回第一个命中三角形的下标（按下标顺序），无命中返回-1
+    int64_t first_hit(const OccluderBuffer& occluders, uint32_t first, uint32_t count,
+                      const Point3D& origin, const Point3D& dir, int skip_id);
+
+    // 标量实现（作为参考和回退）
+    bool any_hit_scalar(const OccluderBuffer& occluders, uint32_t first, uint32_t count,
+                        const Point3D& origin, const Point3D& dir, int skip_id);
+
+    int64_t first_hit_scalar(const OccluderBuffer& occluders, uint32_t first, uint32_t count,
+                             const Point3D& origin, const Point3D& dir, int skip_id);
+
+    // 单精度版本：origin为缓冲区局部坐标（见OccluderBufferF::local_point），
+    // 判定条件与双精度相同，向量宽度加倍
+    int64_t first_hit(const OccluderBufferF& occluders, uint32_t first, uint32_t count,
+                      const Point3F& origin, const Point3F& dir, int skip_id);
+
+    int64_t first_hit_scalar(const OccluderBufferF& occluders, uint32_t first, uint32_t count,
+                             const Point3F& origin, const Point3F& dir, int skip_id);
+}
+
+}
+
+#endif //SIMDKERNEL_H
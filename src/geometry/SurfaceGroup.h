@@ -4,44 +4,210 @@
 
 #ifndef SURFACEGROUP_H
 #define SURFACEGROUP_H
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <sstream>
 #include <string>
 #include <vector>
 
 #include "TriangleMesh.h"
 #include "Triangle.h"
 #include "ShadowAnalyzer.h"
+#include "ShadowCache.h"
+#include "SharedGeometry.h"
 
 namespace geom {
+    // 遮挡计算方式
+    enum class ShadingMode {
+        Grid,     // 预先计算整个天空半球的角度网格
+        SunPath,  // 只计算模拟期间太阳经过的网格单元（按需计算并记忆）
+        Adaptive, // 在粗网格之上按角点差异自适应细分（阴影边缘处加密）
+    };
+
+    // 表面采样方式
+    enum class SampleMode {
+        Mesh,         // 细分并保存网格，以各细分面中心为采样点
+        Stream,       // 遮挡计算时由父三角形现场生成同样的采样点，不保存细分网格（结果相同，内存只与父三角形数有关）
+        Progressive,  // 在Stream基础上逐个父三角形渐进加密，受照比例误差达标即停止（阴影边缘处加密）
+    };
+
+    // 射线求交精度
+    enum class PrecisionMode {
+        Double,    // 双精度（默认）
+        Float,     // 单精度：遮挡物内存减半、向量宽度加倍，结果与双精度有微小差异
+        Validate,  // 以双精度结果为准，另用单精度计算一遍并报告两者的最大差异（仅批量计算时）
+    };
+
+    struct ShadingOptions {
+        ShadingMode mode = ShadingMode::Grid;
+        // SunPath模式的网格分辨率（度）
+        double sky_altitude_step = 2.0;
+        double sky_azimuth_step = 2.0;
+        // 遮挡判定引擎及光栅化深度图分辨率
+        OcclusionMethod occlusion_method = OcclusionMethod::RayCast;
+        int raster_resolution = 1024;
+        // Adaptive模式的细分容差与最大深度（15°×30°的粗网格细分3层后为1.875°×3.75°）
+        double adaptive_tolerance = 0.02;
+        int adaptive_max_depth = 3;
+        // 表面采样方式；Progressive模式下逐层加密的停止判据容差（启发式，非误差界）与起始层数
+        SampleMode sample_mode = SampleMode::Mesh;
+        double progressive_tolerance = 0.05;
+        int progressive_start_level = 2;
+        // 射线求交精度（光栅化引擎不区分）
+        PrecisionMode precision = PrecisionMode::Double;
+    };
+
     class SurfaceGroup {
     private:
+        // 网格细分参数
+        static constexpr double kMaxArea = 0.1;
+        static constexpr int kMaxLevel = 5;
+        // 批量计算的角度网格：起始、结束、步长
+        static constexpr double kAltitudeGrid[3] = {0.0, 90.0, 15.0};
+        static constexpr double kAzimuthGrid[3] = {0.0, 360.0, 30.0};
+
         std::string group_name;
-        StlModel model;  //stl模型
-        std::map<std::string, std::vector<TriangleMesh>> meshMap; //划分网格
+        std::shared_ptr<const SharedGeometry> geometry;  //stl模型（可与其他分组共享）
+        const StlModel& model;
+        std::map<std::string, SolidMesh> meshMap; //划分网格
+        std::map<std::string, SampleSolid> sampleMap; //流式采样源（Stream/Progressive时代替meshMap参与遮挡计算）
         std::vector<std::string> surf_names; //需要分析的表面名
         std::map<std::string, double> areas; //面积
         std::map<std::string, Point3D> normals; //平均法向量
+        bool meshes_built = false;
+
+        ShadingOptions options;
+        std::string cache_file;  // 遮挡表缓存文件
+        uint64_t cache_key = 0;
 
         ShadowAnalyzer analyzer;
+        double precision_error = 0.0;  // Validate模式下单精度与双精度结果的最大差异
     public:
-        SurfaceGroup(const std::string &name, const std::string &path, const std::vector<std::string>& surf_names)
-            :group_name(name), surf_names(surf_names) {
+        // 遮挡表缓存的键：由几何内容、分析表面与影响计算结果的参数决定（只影响计算方式、不影响结果的参数不计入）
+        static ShadowCacheKey cacheKey(uint64_t stl_hash, const std::vector<std::string>& surf_names,
+                                       const ShadingOptions& options) {
+            ShadowCacheKey key;
+            key.stl_hash = stl_hash;
+            key.surface_names = surf_names;
+            key.max_area = kMaxArea;
+            key.max_level = kMaxLevel;
+            std::copy(std::begin(kAltitudeGrid), std::end(kAltitudeGrid), key.altitude);
+            std::copy(std::begin(kAzimuthGrid), std::end(kAzimuthGrid), key.azimuth);
+            if (options.mode == ShadingMode::SunPath) {
+                key.altitude[2] = options.sky_altitude_step;
+                key.azimuth[2] = options.sky_azimuth_step;
+            }
+            key.occlusion_method = static_cast<int>(options.occlusion_method);
+            if (options.occlusion_method == OcclusionMethod::Raster) {
+                key.raster_resolution = options.raster_resolution;
+            }
+            if (options.sample_mode == SampleMode::Progressive) {
+                key.progressive_tolerance = options.progressive_tolerance;
+                key.progressive_start_level = options.progressive_start_level;
+            }
+            if (options.precision == PrecisionMode::Float && options.occlusion_method == OcclusionMethod::RayCast) {
+                key.geometry_precision = 1;
+            }
+            if (options.mode == ShadingMode::Adaptive) {
+                key.adaptive_tolerance = options.adaptive_tolerance;
+                key.adaptive_depth = options.adaptive_max_depth;
+            }
+            return key;
+        }
 
-            // 1. 解析STL模型（作为遮挡物）
-            std::cout << "正在解析STL文件: "<<path<<std::endl;
-            model = parseStlFile(path);
-            std::cout << "解析完成，模型包含 " << model.size() << " 个三角面\n";
+        SurfaceGroup(const std::string &name, const std::string &path, const std::vector<std::string>& surf_names,
+                     std::shared_ptr<util::ThreadPool> pool = nullptr, const ShadingOptions& options = {})
+            :SurfaceGroup(name, load_geometry(path), surf_names, std::move(pool), options) {}
 
-            // 2. 细分模型（需要分析的网格）
-            std::cout << "正在细分模型...\n";
-            meshMap = subdivideModel(model, surf_names, 0.1, 5);
+        // 使用已解析的几何（如由GeometryRegistry共享），遮挡场景也取自该几何
+        SurfaceGroup(const std::string &name, std::shared_ptr<const SharedGeometry> shared_geometry,
+                     const std::vector<std::string>& surf_names, std::shared_ptr<util::ThreadPool> pool = nullptr,
+                     const ShadingOptions& options = {})
+            :group_name(name), geometry(std::move(shared_geometry)), model(geometry->model()),
+             surf_names(surf_names), options(options) {
+
+            // 遮挡计算与网格细分使用调用方的线程池（为空时串行）
+            analyzer.setThreadPool(std::move(pool));
+            const bool use_float = options.precision == PrecisionMode::Float;
+            analyzer.setOcclusionMethod(options.occlusion_method, options.raster_resolution,
+                                        use_float ? GeometryPrecision::Float : GeometryPrecision::Double);
+            if (options.sample_mode == SampleMode::Progressive) {
+                analyzer.setProgressiveSampling({options.progressive_tolerance, options.progressive_start_level});
+            }
+
+            // 1. 几何与计算参数未变时直接加载缓存的遮挡表
+            const ShadowCacheKey key_params = cacheKey(geometry->contentHash(), surf_names, options);
+            const double* altitude_grid = key_params.altitude;
+            const double* azimuth_grid = key_params.azimuth;
+            AdaptiveRefinement refinement;
+            if (options.mode == ShadingMode::Adaptive) {
+                refinement.tolerance = options.adaptive_tolerance;
+                refinement.max_depth = options.adaptive_max_depth;
+            }
+            cache_key = key_params.digest();
+            cache_file = group_name + "_shd.bin";
+
+            ShadowTable cached;
+            ShadowQuadTree cached_tree;
+            // Validate模式总是重新计算（校验只在计算时进行）
+            const bool cache_hit = options.precision != PrecisionMode::Validate &&
+                                   read_shadow_cache(cache_file, cache_key, cached, &cached_tree);
+            // 遮挡物：同一几何的各分组共用一个遮挡场景（在需要计算时才构建）
+            const bool ray_cast = options.occlusion_method == OcclusionMethod::RayCast;
+            auto share_occluders = [&] {
+                analyzer.setOccluderScene(geometry->occluderScene(ray_cast, ray_cast && use_float));
+            };
+            if (options.mode == ShadingMode::SunPath) {
+                // 2. 按需计算：只建立网格，节点在precomputeSunPath或首次查询时计算
+                share_occluders();
+                const AngleGrid altitude = AngleGrid::from_range(altitude_grid[0], altitude_grid[1], altitude_grid[2]);
+                const AngleGrid azimuth = AngleGrid::from_range(azimuth_grid[0], azimuth_grid[1], azimuth_grid[2]);
+                if (options.sample_mode != SampleMode::Mesh) {
+                    buildSamples();
+                    analyzer.prepareOnDemand(model, sampleMap, altitude, azimuth, cache_hit ? &cached : nullptr);
+                } else {
+                    buildMeshes();
+                    analyzer.prepareOnDemand(model, meshMap, altitude, azimuth, cache_hit ? &cached : nullptr);
+                }
+                if (cache_hit) {
+                    std::cout << "已从缓存加载 " << cached.knownCount() << " 个遮挡表节点: " << cache_file << std::endl;
+                }
+                if (!cache_hit || !cached.hasViewFactors()) {
+                    saveCache();  // 视角系数在prepareOnDemand中计算
+                }
+            } else if (cache_hit && cached.complete() && cached.hasViewFactors() &&
+                       (!refinement.enabled() || !cached_tree.empty())) {
+                std::cout << "已从缓存加载遮挡表: " << cache_file << std::endl;
+                analyzer.setShadowTable(std::move(cached));
+                if (refinement.enabled()) {
+                    analyzer.setQuadTree(std::move(cached_tree));
+                }
+            } else {
+                // 2. 细分模型（需要分析的网格）并批量计算
+                share_occluders();
+                auto calculate = [&](const auto& receivers) {
+                    analyzer.batchCalculate(
+                        model,
+                        receivers,
+                        kAltitudeGrid[0], kAltitudeGrid[1], kAltitudeGrid[2],    // 高度角：起始、结束、步长
+                        kAzimuthGrid[0], kAzimuthGrid[1], kAzimuthGrid[2],       // 方位角：起始、结束、步长
+                        group_name+"_shd.csv",  // 输出文件名
+                        refinement              // 自适应细分（Grid模式不细分）
+                    );
+                };
+                if (options.sample_mode != SampleMode::Mesh) {
+                    buildSamples();
+                    calculate(sampleMap);
+                    if (options.precision == PrecisionMode::Validate) validatePrecision(sampleMap);
+                } else {
+                    buildMeshes();
+                    calculate(meshMap);
+                    if (options.precision == PrecisionMode::Validate) validatePrecision(meshMap);
+                }
 
-            analyzer.batchCalculate(
-                model,
-                meshMap,
-                0.0, 90.0, 15.0,    // 高度角：起始、结束、步长
-                0.0, 360.0, 30.0,   // 方位角：起始、结束、步长
-                group_name+"_shd.csv"  // 输出文件名
-            );
+                saveCache();
+            }
 
             //面积统计
             std::cout << "表面面积统计...\n";
@@ -69,11 +235,59 @@ namespace geom {
         double get_shadow_value(double altitude, double azimuth, const std::string& surface) {
             return analyzer.get_shadow_value(altitude, azimuth, surface);
         }
+        // 按表面ID查询（ID由getSurfaceId在初始化时解析）
+        double get_shadow_value(double altitude, double azimuth, int surface_id) {
+            return analyzer.get_shadow_value(altitude, azimuth, surface_id);
+        }
+        // 表面名→整数ID，找不到返回-1
+        int getSurfaceId(const std::string& surface) const {
+            return analyzer.surfaceId(surface);
+        }
+
+        // 天空视角系数：表面看到的未遮挡天空（余弦加权），无遮挡水平面为1，无遮挡竖直面为0.5
+        double getSkyViewFactor(int surface_id) const {
+            return analyzer.shadowTable().skyViewFactor(surface_id);
+        }
+        // 地面视角系数：表面看到的未遮挡地面（余弦加权），无遮挡竖直面为0.5
+        double getGroundViewFactor(int surface_id) const {
+            return analyzer.shadowTable().groundViewFactor(surface_id);
+        }
+
+        // 遮挡表（SunPath模式下只含已计算的节点）
+        const ShadowTable& getShadowTable() const {
+            return analyzer.shadowTable();
+        }
+
+        // Adaptive模式的细分四叉树（其他模式为空）
+        const ShadowQuadTree& getQuadTree() const {
+            return analyzer.quadTree();
+        }
+
+        // Validate模式：单精度与双精度遮挡率在批量计算网格上的最大差异（未校验时为0）
+        double getPrecisionError() const {
+            return precision_error;
+        }
+
+        // SunPath模式：批量计算模拟期间太阳位置(高度角, 方位角)所经过的网格单元
+        void precomputeSunPath(const std::vector<std::pair<double, double>>& sun_positions) {
+            if (!analyzer.onDemand()) return;
+            const size_t computed = analyzer.precompute(sun_positions);
+            const auto& table = analyzer.shadowTable();
+            std::cout << "太阳轨迹: " << sun_positions.size() << " 个时刻, 新计算 " << computed << " 个网格节点, 共 "
+                      << table.knownCount() << "/" << table.knownMask().size() << " 个节点已计算" << std::endl;
+            if (computed > 0) {
+                analyzer.printOcclusionStats();
+                analyzer.printSamplingStats();
+                saveCache();
+            }
+        }
         double get_area(const std::string& surface) {
             return areas[surface];
         }
 
-        std::vector<TriangleMesh> getSurface(const std::string& surf_name) {
+        // 表面的细分网格（引用分组内的存储，不复制）
+        const SolidMesh& getSurface(const std::string& surf_name) {
+            buildMeshes();
             return meshMap[surf_name];
         }
 
@@ -81,6 +295,70 @@ namespace geom {
             return normals[surf_name];
         }
 
+    private:
+        void saveCache() const {
+            try {
+                write_shadow_cache(cache_file, cache_key, analyzer.shadowTable(),
+                                   analyzer.adaptive() ? &analyzer.quadTree() : nullptr);
+            } catch (const std::exception& e) {
+                std::cerr << "警告：" << e.what() << std::endl;
+            }
+        }
+
+        // 细分网格（从缓存加载时推迟到首次需要时）
+        void buildMeshes() {
+            if (meshes_built) return;
+            std::cout << "正在细分模型...\n";
+            meshMap = subdivideModel(model, surf_names, kMaxArea, kMaxLevel, analyzer.threadPool());
+            meshes_built = true;
+        }
+
+        // 流式采样源（只记录父三角形及细分层数）
+        void buildSamples() {
+            sampleMap = planSamples(model, surf_names, kMaxArea, kMaxLevel);
+        }
+
+        // 用单精度引擎在同一角度网格上重新计算，逐表面比较与双精度结果的最大差异
+        template <typename Solid>
+        void validatePrecision(const std::map<std::string, Solid>& receivers) {
+            if (options.occlusion_method != OcclusionMethod::RayCast) {
+                std::cout << "光栅化引擎不区分求交精度，跳过精度校验" << std::endl;
+                return;
+            }
+            std::cout << "精度校验: 使用单精度重新计算...\n";
+            ShadowAnalyzer single;
+            single.setThreadPool(analyzer.sharedThreadPool());
+            single.setOcclusionMethod(OcclusionMethod::RayCast, options.raster_resolution, GeometryPrecision::Float);
+            single.setProgressiveSampling(analyzer.progressiveSampling());
+            single.setOccluderScene(geometry->occluderScene(true, true));
+            single.batchCalculate(model, receivers,
+                                  kAltitudeGrid[0], kAltitudeGrid[1], kAltitudeGrid[2],
+                                  kAzimuthGrid[0], kAzimuthGrid[1], kAzimuthGrid[2],
+                                  group_name + "_shd_f32.csv");
+
+            // 自适应细分只追加节点，均匀网格部分两者一一对应
+            const ShadowTable& reference = analyzer.shadowTable();
+            const ShadowTable& table = single.shadowTable();
+            const auto& names = reference.surfaceNames();
+            const int alt_count = reference.altitudeGrid().count;
+            const int azi_count = reference.azimuthGrid().count;
+            precision_error = 0.0;
+            std::ostringstream text;
+            text << "精度校验（单精度 - 双精度，" << alt_count * azi_count << " 个角度）:\n";
+            for (int id = 0; id < static_cast<int>(names.size()); ++id) {
+                double max_diff = 0.0;
+                for (int a = 0; a < alt_count; ++a) {
+                    for (int z = 0; z < azi_count; ++z) {
+                        max_diff = std::max(max_diff, std::fabs(table.at(id, a, z) - reference.at(id, a, z)));
+                    }
+                }
+                precision_error = std::max(precision_error, max_diff);
+                text << "  " << names[id] << ": 最大差异 " << max_diff << "\n";
+            }
+            text << "  全部表面最大差异 " << precision_error << "\n";
+            std::cout << text.str() << std::flush;
+        }
+
 
 
     };
@@ -5,136 +5,265 @@
 #ifndef TRIANGLE_H
 #define TRIANGLE_H
 
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <map>
-#include <regex>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include <MappedFile.h>
+
 #include "Point3D.h"
 
 namespace geom {
-    struct Triangle {
-        Point3D normal;
-        Point3D vertices[3];
+    template <typename T>
+    struct BasicTriangle {
+        Vec3<T> normal;
+        Vec3<T> vertices[3];
         int id=-1;
     };
 
+    using Triangle = BasicTriangle<double>;
     using SolidData = std::vector<Triangle>;
     using StlModel = std::map<std::string, SolidData>;
 
-
-inline StlModel parseStlFile(const std::string& filePath) {
-    std::ifstream file(filePath);
-    if (!file.is_open()) {
-        throw std::runtime_error("无法打开文件: " + filePath);
+    // 射线-三角形相交检测（Möller-Trumbore算法）
+    template <typename T>
+    inline bool ray_triangle_intersection(
+        const Vec3<T>& ray_origin,
+        const Vec3<T>& ray_dir,  // 单位向量
+        const BasicTriangle<T>& triangle,
+        T& t,                    // 射线起点到交点的距离
+        const T epsilon = T(1e-8)  // 精度阈值
+    ) {
+        const Vec3<T>& v0 = triangle.vertices[0];
+        const Vec3<T>& v1 = triangle.vertices[1];
+        const Vec3<T>& v2 = triangle.vertices[2];
+
+        const Vec3<T> edge1 = v1 - v0;
+        const Vec3<T> edge2 = v2 - v0;
+        const Vec3<T> h = ray_dir.cross(edge2);
+        const T a = edge1.dot(h);
+
+        // 射线与三角形平行或共面
+        if (std::fabs(a) < epsilon) return false;
+
+        const T f = T(1) / a;
+        const Vec3<T> s = ray_origin - v0;
+        const T u = f * s.dot(h);
+
+        // u不在[0,1]范围内，无交点
+        if (u < -epsilon || u > T(1) + epsilon) return false;
+
+        const Vec3<T> q = s.cross(edge1);
+        const T v = f * ray_dir.dot(q);
+
+        // v不在[0,1]或u+v>1，无交点
+        if (v < -epsilon || u + v > T(1) + epsilon) return false;
+
+        // 计算交点距离
+        t = f * edge2.dot(q);
+        return t > epsilon;  // 交点在射线前方
     }
 
-    StlModel model;
-    std::string currentSolidName;
-    Triangle currentTriangle;  // 移到循环外，确保一个facet内复用
-    int vertexCount = 0;
-    bool inSolid = false;
-    bool inFacet = false;
-    bool inLoop = false;  // 新增：标记是否在outer loop内
-    int triangleId = 0;   // 三角形ID（按顺序递增）
-
-    std::string line;
-
-    // 正则表达式模式（新增outer loop和endloop）
-    std::regex solidPattern(R"(^\s*solid\s+(\w+)\s*$)");
-    std::regex endsolidPattern(R"(^\s*endsolid\s*(\w+)?\s*$)");
-    std::regex facetPattern(R"(^\s*facet\s+normal\s+([+-]?\d+(?:\.\d+)?)\s+([+-]?\d+(?:\.\d+)?)\s+([+-]?\d+(?:\.\d+)?)\s*$)");
-    std::regex loopPattern(R"(^\s*outer\s+loop\s*$)");          // 新增：匹配outer loop
-    std::regex endloopPattern(R"(^\s*endloop\s*$)");            // 新增：匹配endloop
-    std::regex vertexPattern(R"(^\s*vertex\s+([+-]?\d+(?:\.\d+)?)\s+([+-]?\d+(?:\.\d+)?)\s+([+-]?\d+(?:\.\d+)?)\s*$)");
-    std::regex endfacetPattern(R"(^\s*endfacet\s*$)");          // 新增：匹配endfacet
-
-    while (std::getline(file, line)) {
-        // 去除行首行尾空白
-        line.erase(0, line.find_first_not_of(" \t\n\r\f\v"));
-        line.erase(line.find_last_not_of(" \t\n\r\f\v") + 1);
-        if (line.empty()) continue;
-
-        std::smatch match;
-
-        // 1. 匹配solid开始
-        if (std::regex_match(line, match, solidPattern)) {
-            currentSolidName = match[1].str();
-            inSolid = true;
-            continue;
+
+    // STL文本解析用的游标（按空白分词，记录行号用于报错）
+    class StlTokenizer {
+    public:
+        StlTokenizer(const char* begin, const char* end) : p_(begin), end_(end) {}
+
+        [[nodiscard]] bool done() {
+            skip_space();
+            return p_ >= end_;
         }
 
-        // 2. 匹配solid结束
-        if (std::regex_match(line, match, endsolidPattern)) {
-            inSolid = false;
-            inFacet = false;
-            inLoop = false;
-            continue;
+        [[nodiscard]] size_t line() const { return line_; }
+
+        // 读取下一个由空白分隔的单词
+        std::string_view word() {
+            skip_space();
+            const char* start = p_;
+            while (p_ < end_ && !is_space(*p_)) ++p_;
+            return {start, static_cast<size_t>(p_ - start)};
         }
 
-        if (!inSolid) continue;  // 不在solid内则跳过
-
-        // 3. 匹配facet开始（此时初始化三角形）
-        if (std::regex_match(line, match, facetPattern)) {
-            currentTriangle = Triangle();  // 仅在facet开始时创建新三角形
-            currentTriangle.normal.x = std::stod(match[1].str());
-            currentTriangle.normal.y = std::stod(match[2].str());
-            currentTriangle.normal.z = std::stod(match[3].str());
-            inFacet = true;
-            inLoop = false;
-            vertexCount = 0;  // 重置顶点计数
-            continue;
+        // 读取当前行剩余部分的第一个单词（可能为空），并跳到下一行
+        std::string_view rest_of_line_word() {
+            while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\r' || *p_ == '\f' || *p_ == '\v')) ++p_;
+            const char* start = p_;
+            while (p_ < end_ && !is_space(*p_)) ++p_;
+            const std::string_view w(start, static_cast<size_t>(p_ - start));
+            skip_line();
+            return w;
         }
 
-        // 4. 匹配outer loop（仅在facet内有效）
-        if (inFacet && std::regex_match(line, loopPattern)) {
-            inLoop = true;  // 进入loop后才开始解析顶点
-            continue;
+        void skip_line() {
+            while (p_ < end_ && *p_ != '\n') ++p_;
         }
 
-        // 5. 匹配endloop（结束顶点解析）
-        if (inFacet && std::regex_match(line, endloopPattern)) {
-            inLoop = false;
-            continue;
+        // 读取一个浮点数（支持科学计数法和前导+号）
+        double number() {
+            const std::string_view w = word();
+            const char* first = w.data();
+            const char* last = w.data() + w.size();
+            if (first < last && *first == '+') ++first;
+            double value = 0.0;
+            const auto [ptr, ec] = std::from_chars(first, last, value);
+            if (ec != std::errc() || ptr != last) {
+                throw std::runtime_error("STL第" + std::to_string(line_) + "行数值格式错误: " + std::string(w));
+            }
+            return value;
         }
 
-        // 6. 匹配endfacet（结束当前facet）
-        if (inFacet && std::regex_match(line, endfacetPattern)) {
-            inFacet = false;
-            continue;
+    private:
+        const char* p_;
+        const char* end_;
+        size_t line_ = 1;
+
+        static bool is_space(char c) {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
         }
 
-        // 7. 解析顶点（仅在loop内有效）
-        if (inLoop && std::regex_match(line, match, vertexPattern)) {
-            if (vertexCount < 3) {
-                // 正确存储顶点数据（currentTriangle在整个facet内复用）
-                currentTriangle.vertices[vertexCount].x = std::stod(match[1].str());
-                currentTriangle.vertices[vertexCount].y = std::stod(match[2].str());
-                currentTriangle.vertices[vertexCount].z = std::stod(match[3].str());
-                vertexCount++;
-
-                // 收集到3个顶点后，添加到模型
-                if (vertexCount == 3) {
-                    currentTriangle.id = triangleId++;  // 按顺序分配ID
-                    model[currentSolidName].push_back(currentTriangle);
-                    // 调试输出（可选）
-                    // std::cout << "解析三角面 " << currentTriangle.id << "：\n"
-                    //           << "  顶点0：" << currentTriangle.vertices[0].x << ","
-                    //           << currentTriangle.vertices[0].y << "," << currentTriangle.vertices[0].z << "\n"
-                    //           << "  顶点1：" << currentTriangle.vertices[1].x << ","
-                    //           << currentTriangle.vertices[1].y << "," << currentTriangle.vertices[1].z << "\n"
-                    //           << "  顶点2：" << currentTriangle.vertices[2].x << ","
-                    //           << currentTriangle.vertices[2].y << "," << currentTriangle.vertices[2].z << "\n";
+        void skip_space() {
+            while (p_ < end_ && is_space(*p_)) {
+                if (*p_ == '\n') ++line_;
+                ++p_;
+            }
+        }
+    };
+
+    // 解析ASCII STL（无名solid使用default_name）
+    inline StlModel parseStlAscii(const char* begin, const char* end, const std::string& default_name) {
+        StlModel model;
+        SolidData* solid = nullptr;  // 当前solid（不在solid内时为空）
+        Triangle currentTriangle;
+        int vertexCount = 0;
+        bool inFacet = false;
+        bool inLoop = false;
+        int triangleId = 0;   // 三角形ID（按顺序递增）
+
+        StlTokenizer tok(begin, end);
+        while (!tok.done()) {
+            const std::string_view key = tok.word();
+
+            if (key == "solid") {
+                const std::string_view name = tok.rest_of_line_word();
+                solid = &model[name.empty() ? default_name : std::string(name)];
+                inFacet = false;
+                inLoop = false;
+            } else if (key == "endsolid") {
+                tok.skip_line();
+                solid = nullptr;
+                inFacet = false;
+                inLoop = false;
+            } else if (!solid) {
+                tok.skip_line();  // 不在solid内则跳过
+            } else if (key == "facet") {
+                if (tok.word() != "normal") {
+                    throw std::runtime_error("STL第" + std::to_string(tok.line()) + "行缺少normal");
+                }
+                currentTriangle = Triangle();
+                currentTriangle.normal.x = tok.number();
+                currentTriangle.normal.y = tok.number();
+                currentTriangle.normal.z = tok.number();
+                inFacet = true;
+                inLoop = false;
+                vertexCount = 0;
+            } else if (key == "outer") {
+                tok.skip_line();
+                inLoop = inFacet;  // 进入loop后才开始解析顶点
+            } else if (key == "endloop") {
+                inLoop = false;
+            } else if (key == "endfacet") {
+                inFacet = false;
+                inLoop = false;
+            } else if (key == "vertex") {
+                const double x = tok.number();
+                const double y = tok.number();
+                const double z = tok.number();
+                if (inLoop && vertexCount < 3) {
+                    currentTriangle.vertices[vertexCount++] = Point3D(x, y, z);
+                    // 收集到3个顶点后，添加到模型
+                    if (vertexCount == 3) {
+                        currentTriangle.id = triangleId++;
+                        solid->push_back(currentTriangle);
+                    }
                 }
+            } else {
+                tok.skip_line();  // 未知关键字
             }
         }
+        return model;
     }
 
-    return model;
-}
+    // 解析二进制STL：80字节文件头 + uint32三角形数 + 每个三角形50字节
+    // （法向量与三个顶点共12个float，加2字节属性）；二进制格式没有solid名，全部归入solid_name
+    inline StlModel parseStlBinary(const char* data, size_t size, const std::string& solid_name) {
+        constexpr size_t kHeaderSize = 84;
+        constexpr size_t kRecordSize = 50;
+        if (size < kHeaderSize) {
+            throw std::runtime_error("二进制STL文件过短");
+        }
+        uint32_t count = 0;
+        std::memcpy(&count, data + 80, sizeof(count));
+        if ((size - kHeaderSize) / kRecordSize < count) {
+            throw std::runtime_error("二进制STL文件被截断");
+        }
+
+        StlModel model;
+        SolidData& solid = model[solid_name];
+        solid.resize(count);
+        const char* p = data + kHeaderSize;
+        for (uint32_t i = 0; i < count; ++i, p += kRecordSize) {
+            float v[12];
+            std::memcpy(v, p, sizeof(v));
+            Triangle& tri = solid[i];
+            tri.normal = Point3D(v[0], v[1], v[2]);
+            for (int k = 0; k < 3; ++k) {
+                tri.vertices[k] = Point3D(v[3 + 3 * k], v[4 + 3 * k], v[5 + 3 * k]);
+            }
+            tri.id = static_cast<int>(i);
+        }
+        return model;
+    }
+
+    // 判断是否为二进制STL：文件长度与头部记录的三角形数一致，
+    // 且不是以"solid"开头、随后出现"facet"的文本（部分导出器的二进制头也以solid开头）
+    inline bool isBinaryStl(const char* data, size_t size) {
+        if (size < 84) return false;
+        uint32_t count = 0;
+        std::memcpy(&count, data + 80, sizeof(count));
+        const bool size_matches = 84 + static_cast<uint64_t>(count) * 50 == size;
+        if (!size_matches) return false;
+
+        const std::string_view head(data, std::min<size_t>(size, 1024));
+        const size_t first = head.find_first_not_of(" \t\r\n");
+        const bool looks_ascii = first != std::string_view::npos &&
+                                 head.substr(first, 5) == "solid" &&
+                                 head.find("facet") != std::string_view::npos &&
+                                 head.find('\0') == std::string_view::npos;
+        return !looks_ascii;
+    }
+
+    // 解析STL文件（自动识别ASCII/二进制格式，文件以内存映射方式读取）
+    // 无名solid和二进制STL以文件名（不含扩展名）作为solid名
+    inline StlModel parseStlFile(const std::string& filePath) {
+        const util::MappedFile file(filePath);
+        const std::string default_name = std::filesystem::path(filePath).stem().string();
+
+        if (isBinaryStl(file.data(), file.size())) {
+            return parseStlBinary(file.data(), file.size(), default_name);
+        }
+        return parseStlAscii(file.begin(), file.end(), default_name);
+    }
 
     // 打印解析结果
     inline void printStlModel(const StlModel& model) {
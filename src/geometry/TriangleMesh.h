@@ -7,10 +7,15 @@
 
 #include <algorithm>
 #include <array>
+#include <cstdint>
 #include <vector>
 #include <cmath>
 #include <iostream>
 #include <map>
+#include <span>
+#include <stdexcept>
+
+#include <ThreadPool.h>
 
 #include "Point3D.h"
 #include "Triangle.h"
@@ -26,16 +31,95 @@ inline double triangle_area(const Point3D& a, const Point3D& b, const Point3D& c
                       cross_product.z * cross_product.z);
 }
 
+// 细分面的顶点下标（父三角形内的局部下标）
+using MeshFace = std::array<uint32_t, 3>;
+
+// 遮挡判定的采样点：细分面的中心、所属父三角形的单位法向量和ID
+struct SurfaceSample {
+    Point3D center;
+    Point3D normal;
+    int parent_id = -1;
+};
+
+// 一个父三角形细分结果的只读视图，数据存放在所属solid的SolidMesh中
+// 同一父三角形的所有细分面共用父三角形的法向量
 struct TriangleMesh {
-    std::vector<Point3D> vertices;
-    std::vector<std::vector<size_t>> faces;
-    std::vector<Point3D> centers;  //中心点
-    std::vector<Point3D> normals;  //法向量
-    std::vector<double> areas; //面积
-    std::vector<int> levels;
+    std::span<const Point3D> vertices;
+    std::span<const MeshFace> faces;
+    std::span<const Point3D> centers;  //中心点
+    std::span<const double> areas; //面积
+    Point3D normal;  //法向量（来自原始输入）
     int parent_id=-1;  //父表面的id
-    double original_area;
-    double avg_area;
+    int level = 0;  //细分层级
+    double original_area = 0.0;
+
+    [[nodiscard]] double avg_area() const {
+        return faces.empty() ? 0.0 : original_area / static_cast<double>(faces.size());
+    }
+
+    // 第face_idx个细分面的采样点
+    [[nodiscard]] SurfaceSample sample(size_t face_idx) const {
+        if (face_idx >= faces.size() || face_idx >= centers.size()) {
+            throw std::out_of_range("无效的面索引: " + std::to_string(face_idx));
+        }
+        return {centers[face_idx], normal.normalize(), parent_id};
+    }
+};
+
+// 一个solid的细分网格存储区：所有父三角形的顶点、面、中心点、面积分别连续存放，
+// 每个父三角形只记录各数组中的区间和父三角形属性；按下标取得TriangleMesh视图
+class SolidMesh {
+public:
+    // 父三角形在各数组中的区间
+    struct Parent {
+        uint32_t first_vertex;
+        uint32_t vertex_count;
+        uint32_t first_face;
+        uint32_t face_count;
+        Point3D normal;
+        int parent_id;
+        int level;
+        double original_area;
+    };
+
+    std::vector<Point3D> vertices;
+    std::vector<MeshFace> faces;
+    std::vector<Point3D> centers;
+    std::vector<double> areas;
+    std::vector<Parent> parents;
+
+    [[nodiscard]] size_t size() const { return parents.size(); }
+    [[nodiscard]] bool empty() const { return parents.empty(); }
+    [[nodiscard]] size_t faceCount() const { return faces.size(); }
+
+    [[nodiscard]] TriangleMesh operator[](size_t i) const {
+        const Parent& p = parents[i];
+        TriangleMesh mesh;
+        mesh.vertices = std::span<const Point3D>(vertices).subspan(p.first_vertex, p.vertex_count);
+        mesh.faces = std::span<const MeshFace>(faces).subspan(p.first_face, p.face_count);
+        mesh.centers = std::span<const Point3D>(centers).subspan(p.first_face, p.face_count);
+        mesh.areas = std::span<const double>(areas).subspan(p.first_face, p.face_count);
+        mesh.normal = p.normal;
+        mesh.parent_id = p.parent_id;
+        mesh.level = p.level;
+        mesh.original_area = p.original_area;
+        return mesh;
+    }
+
+    // 存储区占用的字节数
+    [[nodiscard]] size_t bytes() const {
+        return vertices.capacity() * sizeof(Point3D) + faces.capacity() * sizeof(MeshFace) +
+               centers.capacity() * sizeof(Point3D) + areas.capacity() * sizeof(double) +
+               parents.capacity() * sizeof(Parent);
+    }
+
+    void shrink_to_fit() {
+        vertices.shrink_to_fit();
+        faces.shrink_to_fit();
+        centers.shrink_to_fit();
+        areas.shrink_to_fit();
+        parents.shrink_to_fit();
+    }
 };
 
 inline double distance(const Point3D& a, const Point3D& b) {
@@ -44,127 +128,127 @@ inline double distance(const Point3D& a, const Point3D& b) {
                     std::pow(a.z - b.z, 2));
 }
 
-inline TriangleMesh adaptive_subdivide_with_centers(const Point3D& v1,
-                                                    const Point3D& v2,
-                                                    const Point3D& v3,
-                                                    const int face_id,
-                                                    const Point3D& normal,  // 新增参数：原始法向量
-                                                    const double min_edge_length = 0.5,
-                                                    const int max_level = 5) {
-    TriangleMesh mesh;
-    mesh.parent_id = face_id;
-    std::map<std::pair<size_t, size_t>, size_t> edge_midpoints;
-
-    // 计算原始三角形面积
-    mesh.original_area = triangle_area(v1, v2, v3);
-    //std::cout<<"PT"<<v1.x<<v1.y<<v1.z<<v2.x<<v2.y<<v2.z<<v3.x<<v3.y<<v3.z<<"Area"<<mesh.original_area<<std::endl;
-
-    auto get_midpoint = [&](size_t a, size_t b) {
-        auto key = std::make_pair(std::min(a, b), std::max(a, b));
-        if (!edge_midpoints.contains(key)) {
-            edge_midpoints[key] = mesh.vertices.size();
-            mesh.vertices.emplace_back(
-                (mesh.vertices[a].x + mesh.vertices[b].x) / 2,
-                (mesh.vertices[a].y + mesh.vertices[b].y) / 2,
-                (mesh.vertices[a].z + mesh.vertices[b].z) / 2
-            );
-        }
-        return edge_midpoints[key];
-    };
+// 中点细分的层数：每次细分得到4个与父三角形相似、边长减半的子三角形，
+// 所以各子三角形是否继续细分只取决于原三角形的最长边，层数可直接算出
+inline int subdivision_level(const Point3D& v1, const Point3D& v2, const Point3D& v3,
+                             const double min_edge_length, const int max_level) {
+    double longest = std::max({(v2 - v1).magnitude(), (v3 - v2).magnitude(), (v1 - v3).magnitude()});
+    int level = 0;
+    while (level < max_level && longest > 1.5 * min_edge_length) {
+        longest *= 0.5;
+        ++level;
+    }
+    return level;
+}
 
-    // 初始化
-    mesh.vertices = {v1, v2, v3};
-    mesh.faces = {{0, 1, 2}};
-    mesh.centers.emplace_back(
-        (v1.x + v2.x + v3.x) / 3,
-        (v1.y + v2.y + v3.y) / 3,
-        (v1.z + v2.z + v3.z) / 3
-    );
-
-    // 使用传入的法向量，而不是计算
-    mesh.normals.push_back(normal);
-    mesh.levels.push_back(0);
-    mesh.areas.push_back(mesh.original_area);  // 初始化第一个面的面积
-
-    for (int level = 1; level <= max_level; ++level) {
-        std::vector<std::vector<size_t>> new_faces;
-        std::vector<Point3D> new_centers;
-        std::vector<Point3D> new_normals; // 新增：存储新面的法向量
-        std::vector<double> new_areas;  // 存储新面的面积
-        bool needs_subdivision = false;
-
-        for (size_t idx = 0; idx < mesh.faces.size(); ++idx) {
-            const auto& face = mesh.faces[idx];
-
-            // 计算边长
-            std::array<double, 3> edge_lengths = {
-                distance(mesh.vertices[face[1]], mesh.vertices[face[0]]),
-                distance(mesh.vertices[face[2]], mesh.vertices[face[1]]),
-                distance(mesh.vertices[face[0]], mesh.vertices[face[2]])
-            };
-
-            // 检查是否需要细分
-            if (std::ranges::any_of(edge_lengths,
-                                    [&](double len) { return len > 1.5 * min_edge_length; })) {
-                needs_subdivision = true;
-
-                // 获取中点
-                size_t mid0 = get_midpoint(face[0], face[1]);
-                size_t mid1 = get_midpoint(face[1], face[2]);
-                size_t mid2 = get_midpoint(face[2], face[0]);
-
-                // 创建子三角形
-                std::vector<std::vector<size_t>> sub_tris = {
-                    {face[0], mid0, mid2},
-                    {face[1], mid1, mid0},
-                    {face[2], mid2, mid1},
-                    {mid0, mid1, mid2}
-                };
-
-                // 计算每个子三角形的中心点，并保留原始法向量
-                for (const auto& tri : sub_tris) {
-                    const Point3D& a = mesh.vertices[tri[0]];
-                    const Point3D& b = mesh.vertices[tri[1]];
-                    const Point3D& c = mesh.vertices[tri[2]];
-                    // 计算子三角形面积（核心新增逻辑）
-                    double sub_area = triangle_area(a, b, c);
-
-                    // 计算中心点
-                    new_centers.emplace_back(
-                        (a.x + b.x + c.x) / 3,
-                        (a.y + b.y + c.y) / 3,
-                        (a.z + b.z + c.z) / 3
-                    );
-
-                    // 所有子三角形都使用原始法向量
-                    new_normals.push_back(mesh.normals[idx]);
-
-                    new_faces.push_back(tri);
-                    new_areas.push_back(sub_area);
-                }
-            } else {
-                // 如果不需要细分，保留原面及其法向量
-                new_faces.push_back(face);
-                new_centers.push_back(mesh.centers[idx]);
-                new_normals.push_back(mesh.normals[idx]);
-                new_areas.push_back(mesh.areas[idx]);  // 保留原面积
+// 细分level层后的顶点数与面数（每条边分成n=2^level段的三角形点阵）
+inline size_t subdivision_vertex_count(int level) {
+    const size_t n = size_t{1} << level;
+    return (n + 1) * (n + 2) / 2;
+}
+
+inline size_t subdivision_face_count(int level) {
+    const size_t n = size_t{1} << level;
+    return n * n;
+}
+
+// 细分点阵中的顶点坐标(i, j)，i+j<=n
+struct LatticePoint {
+    uint32_t i;
+    uint32_t j;
+};
+
+// 点阵顶点的空间位置；n为2的幂，角点处的权重恰好为1，原三角形的顶点保持不变
+inline Point3D lattice_vertex(const Point3D& v1, const Point3D& v2, const Point3D& v3,
+                              uint32_t n, double inv_n, LatticePoint p) {
+    return (v1 * static_cast<double>(n - p.i - p.j) + v2 * static_cast<double>(p.i) +
+            v3 * static_cast<double>(p.j)) * inv_n;
+}
+
+inline Point3D face_center(const Point3D& a, const Point3D& b, const Point3D& c) {
+    return Point3D((a.x + b.x + c.x) / 3, (a.y + b.y + c.y) / 3, (a.z + b.z + c.z) / 3);
+}
+
+// 按固定顺序枚举每条边分成n段的点阵中的子三角形：逐行先朝上、再朝下，绕向与原三角形一致
+template <typename Fn>
+inline void for_each_lattice_face(uint32_t n, Fn&& fn) {
+    for (uint32_t j = 0; j < n; ++j) {
+        for (uint32_t i = 0; i + j < n; ++i) {
+            fn(LatticePoint{i, j}, LatticePoint{i + 1, j}, LatticePoint{i, j + 1});
+            if (i + j + 1 < n) {
+                fn(LatticePoint{i + 1, j}, LatticePoint{i + 1, j + 1}, LatticePoint{i, j + 1});
             }
         }
+    }
+}
 
-        // 更新网格数据
-        mesh.faces = new_faces;
-        mesh.centers = new_centers;
-        mesh.normals = new_normals;
-        mesh.areas = new_areas;  // 更新面积列表
-        mesh.levels = std::vector<int>(mesh.faces.size(), level);
+// 在存储区中预先分配好的区间内写入一个父三角形的细分结果
+// 点阵顶点(i, j)的下标由行偏移直接算出，不需要查找边中点
+inline void fill_subdivision(SolidMesh& solid, const SolidMesh::Parent& parent,
+                             const Point3D& v1, const Point3D& v2, const Point3D& v3) {
+    const uint32_t n = 1u << parent.level;
+    const double inv_n = 1.0 / n;
+    Point3D* vertices = solid.vertices.data() + parent.first_vertex;
+    MeshFace* faces = solid.faces.data() + parent.first_face;
+    Point3D* centers = solid.centers.data() + parent.first_face;
+    double* areas = solid.areas.data() + parent.first_face;
+
+    auto index = [n](LatticePoint p) {
+        return p.j * (n + 1) - p.j * (p.j - 1) / 2 + p.i;
+    };
 
-        if (!needs_subdivision) break;
+    for (uint32_t j = 0; j <= n; ++j) {
+        for (uint32_t i = 0; i + j <= n; ++i) {
+            vertices[index({i, j})] = lattice_vertex(v1, v2, v3, n, inv_n, {i, j});
+        }
     }
 
-    // 计算平均每个三角形的面积
-    mesh.avg_area = mesh.original_area / static_cast<double>(mesh.faces.size());
+    // 各子三角形全等，面积相同
+    const double sub_area = parent.original_area / (static_cast<double>(n) * n);
+    uint32_t f = 0;
+    for_each_lattice_face(n, [&](LatticePoint a, LatticePoint b, LatticePoint c) {
+        faces[f] = {index(a), index(b), index(c)};
+        centers[f] = face_center(vertices[faces[f][0]], vertices[faces[f][1]], vertices[faces[f][2]]);
+        areas[f] = sub_area;
+        ++f;
+    });
+}
+
+// 为父三角形登记区间：按细分层数确定顶点、面数，追加在存储区当前末尾
+inline SolidMesh::Parent plan_subdivision(size_t vertex_end, size_t face_end,
+                                          const Point3D& v1, const Point3D& v2, const Point3D& v3,
+                                          const int face_id, const Point3D& normal,
+                                          const double min_edge_length, const int max_level) {
+    SolidMesh::Parent parent;
+    parent.level = subdivision_level(v1, v2, v3, min_edge_length, max_level);
+    parent.first_vertex = static_cast<uint32_t>(vertex_end);
+    parent.vertex_count = static_cast<uint32_t>(subdivision_vertex_count(parent.level));
+    parent.first_face = static_cast<uint32_t>(face_end);
+    parent.face_count = static_cast<uint32_t>(subdivision_face_count(parent.level));
+    parent.normal = normal;
+    parent.parent_id = face_id;
+    parent.original_area = triangle_area(v1, v2, v3);
+    return parent;
+}
 
-    return mesh;
+// 细分一个父三角形，结果追加到solid的存储区末尾，返回生成的面数
+inline size_t adaptive_subdivide_with_centers(SolidMesh& solid,
+                                              const Point3D& v1,
+                                              const Point3D& v2,
+                                              const Point3D& v3,
+                                              const int face_id,
+                                              const Point3D& normal,  // 原始法向量
+                                              const double min_edge_length = 0.5,
+                                              const int max_level = 5) {
+    const SolidMesh::Parent parent = plan_subdivision(solid.vertices.size(), solid.faces.size(),
+                                                      v1, v2, v3, face_id, normal, min_edge_length, max_level);
+    solid.parents.push_back(parent);
+    solid.vertices.resize(parent.first_vertex + parent.vertex_count);
+    solid.faces.resize(parent.first_face + parent.face_count);
+    solid.centers.resize(solid.faces.size());
+    solid.areas.resize(solid.faces.size());
+    fill_subdivision(solid, parent, v1, v2, v3);
+    return parent.face_count;
 }
 
 inline void print_mesh(const TriangleMesh& mesh) {
@@ -174,43 +258,53 @@ inline void print_mesh(const TriangleMesh& mesh) {
         std::cout << "  " << i << ": (" << v.x << ", " << v.y << ", " << v.z << ")\n";
     }
 
-    std::cout << "\n三角形面 (" << mesh.faces.size() << "个):\n";
+    std::cout << "\n三角形面 (" << mesh.faces.size() << "个), 法向向量"
+              << mesh.normal.x << ", " << mesh.normal.y << ", " << mesh.normal.z << ":\n";
     for (size_t i = 0; i < mesh.faces.size(); ++i) {
         std::cout << "  三角形" << i << ": [";
         for (auto idx : mesh.faces[i]) {
             std::cout << idx << " ";
         }
         std::cout << "] 中心点(" << mesh.centers[i].x << ", "
-                  << mesh.centers[i].y << ", " << mesh.centers[i].z
-                  << ") "<<"法向向量"<< mesh.normals[i].x << ", " << mesh.normals[i].y << ", " << mesh.normals[i].z
-                      <<"层级:" << mesh.levels[i] << "\n";
+                  << mesh.centers[i].y << ", " << mesh.centers[i].z << ")\n";
     }
 
     std::cout << "\n面积信息:\n";
     std::cout << "- 原始三角形面积: " << mesh.original_area << "\n";
     std::cout << "- 细分后三角形数量: " << mesh.faces.size() << "\n";
-    std::cout << "- 平均每个三角形面积: " << mesh.avg_area << "\n";
-    std::cout << "- 最大细分层级: " << *std::ranges::max_element(mesh.levels) << "\n";
+    std::cout << "- 平均每个三角形面积: " << mesh.avg_area() << "\n";
+    std::cout << "- 细分层级: " << mesh.level << "\n";
 }
 
-    // 将STL模型中的每个三角形细分并转换为TriangleMesh
+    // 将STL模型中的每个三角形细分，每个solid的结果存入一个SolidMesh
     // 只要特定的名称
-inline std::map<std::string, std::vector<TriangleMesh>> subdivideModel(const StlModel& model,
-                                                                       const std::vector<std::string>& surfNames,
-                                                                       double minEdgeLength = 0.5,
-                                                                       int maxLevel = 5
-                                                                               ) {
-    std::map<std::string, std::vector<TriangleMesh>> result;
-
-
+    // 先按细分层数为每个父三角形登记区间，再（可并行地）逐三角形写入，结果与线程数无关
+inline std::map<std::string, SolidMesh> subdivideModel(const StlModel& model,
+                                                       const std::vector<std::string>& surfNames,
+                                                       double minEdgeLength = 0.5,
+                                                       int maxLevel = 5,
+                                                       util::ThreadPool* pool = nullptr
+                                                               ) {
+    std::map<std::string, SolidMesh> result;
+    constexpr size_t kParentsPerTask = 256;  // 每个并行任务处理的父三角形数
 
     std::cout << "正在将STL模型中的每个三角形细分为TriangleMesh..." << std::endl;
     std::cout << "最小边长度阈值: " << minEdgeLength << ", 最大细分层级: " << maxLevel << std::endl;
 
     size_t totalOriginalTriangles = 0;
     size_t totalSubdividedTriangles = 0;
+    size_t totalBytes = 0;
+
+    // 并行任务：某个solid中连续的一段父三角形
+    struct Task {
+        SolidMesh* solid;
+        const SolidData* triangles;
+        size_t begin;
+        size_t end;
+    };
+    std::vector<Task> tasks;
 
-    // 遍历每个solid
+    // 遍历每个solid，登记各父三角形的区间并分配存储
     for (const auto& pair : model) {
         const std::string& solidName = pair.first;
 
@@ -221,43 +315,165 @@ inline std::map<std::string, std::vector<TriangleMesh>> subdivideModel(const Stl
 
         const SolidData& triangles = pair.second;
 
-        std::vector<TriangleMesh> solidMeshes;
+        SolidMesh& solidMeshes = result[solidName];
+        solidMeshes.parents.reserve(triangles.size());
         totalOriginalTriangles += triangles.size();
 
         std::cout << "处理 三角面: " << solidName << " (" << triangles.size() << " 个三角形)" << std::endl;
 
-        // 遍历每个三角形并进行细分
-        int sum=0;
+        size_t vertex_end = 0;
+        size_t face_end = 0;
         for (const auto& tri : triangles) {
-            // 使用现有的自适应细分方法处理每个三角形
-            TriangleMesh mesh = adaptive_subdivide_with_centers(
+            const SolidMesh::Parent parent = plan_subdivision(
+                vertex_end, face_end,
                 tri.vertices[0], tri.vertices[1], tri.vertices[2],
                 tri.id,
                 tri.normal,
                 minEdgeLength, maxLevel
             );
-
-            solidMeshes.push_back(mesh);
-            totalSubdividedTriangles += mesh.faces.size();
-
-            sum = mesh.faces.size();
-
+            vertex_end += parent.vertex_count;
+            face_end += parent.face_count;
+            solidMeshes.parents.push_back(parent);
+        }
+        if (vertex_end > UINT32_MAX || face_end > UINT32_MAX) {
+            throw std::runtime_error("三角面 '" + solidName + "' 细分后的网格过大");
+        }
+        solidMeshes.vertices.resize(vertex_end);
+        solidMeshes.faces.resize(face_end);
+        solidMeshes.centers.resize(face_end);
+        solidMeshes.areas.resize(face_end);
+        totalSubdividedTriangles += face_end;
+        totalBytes += solidMeshes.bytes();
+
+        for (size_t begin = 0; begin < triangles.size(); begin += kParentsPerTask) {
+            tasks.push_back({&solidMeshes, &triangles, begin, std::min(begin + kParentsPerTask, triangles.size())});
         }
 
-        result[solidName] = solidMeshes;
         std::cout << "  三角面 '" << solidName << "' 细分完成，生成 "
-                  << sum << " 个网格" << std::endl;
+                  << face_end << " 个网格" << std::endl;
+    }
+
+    // 各任务写入互不重叠的区间
+    auto fill = [&](size_t task_idx) {
+        const Task& task = tasks[task_idx];
+        for (size_t i = task.begin; i < task.end; ++i) {
+            const Triangle& tri = (*task.triangles)[i];
+            fill_subdivision(*task.solid, task.solid->parents[i], tri.vertices[0], tri.vertices[1], tri.vertices[2]);
+        }
+    };
+    if (pool) {
+        pool->parallel_for(tasks.size(), fill);
+    } else {
+        for (size_t i = 0; i < tasks.size(); ++i) fill(i);
     }
 
     std::cout << "细分完成！" << std::endl;
     std::cout << "- 原始三角形总数: " << totalOriginalTriangles << std::endl;
     std::cout << "- 细分后三角形总数: " << totalSubdividedTriangles << std::endl;
+    std::cout << "- 网格占用内存: " << totalBytes / 1024.0 / 1024.0 << " MB" << std::endl;
+
+    return result;
+}
+
+// 流式采样的父三角形：只保存原三角形和细分层数，细分面的中心与面积在使用时按点阵公式现算
+struct SampleParent {
+    Point3D v1, v2, v3;
+    Point3D normal;
+    int parent_id;
+    int level;
+    double original_area;
+    uint32_t face_count;
+};
+
+// 一个solid的流式采样源：不保存顶点和面，内存只与父三角形数有关
+// 生成的采样点（顺序、中心、面积）与subdivideModel的细分结果逐一相同
+struct SampleSolid {
+    std::vector<SampleParent> parents;
+    size_t face_count = 0;
+
+    [[nodiscard]] size_t size() const { return parents.size(); }
+    [[nodiscard]] size_t faceCount() const { return face_count; }
+};
+
+// 按细分level层的点阵逐个生成父三角形的分层采样点（每个子三角形中心一个），fn(采样点, 面积)
+template <typename Fn>
+inline void for_each_sample(const SampleParent& parent, int level, Fn&& fn) {
+    const uint32_t n = 1u << level;
+    const double inv_n = 1.0 / n;
+    const double sub_area = parent.original_area / (static_cast<double>(n) * n);
+    SurfaceSample sample{Point3D(), parent.normal.normalize(), parent.parent_id};
+    for_each_lattice_face(n, [&](LatticePoint a, LatticePoint b, LatticePoint c) {
+        sample.center = face_center(lattice_vertex(parent.v1, parent.v2, parent.v3, n, inv_n, a),
+                                    lattice_vertex(parent.v1, parent.v2, parent.v3, n, inv_n, b),
+                                    lattice_vertex(parent.v1, parent.v2, parent.v3, n, inv_n, c));
+        fn(sample, sub_area);
+    });
+}
 
+// 同上，但跳过与level-1层采样点重合的采样点（嵌套加密时沿用上一层的结果）：
+// 子三角形四分后中间那个子三角形的中心就是原子三角形的中心，即level层中
+// 以偶数点阵点为基点的朝下子三角形、以奇数点阵点为基点的朝上子三角形
+template <typename Fn>
+inline void for_each_refined_sample(const SampleParent& parent, int level, Fn&& fn) {
+    const uint32_t n = 1u << level;
+    const double inv_n = 1.0 / n;
+    const double sub_area = parent.original_area / (static_cast<double>(n) * n);
+    SurfaceSample sample{Point3D(), parent.normal.normalize(), parent.parent_id};
+    for_each_lattice_face(n, [&](LatticePoint a, LatticePoint b, LatticePoint c) {
+        const bool up = b.j == a.j;  // 朝上：(i,j),(i+1,j),(i,j+1)；朝下：(i+1,j),(i+1,j+1),(i,j+1)
+        const uint32_t i = up ? a.i : a.i - 1;
+        const uint32_t j = a.j;
+        if (up ? (i % 2 == 1 && j % 2 == 1) : (i % 2 == 0 && j % 2 == 0)) return;
+        sample.center = face_center(lattice_vertex(parent.v1, parent.v2, parent.v3, n, inv_n, a),
+                                    lattice_vertex(parent.v1, parent.v2, parent.v3, n, inv_n, b),
+                                    lattice_vertex(parent.v1, parent.v2, parent.v3, n, inv_n, c));
+        fn(sample, sub_area);
+    });
+}
+
+// 按与SolidMesh相同的顺序逐个生成父三角形各细分面的采样点，fn(采样点, 面积)
+template <typename Fn>
+inline void for_each_sample(const SampleParent& parent, Fn&& fn) {
+    for_each_sample(parent, parent.level, fn);
+}
+
+    // 为STL模型中特定名称的solid建立流式采样源（细分参数与subdivideModel相同）
+inline std::map<std::string, SampleSolid> planSamples(const StlModel& model,
+                                                      const std::vector<std::string>& surfNames,
+                                                      double minEdgeLength = 0.5,
+                                                      int maxLevel = 5) {
+    std::map<std::string, SampleSolid> result;
+    size_t totalSamples = 0;
+    size_t totalBytes = 0;
+    for (const auto& [solidName, triangles] : model) {
+        if (std::ranges::find(surfNames, solidName) == surfNames.end()) {
+            continue;
+        }
+        SampleSolid& solid = result[solidName];
+        solid.parents.reserve(triangles.size());
+        for (const auto& tri : triangles) {
+            SampleParent parent;
+            parent.v1 = tri.vertices[0];
+            parent.v2 = tri.vertices[1];
+            parent.v3 = tri.vertices[2];
+            parent.normal = tri.normal;
+            parent.parent_id = tri.id;
+            parent.level = subdivision_level(parent.v1, parent.v2, parent.v3, minEdgeLength, maxLevel);
+            parent.original_area = triangle_area(parent.v1, parent.v2, parent.v3);
+            parent.face_count = static_cast<uint32_t>(subdivision_face_count(parent.level));
+            solid.face_count += parent.face_count;
+            solid.parents.push_back(parent);
+        }
+        totalSamples += solid.face_count;
+        totalBytes += solid.parents.capacity() * sizeof(SampleParent);
+    }
+    std::cout << "流式采样: " << totalSamples << " 个采样点（不保存网格拓扑），占用内存 "
+              << totalBytes / 1024.0 / 1024.0 << " MB" << std::endl;
     return result;
 }
 
 inline void writeTriangleMesh2Stl(
-        const std::map<std::string, std::vector<TriangleMesh>>& subdividedMesh,
+        const std::map<std::string, SolidMesh>& subdividedMesh,
         const std::string& filePath
     ) {
     // 打开输出文件
@@ -269,17 +485,18 @@ inline void writeTriangleMesh2Stl(
     // 遍历每个solid
     for (const auto& solidEntry : subdividedMesh) {
         const std::string& solidName = solidEntry.first;
-        const std::vector<TriangleMesh>& meshes = solidEntry.second;
+        const SolidMesh& meshes = solidEntry.second;
 
         // 写入solid起始标记
         stlFile << "solid " << solidName << "\n";
 
         // 遍历当前solid下的所有细分网格
-        for (const TriangleMesh& mesh : meshes) {
+        for (size_t mesh_idx = 0; mesh_idx < meshes.size(); ++mesh_idx) {
+            const TriangleMesh mesh = meshes[mesh_idx];
+            const Point3D& normal = mesh.normal;  // 法向量（来自原始输入）
             // 遍历网格中的每个三角面
             for (size_t i = 0; i < mesh.faces.size(); ++i) {
                 const auto& face = mesh.faces[i];    // 顶点索引
-                const Point3D& normal = mesh.normals[i];  // 法向量（来自原始输入）
 
                 // 写入法向量
                 stlFile << "  facet normal "
@@ -289,7 +506,7 @@ inline void writeTriangleMesh2Stl(
 
                 // 写入顶点环
                 stlFile << "    outer loop\n";
-                for (size_t vertIdx : face) {
+                for (uint32_t vertIdx : face) {
                     const Point3D& vert = mesh.vertices[vertIdx];
                     stlFile << "      vertex "
                             << vert.x << " "
@@ -0,0 +1,410 @@
+//
+// Created by zhou on 25-7-21.
+//
+
+// 几何计算基准：在内存中生成参数化的城市街区场景，分阶段计时
+// （STL解析、网格细分、收集遮挡物、单角度分析、批量计算、遮挡表查询），结果以JSON输出到标准输出，
+// 过程信息输出到标准错误，便于跟踪性能回退、比较遮挡判定引擎与线程数
+//
+// 用法: bench_geometry [key=value ...]
+//   rows=4 cols=4            街区行列数（每个街区一栋楼）
+//   block=20 depth=15        楼的开间、进深（米）
+//   street=12                街道宽度（米）
+//   min_height=9 max_height=36  楼高范围（按seed确定性随机）
+//   overhang=1.5             南立面挑檐的出挑深度（米），0为不生成；每隔一栋楼生成一个
+//   ground=0                 是否生成地面（作为遮挡物）
+//   seed=1
+//   targets=all|center       分析全部楼的表面，或只分析中间一栋
+//   max_area=0.1 max_level=5 细分参数（与SurfaceGroup一致）
+//   method=raycast|raster raster_resolution=1024
+//   precision=double|float   射线求交精度
+//   samples=mesh|stream|progressive progressive_tolerance=0.05
+//   threads=1                计算线程数（<=0为全部硬件线程）
+//   angles=8                 单角度分析计时的太阳角度数
+//   lookups=1000000          遮挡表查询次数
+//   out=<文件>               同时把JSON写入文件
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <json.hpp>
+
+#include <ShadowAnalyzer.h>
+#include <SimdKernel.h>
+#include <Triangle.h>
+#include <TriangleMesh.h>
+
+using namespace geom;
+using json = nlohmann::json;
+
+namespace {
+
+// 合成城市场景参数
+struct UrbanSceneParams {
+    int rows = 4;
+    int cols = 4;
+    double block = 20.0;
+    double depth = 15.0;
+    double street = 12.0;
+    double min_height = 9.0;
+    double max_height = 36.0;
+    double overhang = 1.5;
+    bool ground = false;
+    uint32_t seed = 1;
+};
+
+// 命令行参数：key=value
+class BenchArgs {
+public:
+    BenchArgs(int argc, char** argv) {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            const auto pos = arg.find('=');
+            if (pos == std::string::npos) {
+                throw std::runtime_error("参数格式应为key=value: " + arg);
+            }
+            values_[arg.substr(0, pos)] = arg.substr(pos + 1);
+        }
+    }
+
+    [[nodiscard]] std::string get(const std::string& key, const std::string& fallback) const {
+        const auto it = values_.find(key);
+        return it == values_.end() ? fallback : it->second;
+    }
+
+    [[nodiscard]] double get(const std::string& key, double fallback) const {
+        const auto it = values_.find(key);
+        return it == values_.end() ? fallback : std::stod(it->second);
+    }
+
+    [[nodiscard]] int get(const std::string& key, int fallback) const {
+        const auto it = values_.find(key);
+        return it == values_.end() ? fallback : std::stoi(it->second);
+    }
+
+private:
+    std::map<std::string, std::string> values_;
+};
+
+// 四边形（逆时针顶点，法向量朝外）写为两个三角形
+void add_quad(SolidData& solid, const Point3D& a, const Point3D& b, const Point3D& c, const Point3D& d) {
+    const Point3D normal = (b - a).cross(d - a).normalize();
+    solid.push_back({normal, {a, b, c}});
+    solid.push_back({normal, {a, c, d}});
+}
+
+// 长方体的各个面写入name_前缀的solid（bottom为false时不生成底面）
+void add_box(StlModel& model, const std::string& name, const Point3D& lo, const Point3D& hi, bool bottom) {
+    const Point3D p000(lo.x, lo.y, lo.z), p100(hi.x, lo.y, lo.z), p110(hi.x, hi.y, lo.z), p010(lo.x, hi.y, lo.z);
+    const Point3D p001(lo.x, lo.y, hi.z), p101(hi.x, lo.y, hi.z), p111(hi.x, hi.y, hi.z), p011(lo.x, hi.y, hi.z);
+    add_quad(model[name + "_roof"], p001, p101, p111, p011);
+    add_quad(model[name + "_south"], p000, p100, p101, p001);  // 法向-y
+    add_quad(model[name + "_north"], p110, p010, p011, p111);  // 法向+y
+    add_quad(model[name + "_east"], p100, p110, p111, p101);   // 法向+x
+    add_quad(model[name + "_west"], p010, p000, p001, p011);   // 法向-x
+    if (bottom) {
+        add_quad(model[name + "_bottom"], p000, p010, p110, p100);
+    }
+}
+
+std::string building_name(int row, int col) {
+    // 逐段追加（"b" + std::to_string(...)的写法会触发GCC的-Wrestrict误报）
+    std::string name = "b";
+    name += std::to_string(row);
+    name += '_';
+    name += std::to_string(col);
+    return name;
+}
+
+// 生成rows×cols个街区：每个街区一栋楼，楼之间为街道（街谷），每隔一栋楼在南立面中部加一个挑檐
+// 三角形ID按solid名顺序编号，与写出再解析得到的模型一致
+StlModel make_urban_scene(const UrbanSceneParams& params) {
+    StlModel model;
+    std::mt19937 rng(params.seed);
+    const double pitch_x = params.block + params.street;
+    const double pitch_y = params.depth + params.street;
+    for (int row = 0; row < params.rows; ++row) {
+        for (int col = 0; col < params.cols; ++col) {
+            const double t = static_cast<double>(rng() % 1001) / 1000.0;
+            const double height = params.min_height + t * (params.max_height - params.min_height);
+            const Point3D lo(col * pitch_x, row * pitch_y, 0.0);
+            const Point3D hi(lo.x + params.block, lo.y + params.depth, height);
+            const std::string name = building_name(row, col);
+            add_box(model, name, lo, hi, false);
+
+            if (params.overhang > 0 && (row + col) % 2 == 0) {
+                const double z = height / 3.0;
+                add_box(model, name + "_overhang",
+                        Point3D(lo.x + 0.1 * params.block, lo.y - params.overhang, z),
+                        Point3D(hi.x - 0.1 * params.block, lo.y, z + 0.3), true);
+            }
+        }
+    }
+    if (params.ground) {
+        const double margin = params.street;
+        add_quad(model["ground"],
+                 Point3D(-margin, -margin, 0.0),
+                 Point3D(params.cols * (params.block + params.street) + margin, -margin, 0.0),
+                 Point3D(params.cols * (params.block + params.street) + margin, params.rows * (params.depth + params.street) + margin, 0.0),
+                 Point3D(-margin, params.rows * (params.depth + params.street) + margin, 0.0));
+    }
+
+    int id = 0;
+    for (auto& [_, triangles] : model) {
+        for (auto& tri : triangles) {
+            tri.id = id++;
+        }
+    }
+    return model;
+}
+
+// 需要分析的表面：全部楼（或中间一栋楼）的屋顶与四个立面
+std::vector<std::string> target_surfaces(const UrbanSceneParams& params, bool center_only) {
+    std::vector<std::string> names;
+    for (int row = 0; row < params.rows; ++row) {
+        for (int col = 0; col < params.cols; ++col) {
+            if (center_only && (row != params.rows / 2 || col != params.cols / 2)) continue;
+            const std::string name = building_name(row, col);
+            for (const char* face : {"_roof", "_south", "_north", "_east", "_west"}) {
+                names.push_back(name + face);
+            }
+        }
+    }
+    return names;
+}
+
+size_t triangle_count(const StlModel& model) {
+    size_t n = 0;
+    for (const auto& [_, triangles] : model) {
+        n += triangles.size();
+    }
+    return n;
+}
+
+template <typename Fn>
+double time_seconds(Fn&& fn) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+json stats_to_json(const OcclusionStats& stats) {
+    return {
+        {"faces", stats.faces},
+        {"rays", stats.rays},
+        {"triangle_tests", stats.triangle_tests},
+        {"tests_per_ray", stats.tests_per_ray()},
+        {"cache_hit_rate", stats.cache_hit_rate()},
+    };
+}
+
+// 批量计算（网格与SurfaceGroup的Grid模式相同），返回耗时
+template <typename Solid>
+double time_batch(ShadowAnalyzer& analyzer, const StlModel& model, const std::map<std::string, Solid>& receivers,
+                  const std::string& csv_path) {
+    return time_seconds([&] {
+        analyzer.batchCalculate(model, receivers, 0.0, 90.0, 15.0, 0.0, 360.0, 30.0, csv_path);
+    });
+}
+
+json run(const BenchArgs& args) {
+    UrbanSceneParams scene;
+    scene.rows = args.get("rows", scene.rows);
+    scene.cols = args.get("cols", scene.cols);
+    scene.block = args.get("block", scene.block);
+    scene.depth = args.get("depth", scene.depth);
+    scene.street = args.get("street", scene.street);
+    scene.min_height = args.get("min_height", scene.min_height);
+    scene.max_height = args.get("max_height", scene.max_height);
+    scene.overhang = args.get("overhang", scene.overhang);
+    scene.ground = args.get("ground", 0) != 0;
+    scene.seed = static_cast<uint32_t>(args.get("seed", static_cast<int>(scene.seed)));
+    const std::string targets_mode = args.get("targets", std::string("all"));
+    const double max_area = args.get("max_area", 0.1);
+    const int max_level = args.get("max_level", 5);
+    const std::string method = args.get("method", std::string("raycast"));
+    const int raster_resolution = args.get("raster_resolution", 1024);
+    const std::string precision = args.get("precision", std::string("double"));
+    if (precision != "double" && precision != "float") {
+        throw std::runtime_error("未知的求交精度: " + precision);
+    }
+    const bool use_float = precision == "float";
+    const std::string samples = args.get("samples", std::string("mesh"));
+    const double progressive_tolerance = args.get("progressive_tolerance", 0.05);
+    const int threads = args.get("threads", 1);
+    const int angle_count = args.get("angles", 8);
+    const int lookups = args.get("lookups", 1000000);
+    if (targets_mode != "all" && targets_mode != "center") {
+        throw std::runtime_error("未知的分析范围: " + targets_mode);
+    }
+    if (samples != "mesh" && samples != "stream" && samples != "progressive") {
+        throw std::runtime_error("未知的采样方式: " + samples);
+    }
+
+    json result;
+    json& stages = result["stages"];
+
+    // 1. 生成场景
+    StlModel model;
+    stages["generate_scene"]["seconds"] = time_seconds([&] { model = make_urban_scene(scene); });
+    const auto targets = target_surfaces(scene, targets_mode == "center");
+
+    // 2. STL解析（先写出为ASCII STL）
+    const auto tmp_dir = std::filesystem::temp_directory_path();
+    const std::string stl_path = (tmp_dir / "bench_geometry_scene.stl").string();
+    const std::string csv_path = (tmp_dir / "bench_geometry_shd.csv").string();
+    writeStlFile(model, stl_path);
+    StlModel parsed;
+    stages["parse_stl"]["seconds"] = time_seconds([&] { parsed = parseStlFile(stl_path); });
+    stages["parse_stl"]["bytes"] = std::filesystem::file_size(stl_path);
+    stages["parse_stl"]["triangles"] = triangle_count(parsed);
+    std::filesystem::remove(stl_path);
+
+    ShadowAnalyzer analyzer;
+    const size_t thread_count = util::ThreadPool::resolve_thread_count(threads);
+    analyzer.setThreadPool(thread_count > 1 ? std::make_shared<util::ThreadPool>(thread_count) : nullptr);
+    analyzer.setOcclusionMethod(parse_occlusion_method(method), raster_resolution,
+                                use_float ? GeometryPrecision::Float : GeometryPrecision::Double);
+    if (samples == "progressive") {
+        analyzer.setProgressiveSampling({progressive_tolerance, 2});
+    }
+
+    // 3. 网格细分（流式采样时同时计时采样源的建立）
+    std::map<std::string, SolidMesh> meshMap;
+    stages["subdivide"]["seconds"] = time_seconds([&] {
+        meshMap = subdivideModel(model, targets, max_area, max_level, analyzer.threadPool());
+    });
+    size_t receiver_faces = 0, mesh_bytes = 0;
+    for (const auto& [_, solid] : meshMap) {
+        receiver_faces += solid.faceCount();
+        mesh_bytes += solid.bytes();
+    }
+    stages["subdivide"]["faces"] = receiver_faces;
+    stages["subdivide"]["bytes"] = mesh_bytes;
+    std::map<std::string, SampleSolid> sampleMap;
+    if (samples != "mesh") {
+        stages["plan_samples"]["seconds"] = time_seconds([&] {
+            sampleMap = planSamples(model, targets, max_area, max_level);
+        });
+    }
+
+    // 4. 收集遮挡物与构建加速结构
+    OccluderBuffer occluders;
+    stages["collect_occluders"]["seconds"] = time_seconds([&] { occluders = collect_occluders(model); });
+    stages["collect_occluders"]["occluders"] = occluders.size();
+    stages["collect_occluders"]["bytes"] = occluders.memory_bytes();
+    stages["build_bvh"]["seconds"] = time_seconds([&] {
+        const auto built = OccluderScene::build(std::move(occluders), true, use_float);
+        stages["build_bvh"]["nodes"] = built->bvh.nodes().size();
+        if (use_float) stages["build_bvh"]["float_bytes"] = built->occluders_f.memory_bytes();
+    });
+
+    // 5. 单个太阳角度的逐面分析（高度角15°~75°、方位角绕一周）
+    analyzer.loadOccluders(model);
+    json per_angle = json::array();
+    double analyze_total = 0.0;
+    for (int k = 0; k < angle_count; ++k) {
+        const double altitude = 15.0 + 60.0 * k / std::max(1, angle_count - 1);
+        const double azimuth = 360.0 * k / std::max(1, angle_count);
+        const double seconds = time_seconds([&] { analyzer.analyze(meshMap, altitude, azimuth); });
+        analyze_total += seconds;
+        per_angle.push_back({{"altitude", altitude}, {"azimuth", azimuth}, {"seconds", seconds}});
+    }
+    stages["analyze"]["angles"] = per_angle;
+    stages["analyze"]["mean_seconds"] = angle_count > 0 ? analyze_total / angle_count : 0.0;
+
+    // 6. 批量计算（含视角系数）
+    analyzer.resetOcclusionStats();
+    stages["batch_calculate"]["seconds"] = samples == "mesh"
+        ? time_batch(analyzer, model, meshMap, csv_path)
+        : time_batch(analyzer, model, sampleMap, csv_path);
+    stages["batch_calculate"]["occlusion"] = stats_to_json(analyzer.occlusionStats());
+    if (samples == "progressive") {
+        // 各表面的采样点数与受照比例的标准误差估计（估计，不是误差界）
+        json per_surface = json::object();
+        const auto& names = analyzer.shadowTable().surfaceNames();
+        const auto& sampling = analyzer.samplingStats();
+        for (size_t i = 0; i < sampling.size() && i < names.size(); ++i) {
+            per_surface[names[i]] = {
+                {"samples", sampling[i].samples},
+                {"full_samples", sampling[i].full_samples},
+                {"max_error_estimate", sampling[i].max_error},
+                {"mean_error_estimate", sampling[i].mean_error()},
+            };
+        }
+        stages["batch_calculate"]["sampling"] = per_surface;
+    }
+    std::filesystem::remove(csv_path);
+
+    // 7. 遮挡表查询（确定性的伪随机太阳位置与表面）
+    std::vector<int> ids;
+    for (const auto& name : targets) {
+        ids.push_back(analyzer.surfaceId(name));
+    }
+    std::mt19937 rng(scene.seed);
+    double checksum = 0.0;
+    const double lookup_seconds = time_seconds([&] {
+        for (int i = 0; i < lookups; ++i) {
+            const double altitude = static_cast<double>(rng() % 9000) / 100.0;
+            const double azimuth = static_cast<double>(rng() % 36000) / 100.0;
+            checksum += analyzer.get_shadow_value(altitude, azimuth, ids[i % ids.size()]);
+        }
+    });
+    stages["get_shadow_value"]["seconds"] = lookup_seconds;
+    stages["get_shadow_value"]["lookups"] = lookups;
+    stages["get_shadow_value"]["ns_per_lookup"] = lookups > 0 ? lookup_seconds * 1e9 / lookups : 0.0;
+    stages["get_shadow_value"]["checksum"] = checksum;
+
+    result["scene"] = {
+        {"rows", scene.rows}, {"cols", scene.cols},
+        {"block", scene.block}, {"depth", scene.depth}, {"street", scene.street},
+        {"min_height", scene.min_height}, {"max_height", scene.max_height},
+        {"overhang", scene.overhang}, {"ground", scene.ground}, {"seed", scene.seed},
+        {"triangles", triangle_count(model)},
+        {"targets", targets_mode}, {"receivers", targets.size()},
+    };
+    result["config"] = {
+        {"method", method}, {"raster_resolution", raster_resolution}, {"precision", precision},
+        {"samples", samples}, {"threads", analyzer.getNumThreads()},
+        {"hardware_threads", util::ThreadPool::resolve_thread_count(0)},
+        {"isa", simd::isa_name(simd::active_isa())},
+        {"max_area", max_area}, {"max_level", max_level},
+    };
+    return result;
+}
+
+}
+
+int main(int argc, char** argv) {
+    // 过程信息改写到标准错误，标准输出只输出JSON
+    std::streambuf* const stdout_buf = std::cout.rdbuf(std::cerr.rdbuf());
+    try {
+        const BenchArgs args(argc, argv);
+        const json result = run(args);
+        std::cout.rdbuf(stdout_buf);
+        std::cout << result.dump(2) << std::endl;
+
+        const std::string out = args.get("out", std::string());
+        if (!out.empty()) {
+            std::ofstream file(out);
+            if (!file.is_open()) {
+                throw std::runtime_error("无法写入结果文件: " + out);
+            }
+            file << result.dump(2) << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cout.rdbuf(stdout_buf);
+        std::cerr << "错误: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
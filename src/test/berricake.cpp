@@ -1,5 +1,7 @@
 #include <SimManager.h>
 #include <ComponentRegistry.h>
+#include <charconv>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <getopt.h>
@@ -8,8 +10,10 @@
 struct ProgramArgs {
     std::string inputFile = "in.idf"; // 默认输入文件
     bool help = false;                // 是否显示帮助信息
+    bool invalid = false;             // 参数有误（显示帮助信息后退出）
     bool verbose = false;             // 是否启用详细输出
     std::string logLevel = "INFO";    // 日志级别
+    int threads = 1;                  // 计算线程数（0为全部硬件线程）
 };
 
 // 显示帮助信息
@@ -20,6 +24,7 @@ void showHelp(const std::string& programName) {
     std::cout << "  -v, --verbose       启用详细输出" << std::endl;
     std::cout << "  -l, --loglevel      设置日志级别 (DEBUG, INFO, WARN, ERROR, FATAL)" << std::endl;
     std::cout << "  -i, --input         指定输入文件 (默认: in.idf)" << std::endl;
+    std::cout << "  -t, --threads       计算线程数，用于遮挡计算和组件并行计算 (默认: 1, 0表示使用全部CPU核心)" << std::endl;
 }
 
 // 解析命令行参数
@@ -32,6 +37,7 @@ ProgramArgs parseArguments(int argc, char* argv[]) {
         {"verbose", no_argument,       0, 'v'},
         {"loglevel", required_argument, 0, 'l'},
         {"input",   required_argument, 0, 'i'},
+        {"threads", required_argument, 0, 't'},
         {nullptr, 0, nullptr, 0}
     };
     
@@ -39,7 +45,7 @@ ProgramArgs parseArguments(int argc, char* argv[]) {
     int optionIndex = 0;
     
     // 解析选项
-    while ((opt = getopt_long(argc, argv, "hvl:i:", longOptions, &optionIndex)) != -1) {
+    while ((opt = getopt_long(argc, argv, "hvl:i:t:", longOptions, &optionIndex)) != -1) {
         switch (opt) {
             case 'h':
                 args.help = true;
@@ -53,8 +59,19 @@ ProgramArgs parseArguments(int argc, char* argv[]) {
             case 'i':
                 args.inputFile = optarg;
                 break;
+            case 't': {
+                // 只接受非负整数（整个参数都应是数字）
+                const char* end = optarg + std::strlen(optarg);
+                const auto [ptr, ec] = std::from_chars(optarg, end, args.threads);
+                if (ec != std::errc() || ptr != end || args.threads < 0) {
+                    std::cerr << "线程数参数无效: " << optarg << std::endl;
+                    args.invalid = true;
+                }
+                break;
+            }
             case '?':
                 // getopt_long 已经输出了错误信息
+                args.invalid = true;
                 break;
             default:
                 abort();
@@ -74,9 +91,9 @@ int main(int argc, char* argv[]) {
     ProgramArgs args = parseArguments(argc, argv);
     
     // 显示帮助信息并退出
-    if (args.help) {
+    if (args.help || args.invalid) {
         showHelp(argv[0]);
-        return 0;
+        return args.invalid ? 1 : 0;
     }
     
     // 输出程序启动信息
@@ -85,12 +102,16 @@ int main(int argc, char* argv[]) {
         std::cout << "详细模式: 开启" << std::endl;
         std::cout << "日志级别: " << args.logLevel << std::endl;
         std::cout << "输入文件: " << args.inputFile << std::endl;
+        std::cout << "线程数: " << args.threads << std::endl;
     }
     
     try {
         // 注册组件
         ComponentRegistry::registerAllComponents();
         
+        // 计算线程数
+        core::SystemStateHub::getInstance().setNumThreads(args.threads);
+
         // 初始化仿真管理器
         core::SimManager manager;
         
@@ -0,0 +1,49 @@
+//
+// Created by zhou on 25-7-21.
+//
+
+// 单元测试共用的检查工具：check记录失败项（只打印前20项，其余只计数），
+// 各测试的main最后以finish的返回值退出（有失败项时返回1，供ctest判定）
+
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <exception>
+#include <iostream>
+#include <string>
+
+namespace test {
+
+    inline int failures = 0;
+
+    inline void check(bool ok, const std::string& what) {
+        if (!ok) {
+            if (failures < 20) std::cerr << "失败: " << what << std::endl;
+            ++failures;
+        }
+    }
+
+    // f是否抛出异常
+    template <typename F>
+    bool throws(F&& f) {
+        try {
+            f();
+        } catch (const std::exception&) {
+            return true;
+        }
+        return false;
+    }
+
+    // 输出检查结果，返回main的退出码
+    inline int finish(const std::string& passed) {
+        if (failures > 0) {
+            std::cerr << failures << " 项检查失败" << std::endl;
+            return 1;
+        }
+        std::cout << passed << std::endl;
+        return 0;
+    }
+
+}
+
+#endif //TEST_CHECK_H
@@ -0,0 +1,52 @@
+//
+// Created by zhou on 25-7-21.
+//
+
+// 测试用的STL场景：以ASCII格式写出四边形和长方体
+
+#ifndef TEST_STL_SCENE_H
+#define TEST_STL_SCENE_H
+
+#include <ostream>
+#include <string>
+
+#include <Point3D.h>
+
+namespace test {
+
+    using geom::Point3D;
+
+    // 写出一个四边形（两个三角形），a-b-c-d按逆时针顺序
+    inline void write_quad(std::ostream& out, const Point3D& normal,
+                           const Point3D& a, const Point3D& b, const Point3D& c, const Point3D& d) {
+        auto facet = [&](const Point3D& p, const Point3D& q, const Point3D& r) {
+            out << "facet normal " << normal.x << " " << normal.y << " " << normal.z << "\n outer loop\n";
+            for (const Point3D* v : {&p, &q, &r}) {
+                out << "  vertex " << v->x << " " << v->y << " " << v->z << "\n";
+            }
+            out << " endloop\nendfacet\n";
+        };
+        facet(a, b, c);
+        facet(a, c, d);
+    }
+
+    // 长方体的六个面，各面为一个solid（名字为prefix加方向）
+    inline void write_box(std::ostream& out, const std::string& prefix, const Point3D& lo, const Point3D& hi) {
+        const Point3D p000(lo.x, lo.y, lo.z), p100(hi.x, lo.y, lo.z), p110(hi.x, hi.y, lo.z), p010(lo.x, hi.y, lo.z);
+        const Point3D p001(lo.x, lo.y, hi.z), p101(hi.x, lo.y, hi.z), p111(hi.x, hi.y, hi.z), p011(lo.x, hi.y, hi.z);
+        auto solid = [&](const std::string& name, const Point3D& n,
+                         const Point3D& a, const Point3D& b, const Point3D& c, const Point3D& d) {
+            out << "solid " << prefix << name << "\n";
+            write_quad(out, n, a, b, c, d);
+            out << "endsolid " << prefix << name << "\n";
+        };
+        solid("roof", Point3D(0, 0, 1), p001, p101, p111, p011);
+        solid("floor", Point3D(0, 0, -1), p000, p010, p110, p100);
+        solid("south", Point3D(0, -1, 0), p000, p100, p101, p001);
+        solid("north", Point3D(0, 1, 0), p010, p011, p111, p110);
+        solid("east", Point3D(1, 0, 0), p100, p110, p111, p101);
+        solid("west", Point3D(-1, 0, 0), p000, p001, p011, p010);
+    }
+}
+
+#endif //TEST_STL_SCENE_H
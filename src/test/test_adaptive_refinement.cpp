@@ -0,0 +1,72 @@
+//
+// Created by zhou on 25-7-21.
+//
+
+// 自适应细分测试：细分判据为角点受照比例（除去无遮挡时的余弦），
+// 孤立建筑（无任何遮挡）的表面不应细分；有遮挡物时阴影边缘处应细分
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <SurfaceGroup.h>
+
+#include "check.h"
+#include "stl_scene.h"
+
+using namespace geom;
+using namespace test;
+
+namespace {
+
+    ShadingOptions adaptive_options() {
+        ShadingOptions options;
+        options.mode = ShadingMode::Adaptive;
+        options.adaptive_tolerance = 0.02;
+        options.adaptive_max_depth = 3;
+        return options;
+    }
+
+}
+
+int main() {
+    try {
+        const auto dir = std::filesystem::temp_directory_path() / "berricake_test_adaptive";
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        std::filesystem::current_path(dir);
+
+        // 1. 孤立的长方体：没有任何遮挡，不应细分
+        {
+            std::ofstream stl("isolated.stl");
+            write_box(stl, "", Point3D(0, 0, 0), Point3D(10, 10, 10));
+        }
+        SurfaceGroup isolated("isolated", "isolated.stl", {"roof", "south", "east"}, nullptr, adaptive_options());
+        const auto& tree = isolated.getQuadTree();
+        check(!tree.empty(), "孤立长方体: 未建立自适应四叉树");
+        check(tree.maxDepth() == 0, "孤立长方体: 无遮挡表面被细分到第 " + std::to_string(tree.maxDepth()) + " 层");
+        check(tree.leafCount() == tree.nodes().size(), "孤立长方体: 存在非叶子节点");
+        // 无遮挡时的值即受照余弦（细分只影响插值，根层节点上应精确）
+        check(std::abs(isolated.get_shadow_value(45, 0, "roof") - std::sin(M_PI / 4)) < 1e-9, "孤立长方体: 屋顶受照余弦");
+        check(std::abs(isolated.get_shadow_value(15, 180, "south") - std::cos(M_PI / 12)) < 1e-9, "孤立长方体: 南墙受照余弦");
+
+        // 2. 南侧有高楼遮挡：南墙的阴影边缘处应细分
+        {
+            std::ofstream stl("shaded.stl");
+            write_box(stl, "", Point3D(0, 0, 0), Point3D(10, 10, 10));
+            write_box(stl, "tower_", Point3D(0, -20, 0), Point3D(10, -15, 30));
+        }
+        SurfaceGroup shaded("shaded", "shaded.stl", {"south"}, nullptr, adaptive_options());
+        check(shaded.getQuadTree().maxDepth() > 0, "有遮挡: 南墙未细分");
+
+        std::filesystem::current_path(dir.parent_path());
+        std::filesystem::remove_all(dir);
+    } catch (const std::exception& e) {
+        std::cerr << "错误: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return test::finish("自适应细分测试通过");
+}
@@ -0,0 +1,49 @@
+//
+// Created by zhou on 25-7-21.
+//
+
+// 射线-包围盒相交（slab算法）回归测试：方向分量为0且起点恰在slab平面上时不能漏判
+// （轴对齐建筑在太阳方位角为0/90/180/270度时常见）
+
+#include <iostream>
+#include <string>
+
+#include <BVH.h>
+
+#include "check.h"
+
+using namespace geom;
+using namespace test;
+
+namespace {
+
+    bool hits(const AABB& box, const Point3D& origin, const Point3D& dir) {
+        const Point3D inv_dir(1.0 / dir.x, 1.0 / dir.y, 1.0 / dir.z);
+        return box.intersect(origin, inv_dir, std::numeric_limits<double>::infinity());
+    }
+
+}
+
+int main() {
+    AABB box;
+    box.grow(Point3D(0, 0, 0));
+    box.grow(Point3D(1, 1, 1));
+
+    // 起点在y的slab平面上（min和max两侧），方向y分量为+0/-0
+    check(hits(box, Point3D(-1, 0, 0.5), Point3D(1, 0, 0)), "起点在min平面上");
+    check(hits(box, Point3D(-1, 1, 0.5), Point3D(1, 0, 0)), "起点在max平面上");
+    check(hits(box, Point3D(-1, 1, 0.5), Point3D(1, -0.0, 0)), "起点在max平面上（方向分量为-0）");
+    check(hits(box, Point3D(2, 1, 0.5), Point3D(-1, 0, 0)), "反向射线，起点在max平面上");
+
+    // 两个方向分量为0，起点在两个slab平面的交线上
+    check(hits(box, Point3D(0, -1, 1), Point3D(0, 1, 0)), "起点在两个slab平面的交线上");
+
+    // 与slab平行且在slab之外的射线不相交
+    check(!hits(box, Point3D(-1, 1.5, 0.5), Point3D(1, 0, 0)), "平行于slab且在外侧");
+    check(!hits(box, Point3D(-1, -1e-12, 0.5), Point3D(1, 0, 0)), "平行于slab且紧贴外侧");
+
+    // 包围盒在射线后方
+    check(!hits(box, Point3D(2, 0.5, 0.5), Point3D(1, 0, 0)), "包围盒在射线后方");
+
+    return test::finish("BVH包围盒相交测试通过");
+}
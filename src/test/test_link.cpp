@@ -0,0 +1,136 @@
+//
+// Created by zhou on 25-7-21.
+//
+
+// 连接编译测试：连接到不存在的变量、类型不兼容时在初始化阶段（编译连接时）报错，
+// 整数/布尔值输出可以连接到double输入（Output组件的输入全部声明为double）并按数值同步，
+// 编译后冻结变量存储，再新建变量（会使槽位指针悬空）时报错
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <Link.h>
+#include <SystemStateHub.h>
+
+#include "check.h"
+
+using namespace core;
+using namespace test;
+
+namespace {
+
+    // 源组件：各类型的输出各一个
+    class Source : public BaseComponent {
+    public:
+        void awake() override {
+            outputs.define("power", json{{"type", "double"}, {"value", 1.5}});
+            outputs.define("count", json{{"type", "int"}, {"value", 3}});
+            outputs.define("running", json{{"type", "bool"}, {"value", true}});
+            outputs.define("label", json{{"type", "string"}, {"value", "a"}});
+        }
+
+        void set(const std::string& name, const json& value) {
+            outputs.assign(name, value);
+        }
+    };
+
+    // 目标组件：double/int/bool输入各一个
+    class Target : public BaseComponent {
+    public:
+        void awake() override {
+            inputs.define("x", json{{"type", "double"}, {"value", 0.0}});
+            inputs.define("y", json{{"type", "double"}, {"value", 0.0}});
+            inputs.define("z", json{{"type", "double"}, {"value", 0.0}});
+            inputs.define("n", json{{"type", "int"}, {"value", 0}});
+            inputs.define("flag", json{{"type", "bool"}, {"value", false}});
+        }
+
+        [[nodiscard]] double number(const std::string& name) const {
+            return inputs.number(inputs.ref(name));
+        }
+    };
+
+    // 编译一条连接，返回是否报错
+    bool add_fails(LinkPlan& plan, const std::string& src_var, const std::string& trg_var) {
+        try {
+            plan.add(Link("source", src_var, "target", trg_var));
+        } catch (const std::runtime_error& e) {
+            std::cout << "预期的错误: " << e.what() << std::endl;
+            return true;
+        }
+        return false;
+    }
+
+}
+
+int main() {
+    auto& hub = SystemStateHub::getInstance();
+    const auto source = std::make_shared<Source>();
+    const auto target = std::make_shared<Target>();
+    hub.registerComponent("source", source);
+    hub.registerComponent("target", target);
+    source->awake();
+    target->awake();
+
+    // 1. 初始化阶段报错：变量不存在、类型不兼容、字符串变量
+    {
+        LinkPlan plan;
+        check(add_fails(plan, "missing", "x"), "源变量不存在时应报错");
+        check(add_fails(plan, "power", "missing"), "目标变量不存在时应报错");
+        check(add_fails(plan, "power", "n"), "double连接到int输入应报错（不做截断）");
+        check(add_fails(plan, "count", "flag"), "int连接到bool输入应报错");
+        check(add_fails(plan, "label", "x"), "字符串变量连接应报错");
+        check(plan.size() == 0, "报错的连接不应加入");
+    }
+
+    // 2. 类型一致的连接与整数/布尔值到double的转换
+    {
+        LinkPlan plan;
+        check(!add_fails(plan, "power", "x"), "double连接到double输入");
+        check(!add_fails(plan, "count", "y"), "int连接到double输入");
+        check(!add_fails(plan, "running", "z"), "bool连接到double输入");
+        check(!add_fails(plan, "count", "n"), "int连接到int输入");
+        check(!add_fails(plan, "running", "flag"), "bool连接到bool输入");
+        check(plan.size() == 5, "连接数应为5");
+
+        plan.run();
+        check(target->number("x") == 1.5, "同步double值");
+        check(target->number("y") == 3.0, "int转换为double");
+        check(target->number("z") == 1.0, "bool转换为double");
+        check(target->number("n") == 3.0, "同步int值");
+        check(target->number("flag") == 1.0, "同步bool值");
+
+        source->set("count", -7);
+        source->set("running", false);
+        plan.run();
+        check(target->number("y") == -7.0, "再次同步: int转换为double");
+        check(target->number("z") == 0.0, "再次同步: bool转换为double");
+    }
+
+    // 3. 编译后冻结变量存储：新建变量、改变变量类型时报错，已有变量照常赋值，已编译的连接仍然有效
+    {
+        LinkPlan plan;
+        plan.add(Link("source", "power", "target", "x"));
+        source->freeze_vars();
+        target->freeze_vars();
+
+        check(throws([&] { target->setInputVal("extra", 1.0); }), "冻结后新建输入变量应报错");
+        check(throws([&] { target->getInputs().define("x", json{{"type", "int"}, {"value", 1}}); }),
+              "冻结后改变输入变量类型应报错");
+        check(throws([&] { source->addOutput("extra", json{{"type", "double"}, {"value", 0.0}}); }),
+              "冻结后新建输出变量应报错");
+        check(!target->getInputs().contains("extra"), "报错的变量不应加入");
+        check(!throws([&] { target->setInputVal("y", json{{"type", "double"}, {"value", 2.0}}); }),
+              "冻结后给已有变量赋值不应报错");
+
+        source->set("power", 4.25);
+        plan.run();
+        check(target->number("x") == 4.25, "冻结后连接照常同步");
+    }
+
+    hub.unregisterComponent("source");
+    hub.unregisterComponent("target");
+
+    return test::finish("连接编译测试通过");
+}
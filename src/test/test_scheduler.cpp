@@ -0,0 +1,206 @@
+//
+// Created by zhou on 25-7-21.
+//
+
+// 调度测试：连接构成的依赖图按强连通分量划分为执行块，按依赖层排列；
+// 环内按Gauss-Seidel顺序计算（上游组件计算后立即同步，下游组件在同一次迭代中用到新值），
+// 环和非线程安全的组件不进入并行执行；并行计算的组件在update中再次使用进程共用的线程池（嵌套并行）不会死锁
+
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <SimManager.h>
+#include <SystemStateHub.h>
+
+#include "check.h"
+
+using namespace core;
+using namespace test;
+
+namespace {
+
+    // 计算记录：组件名及计算时读到的输入
+    struct Record {
+        std::string name;
+        double x1;
+        double x2;
+    };
+
+    std::mutex log_mutex;
+    std::vector<Record> update_log;
+
+    // 桩组件：y = bias + x1 + gain * x2
+    // nested为真时在update中用进程共用的线程池并行求和（模拟组件内的遮挡计算）
+    class Stub : public BaseComponent {
+    public:
+        Stub(double bias, double gain, bool thread_safe, bool nested = false)
+            : bias_(bias), gain_(gain), thread_safe_(thread_safe), nested_(nested) {}
+
+        void awake() override {
+            inputs.define("x1", json{{"type", "double"}, {"value", 0.0}});
+            inputs.define("x2", json{{"type", "double"}, {"value", 0.0}});
+            outputs.define("y", json{{"type", "double"}, {"isInstValue", true}, {"value", 0.0}});
+            x1_ = inputs.handle<double>("x1");
+            x2_ = inputs.handle<double>("x2");
+            y_ = outputs.handle<double>("y");
+        }
+
+        void update(const SimTime& time) override {
+            const double x1 = inputs.get(x1_);
+            const double x2 = inputs.get(x2_);
+            outputs.set(y_, bias_ + x1 + gain_ * x2);
+            if (nested_) {
+                std::atomic<long long> sum{0};
+                SystemStateHub::getInstance().getThreadPool()->parallel_for(100, [&sum](size_t i) {
+                    sum += static_cast<long long>(i);
+                });
+                nested_sum_ = sum.load();
+            }
+            std::lock_guard<std::mutex> lock(log_mutex);
+            update_log.push_back({name, x1, x2});
+        }
+
+        [[nodiscard]] bool is_thread_safe() const override { return thread_safe_; }
+
+        [[nodiscard]] double y() const { return outputs.get(y_); }
+        [[nodiscard]] long long nested_sum() const { return nested_sum_; }
+
+    private:
+        double bias_;
+        double gain_;
+        bool thread_safe_;
+        bool nested_;
+        long long nested_sum_ = 0;
+        DoubleVar x1_, x2_, y_;
+    };
+
+    const SimManager::BlockInfo* find_block(const std::vector<SimManager::BlockInfo>& blocks, const std::string& name) {
+        for (const auto& block : blocks) {
+            for (const auto& component : block.components) {
+                if (component == name) return &block;
+            }
+        }
+        return nullptr;
+    }
+
+}
+
+int main() {
+    // 依赖图：a → [b ⇄ c] → d；e → f；g 独立
+    // 除g外均声明线程安全（环上的b、c也声明线程安全，但环只能在块内依次迭代）；a、e在update中嵌套并行
+    auto& hub = SystemStateHub::getInstance();
+    hub.setNumThreads(2);
+    std::map<std::string, std::shared_ptr<Stub>> stubs = {
+        {"a", std::make_shared<Stub>(1.0, 0.0, true, true)},
+        {"b", std::make_shared<Stub>(0.0, 0.5, true)},
+        {"c", std::make_shared<Stub>(0.0, 0.0, true)},
+        {"d", std::make_shared<Stub>(0.0, 0.0, true)},
+        {"e", std::make_shared<Stub>(2.0, 0.0, true, true)},
+        {"f", std::make_shared<Stub>(0.0, 0.0, true)},
+        {"g", std::make_shared<Stub>(3.0, 0.0, false)},
+    };
+    for (const auto& [name, stub] : stubs) {
+        stub->setName(name);
+        hub.registerComponent(name, stub);
+    }
+    hub.createLink("a", "y", "b", "x1");
+    hub.createLink("b", "y", "c", "x1");
+    hub.createLink("c", "y", "b", "x2");
+    hub.createLink("c", "y", "d", "x1");
+    hub.createLink("e", "y", "f", "x1");
+
+    SimManager manager;
+    manager.prepare();
+    const auto blocks = manager.schedule();
+
+    // 1. 强连通分量与依赖层
+    check(blocks.size() == 6, "执行块数应为6，实际为" + std::to_string(blocks.size()));
+    const auto* loop = find_block(blocks, "b");
+    check(loop && loop->loop && loop->components == std::vector<std::string>{"b", "c"}, "b、c应构成一个环，块内按名字排序");
+    for (const std::string name : {"a", "d", "e", "f", "g"}) {
+        const auto* block = find_block(blocks, name);
+        check(block && !block->loop && block->components.size() == 1, name + "应单独成块且不在环上");
+    }
+    const std::map<std::string, int> expected_levels = {{"a", 0}, {"b", 1}, {"d", 2}, {"e", 0}, {"f", 1}, {"g", 0}};
+    for (const auto& [name, level] : expected_levels) {
+        const auto* block = find_block(blocks, name);
+        check(block && block->level == level, name + "的依赖层应为" + std::to_string(level));
+    }
+    for (size_t i = 1; i < blocks.size(); ++i) {
+        check(blocks[i - 1].level <= blocks[i].level, "执行块应按依赖层排列");
+    }
+
+    // 2. 环和非线程安全的组件不并行，其余线程安全的组件并行
+    check(loop && !loop->parallel, "环不应并行执行");
+    check(find_block(blocks, "g") && !find_block(blocks, "g")->parallel, "非线程安全的组件不应并行执行");
+    for (const std::string name : {"a", "d", "e", "f"}) {
+        check(find_block(blocks, name) && find_block(blocks, name)->parallel, name + "应并行执行");
+    }
+
+    // 3. 运行一步：环收敛到 b = 1 + 0.5c, c = b 的解 b = c = 2
+    SimTime time(0, 10, 1);
+    check(manager.run_a_step(time), "时间步应收敛");
+    check(std::abs(stubs["b"]->y() - 2.0) < 0.01 && std::abs(stubs["c"]->y() - 2.0) < 0.01, "环应收敛到b=c=2");
+    check(std::abs(stubs["d"]->y() - stubs["c"]->y()) < 1e-12, "d应使用环收敛后的值");
+    check(stubs["f"]->y() == 2.0, "f应使用e本步的输出");
+    check(stubs["a"]->nested_sum() == 4950 && stubs["e"]->nested_sum() == 4950, "并行组件中的嵌套并行应完成");
+
+    // 环外组件每步只计算一次，且在下游之前
+    auto count_of = [](const std::string& name) {
+        size_t count = 0;
+        for (const auto& record : update_log) count += record.name == name ? 1 : 0;
+        return count;
+    };
+    auto first_of = [](const std::string& name) {
+        for (size_t i = 0; i < update_log.size(); ++i) {
+            if (update_log[i].name == name) return i;
+        }
+        return update_log.size();
+    };
+    auto last_of = [](const std::string& name) {
+        size_t last = update_log.size();
+        for (size_t i = 0; i < update_log.size(); ++i) {
+            if (update_log[i].name == name) last = i;
+        }
+        return last;
+    };
+    for (const std::string name : {"a", "d", "e", "f", "g"}) {
+        check(count_of(name) == 1, name + "每步应只计算一次");
+    }
+    check(first_of("a") < first_of("b"), "a应在环之前计算");
+    check(last_of("c") < first_of("d"), "d应在环收敛之后计算");
+    check(first_of("e") < first_of("f"), "e应在f之前计算");
+
+    // Gauss-Seidel：环内b、c交替计算，b每次读到的c是本次迭代之前c的最新输出
+    std::vector<Record> loop_log;
+    for (const auto& record : update_log) {
+        if (record.name == "b" || record.name == "c") loop_log.push_back(record);
+    }
+    check(loop_log.size() >= 4 && loop_log.size() % 2 == 0, "环应迭代多次");
+    double c_output = 0.0;  // c的上一次输出（初始为0）
+    double b_output = 0.0;
+    for (size_t i = 0; i < loop_log.size(); ++i) {
+        const bool expect_b = i % 2 == 0;
+        check(loop_log[i].name == (expect_b ? "b" : "c"), "环内应按b、c的顺序交替计算");
+        if (expect_b) {
+            check(loop_log[i].x2 == c_output, "b应读到c在上一次迭代中的输出");
+            b_output = 1.0 + 0.5 * c_output;
+        } else {
+            check(loop_log[i].x1 == b_output, "c应读到b在同一次迭代中的新输出");
+            c_output = b_output;
+        }
+    }
+    check(std::abs(c_output - stubs["c"]->y()) < 1e-12, "按Gauss-Seidel顺序重算的结果应与实际输出一致");
+
+    for (const auto& [name, stub] : stubs) {
+        hub.unregisterComponent(name);
+    }
+
+    return test::finish("调度测试通过");
+}
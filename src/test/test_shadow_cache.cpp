@@ -0,0 +1,197 @@
+//
+// Created by zhou on 25-7-21.
+//
+
+// 遮挡表缓存测试：写入后读回的表格一致；几何、角度网格、遮挡判定引擎或精度变化时缓存键改变、缓存失效；
+// 截断或损坏的缓存文件被拒绝而不是读入
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <ShadowCache.h>
+#include <SurfaceGroup.h>
+
+#include "check.h"
+
+using namespace geom;
+using namespace test;
+
+namespace {
+
+    std::vector<char> read_bytes(const std::filesystem::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    }
+
+    void write_bytes(const std::filesystem::path& path, const std::vector<char>& bytes) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    uint64_t key_of(const ShadingOptions& options, uint64_t stl_hash = 1,
+                    const std::vector<std::string>& surfaces = {"wall", "roof"}) {
+        return SurfaceGroup::cacheKey(stl_hash, surfaces, options).digest();
+    }
+
+}
+
+int main() {
+    const auto dir = std::filesystem::temp_directory_path() / "berricake_test_shadow_cache";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    const std::string path = (dir / "group_shd.bin").string();
+
+    // 两个表面，高度角0°~90°步长15°，方位角整圆步长30°；部分节点已计算（按需模式）
+    ShadowTable table;
+    table.reset({"wall", "roof"}, AngleGrid::from_range(0, 90, 15), AngleGrid::from_range(0, 360, 30));
+    for (int s = 0; s < 2; ++s) {
+        for (int a = 0; a < table.altitudeGrid().count; ++a) {
+            for (int z = 0; z < table.azimuthGrid().count; z += 2) {
+                table.set(s, a, z, 0.001 * (s * 1000 + a * 100 + z));
+            }
+        }
+    }
+    table.setViewFactors({0.5, 0.9}, {0.5, 0.1});
+    const uint64_t key = key_of(ShadingOptions());
+
+    // 1. 写入后读回
+    {
+        write_shadow_cache(path, key, table);
+        check(!std::filesystem::exists(path + ".tmp"), "写入完成后不应留下临时文件");
+
+        ShadowTable loaded;
+        check(read_shadow_cache(path, key, loaded), "应能读回刚写入的缓存");
+        check(loaded.surfaceNames() == table.surfaceNames(), "表面名一致");
+        check(loaded.altitudeGrid().count == 7 && loaded.azimuthGrid().count == 12, "网格大小一致");
+        check(loaded.wraps(), "读回的方位角网格仍然回绕");
+        check(loaded.values() == table.values(), "网格值一致");
+        check(loaded.knownMask() == table.knownMask(), "已计算标记一致");
+        check(loaded.knownCount() == table.knownCount() && !loaded.complete(), "部分计算的表格读回后仍是部分计算");
+        check(loaded.skyViewFactors() == table.skyViewFactors() &&
+              loaded.groundViewFactors() == table.groundViewFactors(), "视角系数一致");
+        check(loaded.lookup(1, 37.5, 45) == table.lookup(1, 37.5, 45), "读回的表格插值结果一致");
+    }
+
+    // 2. 缓存键：影响计算结果的参数变化时键改变，读取时缓存失效
+    {
+        ShadingOptions sunpath;
+        sunpath.mode = ShadingMode::SunPath;
+        ShadingOptions finer = sunpath;
+        finer.sky_altitude_step = 1.0;
+        ShadingOptions finer_azimuth = sunpath;
+        finer_azimuth.sky_azimuth_step = 1.0;
+        ShadingOptions raster;
+        raster.occlusion_method = OcclusionMethod::Raster;
+        ShadingOptions raster_fine = raster;
+        raster_fine.raster_resolution = 2048;
+        ShadingOptions single;
+        single.precision = PrecisionMode::Float;
+        ShadingOptions adaptive;
+        adaptive.mode = ShadingMode::Adaptive;
+        ShadingOptions adaptive_fine = adaptive;
+        adaptive_fine.adaptive_tolerance = 0.01;
+        ShadingOptions progressive;
+        progressive.sample_mode = SampleMode::Progressive;
+
+        const std::vector<std::pair<std::string, uint64_t>> changed = {
+            {"SunPath网格", key_of(sunpath)},
+            {"SunPath高度角步长", key_of(finer)},
+            {"SunPath方位角步长", key_of(finer_azimuth)},
+            {"光栅化引擎", key_of(raster)},
+            {"光栅化分辨率", key_of(raster_fine)},
+            {"单精度求交", key_of(single)},
+            {"自适应细分", key_of(adaptive)},
+            {"自适应细分容差", key_of(adaptive_fine)},
+            {"渐进采样", key_of(progressive)},
+            {"几何内容", key_of(ShadingOptions(), 2)},
+            {"分析表面", key_of(ShadingOptions(), 1, {"wall"})},
+            {"表面顺序", key_of(ShadingOptions(), 1, {"roof", "wall"})},
+        };
+        for (size_t i = 0; i < changed.size(); ++i) {
+            check(changed[i].second != key, changed[i].first + "变化时缓存键应改变");
+            for (size_t j = 0; j < i; ++j) {
+                check(changed[i].second != changed[j].second, changed[i].first + "与" + changed[j].first + "的缓存键应不同");
+            }
+        }
+        ShadowTable loaded;
+        check(!read_shadow_cache(path, key_of(sunpath), loaded), "网格变化后不应读入旧缓存");
+        check(!read_shadow_cache(path, key_of(raster), loaded), "遮挡判定引擎变化后不应读入旧缓存");
+        check(!read_shadow_cache(path, key_of(single), loaded), "求交精度变化后不应读入旧缓存");
+
+        // 不影响结果的参数不改变键
+        ShadingOptions raycast_resolution;
+        raycast_resolution.raster_resolution = 2048;
+        check(key_of(raycast_resolution) == key, "射线投射时光栅化分辨率不应影响缓存键");
+        ShadingOptions validate;
+        validate.precision = PrecisionMode::Validate;
+        check(key_of(validate) == key, "校验模式以双精度结果为准，缓存键与双精度相同");
+        ShadingOptions stream;
+        stream.sample_mode = SampleMode::Stream;
+        check(key_of(stream) == key, "流式采样与细分网格结果相同，缓存键相同");
+        ShadingOptions raster_single = raster;
+        raster_single.precision = PrecisionMode::Float;
+        check(key_of(raster_single) == key_of(raster), "光栅化引擎不区分求交精度");
+    }
+
+    // 3. 截断的文件：任何长度的截断都被拒绝
+    const auto bytes = read_bytes(path);
+    {
+        const auto truncated = (dir / "truncated_shd.bin").string();
+        for (const size_t size : {size_t{0}, size_t{16}, sizeof(ShadowCacheHeader) - 1, sizeof(ShadowCacheHeader),
+                                  sizeof(ShadowCacheHeader) + 5, bytes.size() / 2, bytes.size() - 1}) {
+            write_bytes(truncated, std::vector<char>(bytes.begin(), bytes.begin() + static_cast<std::ptrdiff_t>(size)));
+            ShadowTable loaded;
+            check(!read_shadow_cache(truncated, key, loaded), "截断到" + std::to_string(size) + "字节的缓存应被拒绝");
+        }
+        ShadowTable loaded;
+        check(!read_shadow_cache((dir / "missing_shd.bin").string(), key, loaded), "不存在的缓存文件返回false");
+    }
+
+    // 4. 损坏的文件：头部与内容中任一字节改变都被拒绝
+    {
+        const auto corrupt = (dir / "corrupt_shd.bin").string();
+        auto flip = [&](size_t offset, const std::string& what) {
+            auto damaged = bytes;
+            damaged[offset] = static_cast<char>(damaged[offset] ^ 0x5a);
+            write_bytes(corrupt, damaged);
+            ShadowTable loaded;
+            check(!read_shadow_cache(corrupt, key, loaded), what + "损坏的缓存应被拒绝");
+        };
+        ShadowCacheHeader header{};
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        flip(0, "标识");
+        flip(offsetof(ShadowCacheHeader, version), "版本号");
+        flip(offsetof(ShadowCacheHeader, alt_count) + 3, "高度角网格大小");
+        flip(offsetof(ShadowCacheHeader, azi_step), "方位角步长");
+        flip(offsetof(ShadowCacheHeader, values_offset), "网格值偏移");
+        flip(sizeof(ShadowCacheHeader) + 4, "表面名");
+        flip(header.values_offset + 8 * 5, "网格值");
+        flip(header.known_offset + 1, "已计算标记");
+        flip(header.view_offset + 8, "视角系数");
+        flip(bytes.size() - 1, "最后一个字节");
+
+        // 校验和相符但网格大小与数组长度不一致（如写入程序有误）：不按头部的网格大小分配内存
+        auto forged = bytes;
+        ShadowCacheHeader bad = header;
+        bad.alt_count = 1 << 30;
+        bad.checksum = shadow_cache_checksum(bad, bytes.data() + sizeof(bad), bytes.size() - sizeof(bad));
+        std::memcpy(forged.data(), &bad, sizeof(bad));
+        write_bytes(corrupt, forged);
+        ShadowTable forged_table;
+        check(!read_shadow_cache(corrupt, key, forged_table), "网格大小与数组长度不一致的缓存应被拒绝");
+
+        // 未损坏的副本仍可读取
+        write_bytes(corrupt, bytes);
+        ShadowTable loaded;
+        check(read_shadow_cache(corrupt, key, loaded) && loaded.values() == table.values(), "原样复制的缓存应可读取");
+    }
+
+    std::filesystem::remove_all(dir);
+    return test::finish("遮挡表缓存测试通过");
+}
@@ -0,0 +1,105 @@
+//
+// Created by zhou on 25-7-21.
+//
+
+// 稠密遮挡表测试：方位角整圆时按360°回绕（0°/360°重合的一列只保留一份），
+// 高度角与非整圆的方位角在边界处截断，查询值与手算的双线性插值一致
+
+#include <cmath>
+#include <iostream>
+#include <string>
+
+#include <ShadowTable.h>
+
+#include "check.h"
+
+using namespace geom;
+using namespace test;
+
+namespace {
+
+    // 节点值：表面0为 高度角下标 + 方位角下标/100，表面1再加100
+    double node_value(int surface, int a, int z) {
+        return surface * 100.0 + a + z / 100.0;
+    }
+
+    void fill(ShadowTable& table, int azimuth_columns) {
+        for (int s = 0; s < 2; ++s) {
+            for (int a = 0; a < table.altitudeGrid().count; ++a) {
+                for (int z = 0; z < azimuth_columns; ++z) {
+                    table.set(s, a, z, node_value(s, a, z));
+                }
+            }
+        }
+    }
+
+    bool near(double a, double b) {
+        return std::fabs(a - b) < 1e-12;
+    }
+
+}
+
+int main() {
+    // 1. 整圆方位角网格：0°~360°步长10°，360°一列与0°重合
+    {
+        ShadowTable table;
+        table.reset({"s0", "s1"}, AngleGrid::from_range(0, 90, 10), AngleGrid::from_range(0, 360, 10));
+        check(table.wraps(), "0°~360°的方位角网格应回绕");
+        check(table.azimuthGrid().count == 36, "360°一列应并入0°，方位角列数应为36");
+        check(table.altitudeGrid().count == 10, "高度角行数应为10");
+
+        fill(table, 36);
+        check(table.complete(), "全部节点写入后应完整");
+        table.set(0, 3, 36, -1.0);  // 360°列：并入0°，保留先写入的0°值
+        check(near(table.at(0, 3, 0), node_value(0, 3, 0)), "写入360°列不应覆盖0°列");
+
+        // 359.5°, 15°：方位角在350°(下标35)与0°(下标0)之间，fz=0.95；高度角在10°与20°之间，fa=0.5
+        const double expected = 0.5 * 0.05 * 1.35 + 0.5 * 0.05 * 2.35 + 0.5 * 0.95 * 1.0 + 0.5 * 0.95 * 2.0;
+        check(near(expected, 1.5175), "手算值");
+        check(near(table.lookup(0, 15, 359.5), 1.5175), "359.5°应在350°与0°之间插值");
+        check(near(table.lookup(0, 15, -0.5), 1.5175), "-0.5°应回绕到359.5°");
+        check(near(table.lookup(0, 15, 719.5), 1.5175), "719.5°应回绕到359.5°");
+        check(near(table.lookup(1, 15, 359.5), 101.5175), "第二个表面按各自的网格插值");
+        check(near(table.lookup(0, 20, 360.0), node_value(0, 2, 0)), "360°应等于0°的节点值");
+
+        const auto c = table.cell(15, 359.5);
+        check(c.z0 == 35 && c.z1 == 0 && near(c.fz, 0.95), "359.5°所在单元应为(35, 0)");
+
+        // 高度角截断：低于下界取第0行，高于上界取最后一行，恰在上界时不越界
+        check(near(table.lookup(0, -5, 20), node_value(0, 0, 2)), "高度角低于下界应截断到第0行");
+        check(near(table.lookup(0, 95, 20), node_value(0, 9, 2)), "高度角高于上界应截断到最后一行");
+        check(near(table.lookup(0, 90, 25), 9.025), "高度角恰在上界时只在方位角方向插值");
+        check(near(table.lookup(0, 0, 5), 0.005), "高度角恰在下界时只在方位角方向插值");
+
+        check(throws([&] { (void)table.lookup(2, 15, 0); }), "无效的表面ID应报错");
+    }
+
+    // 2. 不含360°端点但恰好覆盖整圆的网格（0°~350°）同样回绕，列数不变
+    {
+        ShadowTable table;
+        table.reset({"s0", "s1"}, AngleGrid::from_range(0, 90, 10), AngleGrid::from_range(0, 350, 10));
+        check(table.wraps() && table.azimuthGrid().count == 36, "0°~350°步长10°的网格应回绕且保留36列");
+        fill(table, 36);
+        check(near(table.lookup(0, 15, 359.5), 1.5175), "0°~350°网格在359.5°处同样跨0°插值");
+    }
+
+    // 3. 扇区网格：方位角90°~270°步长30°，高度角10°~50°步长20°，不回绕，边界处截断
+    {
+        ShadowTable table;
+        table.reset({"s0", "s1"}, AngleGrid::from_range(10, 50, 20), AngleGrid::from_range(90, 270, 30));
+        check(!table.wraps(), "扇区网格不应回绕");
+        check(table.azimuthGrid().count == 7 && table.altitudeGrid().count == 3, "扇区网格为3行7列");
+        fill(table, 7);
+
+        // 100°, 20°：fz=1/3，fa=0.5
+        const double expected = 0.5 * (2.0 / 3.0) * 0.0 + 0.5 * (2.0 / 3.0) * 1.0 +
+                                0.5 * (1.0 / 3.0) * 0.01 + 0.5 * (1.0 / 3.0) * 1.01;
+        check(near(table.lookup(0, 20, 100), expected), "扇区内部的双线性插值");
+        check(near(table.lookup(0, 30, 80), node_value(0, 1, 0)), "方位角低于扇区下界应截断到第0列");
+        check(near(table.lookup(0, 30, 280), node_value(0, 1, 6)), "方位角高于扇区上界应截断到最后一列");
+        check(near(table.lookup(0, 30, 0), node_value(0, 1, 0)), "扇区网格的0°不应回绕到270°");
+        check(near(table.lookup(0, 60, 300), node_value(0, 2, 6)), "两个方向同时截断到角点");
+    }
+
+    return test::finish("遮挡表插值测试通过");
+}
@@ -0,0 +1,133 @@
+//
+// Created by zhou on 25-7-21.
+//
+
+// 向量化求交核与标量实现的一致性测试：逐个强制使用各指令集（set_isa），
+// 在随机三角形上比较first_hit/any_hit与标量参考实现的结果（含不足一个向量宽度的尾部）
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <OccluderBuffer.h>
+#include <SimdKernel.h>
+
+#include "check.h"
+
+using namespace geom;
+using namespace test;
+
+namespace {
+
+    // 随机三角形：分布在10m见方的区域内，边长0.5~3m，表面ID取0~4
+    std::vector<Triangle> random_triangles(std::mt19937& rng, size_t n) {
+        std::uniform_real_distribution<double> pos(0.0, 10.0);
+        std::uniform_real_distribution<double> edge(-1.5, 1.5);
+        std::uniform_int_distribution<int> id(0, 4);
+        std::vector<Triangle> triangles(n);
+        for (auto& tri : triangles) {
+            const Point3D p(pos(rng), pos(rng), pos(rng));
+            tri.vertices[0] = p;
+            tri.vertices[1] = p + Point3D(edge(rng), edge(rng), edge(rng));
+            tri.vertices[2] = p + Point3D(edge(rng), edge(rng), edge(rng));
+            tri.id = id(rng);
+        }
+        return triangles;
+    }
+
+    struct Ray {
+        Point3D origin;
+        Point3D dir;
+        int skip_id;
+    };
+
+    // 随机射线：一半指向某个三角形内部的点（保证有足够多的命中），一半为随机方向
+    std::vector<Ray> random_rays(std::mt19937& rng, const std::vector<Triangle>& triangles, size_t n) {
+        std::uniform_real_distribution<double> pos(-2.0, 12.0);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        std::uniform_int_distribution<size_t> pick(0, triangles.size() - 1);
+        std::uniform_int_distribution<int> id(-1, 4);
+        std::vector<Ray> rays(n);
+        for (size_t k = 0; k < n; ++k) {
+            Ray& ray = rays[k];
+            ray.origin = Point3D(pos(rng), pos(rng), pos(rng));
+            if (k % 2 == 0) {
+                const Triangle& tri = triangles[pick(rng)];
+                double a = unit(rng), b = unit(rng);
+                if (a + b > 1.0) { a = 1.0 - a; b = 1.0 - b; }
+                const Point3D target = tri.vertices[0] + (tri.vertices[1] - tri.vertices[0]) * a
+                                     + (tri.vertices[2] - tri.vertices[0]) * b;
+                ray.dir = target - ray.origin;
+            } else {
+                ray.dir = Point3D(unit(rng) - 0.5, unit(rng) - 0.5, unit(rng) - 0.5);
+            }
+            ray.skip_id = id(rng);
+        }
+        return rays;
+    }
+
+    // 求交范围：从不同起点开始，长度覆盖0、不足一个向量、整向量及到缓冲区末尾（读取填充部分）
+    std::vector<std::pair<uint32_t, uint32_t>> test_ranges(uint32_t n) {
+        std::vector<std::pair<uint32_t, uint32_t>> ranges;
+        for (const uint32_t first : {0u, 1u, 3u, 7u, 16u}) {
+            for (const uint32_t count : {0u, 1u, 2u, 3u, 4u, 5u, 7u, 8u, 9u, 15u, 16u, 17u, 31u, 33u}) {
+                if (first + count <= n) ranges.emplace_back(first, count);
+            }
+            ranges.emplace_back(first, n - first);
+        }
+        return ranges;
+    }
+
+}
+
+int main() {
+    std::mt19937 rng(20250721);
+    const auto triangles = random_triangles(rng, 45);  // 45不是向量宽度的整数倍，末尾有不足一个向量的尾部
+    const auto rays = random_rays(rng, triangles, 1500);
+    const auto n = static_cast<uint32_t>(triangles.size());
+
+    OccluderBuffer occluders;
+    occluders.build(triangles);
+    OccluderBufferF occluders_f;
+    occluders_f.convert(occluders);
+
+    const simd::Isa detected = simd::detect_isa();
+    size_t hits = 0;
+    for (const simd::Isa isa : {simd::Isa::Scalar, simd::Isa::SSE2, simd::Isa::AVX2, simd::Isa::AVX512}) {
+        simd::set_isa(isa);
+        if (simd::active_isa() != isa) {
+            std::cout << simd::isa_name(isa) << ": CPU不支持，跳过" << std::endl;
+            continue;
+        }
+
+        for (const auto& [first, count] : test_ranges(n)) {
+            for (size_t k = 0; k < rays.size(); ++k) {
+                const Ray& ray = rays[k];
+                const std::string where = std::string(simd::isa_name(isa)) + " 范围[" + std::to_string(first) + ", +"
+                                        + std::to_string(count) + ") 射线" + std::to_string(k);
+
+                const int64_t expected = simd::first_hit_scalar(occluders, first, count, ray.origin, ray.dir, ray.skip_id);
+                const int64_t actual = simd::first_hit(occluders, first, count, ray.origin, ray.dir, ray.skip_id);
+                check(actual == expected, where + " 双精度first_hit: " + std::to_string(actual) + " != " + std::to_string(expected));
+                check(simd::any_hit(occluders, first, count, ray.origin, ray.dir, ray.skip_id) ==
+                      simd::any_hit_scalar(occluders, first, count, ray.origin, ray.dir, ray.skip_id),
+                      where + " 双精度any_hit");
+                hits += expected >= 0;
+
+                const Point3F origin_f = occluders_f.local_point(ray.origin);
+                const Point3F dir_f = OccluderBufferF::local_dir(ray.dir);
+                const int64_t expected_f = simd::first_hit_scalar(occluders_f, first, count, origin_f, dir_f, ray.skip_id);
+                const int64_t actual_f = simd::first_hit(occluders_f, first, count, origin_f, dir_f, ray.skip_id);
+                check(actual_f == expected_f, where + " 单精度first_hit: " + std::to_string(actual_f) + " != " + std::to_string(expected_f));
+            }
+        }
+        std::cout << simd::isa_name(isa) << ": 通过" << std::endl;
+    }
+    simd::set_isa(detected);
+
+    // 命中太少说明测试数据没有覆盖到求交分支
+    check(hits > 1000, "命中次数过少: " + std::to_string(hits));
+
+    return test::finish("SIMD求交核一致性测试通过");
+}
@@ -0,0 +1,160 @@
+//
+// Created by zhou on 25-7-21.
+//
+
+// STL解析测试：ASCII格式的科学计数法与前导+号、无名solid取文件名、CRLF换行；
+// 二进制格式（80字节文件头+三角形数+每个三角形50字节）的读取；
+// 格式识别：文件头以"solid"开头但长度符合二进制格式的文件按二进制读取
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <Triangle.h>
+
+#include "check.h"
+
+using namespace geom;
+using namespace test;
+
+namespace {
+
+    bool same(const Point3D& p, double x, double y, double z) {
+        return p.x == x && p.y == y && p.z == z;
+    }
+
+    StlModel parse_ascii(const std::string& text, const std::string& default_name = "default") {
+        return parseStlAscii(text.data(), text.data() + text.size(), default_name);
+    }
+
+    // 二进制STL：header为文件头（补齐到80字节），每个三角形为法向量与三个顶点共12个float
+    std::string make_binary(const std::string& header, const std::vector<std::vector<float>>& triangles) {
+        std::string data = header;
+        data.resize(80, ' ');
+        const auto count = static_cast<uint32_t>(triangles.size());
+        data.append(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const auto& tri : triangles) {
+            data.append(reinterpret_cast<const char*>(tri.data()), 12 * sizeof(float));
+            const uint16_t attribute = 0;
+            data.append(reinterpret_cast<const char*>(&attribute), sizeof(attribute));
+        }
+        return data;
+    }
+
+    void write_file(const std::filesystem::path& path, const std::string& data) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+
+    const std::string kAscii =
+        "solid wall\n"
+        "  facet normal 0 -1 0\n"
+        "    outer loop\n"
+        "      vertex 1.5e+02 +1.0E-3 -2.5E+1\n"
+        "      vertex 0 0 3\n"
+        "      vertex +4 0 .5\n"
+        "    endloop\n"
+        "  endfacet\n"
+        "endsolid wall\n"
+        "solid\r\n"
+        "facet normal 0 0 1\r\n"
+        "outer loop\r\n"
+        "vertex 0 0 0\r\n"
+        "vertex 1 0 0\r\n"
+        "vertex 0 1 0\r\n"
+        "endloop\r\n"
+        "endfacet\r\n"
+        "endsolid\r\n";
+
+}
+
+int main() {
+    // 1. ASCII：科学计数法、前导+号、无名solid、CRLF换行
+    {
+        const StlModel model = parse_ascii(kAscii, "block");
+        check(model.size() == 2, "应解析出2个solid");
+        check(model.contains("wall") && model.at("wall").size() == 1, "命名solid应有1个三角形");
+        check(model.contains("block") && model.at("block").size() == 1, "无名solid应使用默认名");
+        if (model.contains("wall") && !model.at("wall").empty()) {
+            const Triangle& tri = model.at("wall")[0];
+            check(same(tri.normal, 0, -1, 0), "法向量");
+            check(same(tri.vertices[0], 150.0, 1.0e-3, -25.0), "1.5e+02、+1.0E-3、-2.5E+1应正确解析");
+            check(same(tri.vertices[2], 4.0, 0.0, 0.5), "+4与.5应正确解析");
+            check(tri.id == 0, "三角形ID从0开始");
+        }
+        if (model.contains("block") && !model.at("block").empty()) {
+            const Triangle& tri = model.at("block")[0];
+            check(same(tri.vertices[1], 1, 0, 0), "CRLF换行的顶点应正确解析");
+            check(tri.id == 1, "三角形ID跨solid递增");
+        }
+
+        check(throws([] { (void)parse_ascii("solid s\nfacet normal 0 0 1\nouter loop\nvertex 1 2 x\n"); }),
+              "非数值的坐标应报错");
+        check(throws([] { (void)parse_ascii("solid s\nfacet normal 0 0 1e\n"); }), "不完整的指数应报错");
+        check(parse_ascii("facet normal 0 0 1\nouter loop\nvertex 0 0 0\nvertex 1 0 0\nvertex 0 1 0\n").empty(),
+              "solid之外的面应跳过");
+    }
+
+    // 2. 二进制：逐字段读回
+    const std::vector<std::vector<float>> triangles = {
+        {0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0},
+        {1, 0, 0, 2, 0.5f, -1.25f, 2, 3, 0, 2, 0, 4},
+    };
+    {
+        const std::string data = make_binary("exported by test", triangles);
+        check(data.size() == 84 + 2 * 50, "二进制STL长度为84+50×三角形数");
+        check(isBinaryStl(data.data(), data.size()), "应识别为二进制STL");
+
+        const StlModel model = parseStlBinary(data.data(), data.size(), "tower");
+        check(model.size() == 1 && model.contains("tower") && model.at("tower").size() == 2,
+              "二进制STL全部归入一个solid");
+        if (model.contains("tower") && model.at("tower").size() == 2) {
+            const Triangle& tri = model.at("tower")[1];
+            check(same(tri.normal, 1, 0, 0), "二进制法向量");
+            check(same(tri.vertices[0], 2, 0.5, -1.25), "二进制第1个顶点");
+            check(same(tri.vertices[1], 2, 3, 0), "二进制第2个顶点");
+            check(same(tri.vertices[2], 2, 0, 4), "二进制第3个顶点");
+            check(tri.id == 1, "二进制三角形ID");
+        }
+
+        const std::string truncated = data.substr(0, data.size() - 1);
+        check(!isBinaryStl(truncated.data(), truncated.size()), "长度不符的文件不应识别为二进制");
+        check(throws([&] { (void)parseStlBinary(truncated.data(), truncated.size(), "tower"); }),
+              "截断的二进制STL应报错");
+        check(throws([&] { (void)parseStlBinary(data.data(), 40, "tower"); }), "过短的二进制STL应报错");
+    }
+
+    // 3. 格式识别：文件头以"solid"开头的二进制文件（部分导出器如此）
+    {
+        const std::string data = make_binary("solid exported", triangles);
+        check(isBinaryStl(data.data(), data.size()), "文件头以solid开头但长度符合的文件应识别为二进制");
+        // 文件头中还出现了facet：二进制内容中的0字节说明不是文本
+        const std::string facet_header = make_binary("solid facet export", triangles);
+        check(isBinaryStl(facet_header.data(), facet_header.size()), "文件头含facet的二进制文件应识别为二进制");
+        check(!isBinaryStl(kAscii.data(), kAscii.size()), "ASCII STL不应识别为二进制");
+    }
+
+    // 4. 文件：自动识别格式，无名solid与二进制STL以文件名（不含扩展名）命名
+    {
+        const auto dir = std::filesystem::temp_directory_path() / "berricake_test_stl_parser";
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+
+        write_file(dir / "block.stl", kAscii);
+        const StlModel ascii = parseStlFile((dir / "block.stl").string());
+        check(ascii.contains("wall") && ascii.contains("block"), "ASCII文件的无名solid应以文件名命名");
+
+        write_file(dir / "tower.stl", make_binary("solid exported", triangles));
+        const StlModel binary = parseStlFile((dir / "tower.stl").string());
+        check(binary.size() == 1 && binary.contains("tower") && binary.at("tower").size() == 2,
+              "二进制文件应以文件名命名");
+
+        std::filesystem::remove_all(dir);
+    }
+
+    return test::finish("STL解析测试通过");
+}
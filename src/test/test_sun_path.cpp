@@ -0,0 +1,97 @@
+//
+// Created by zhou on 25-7-21.
+//
+
+// 按需计算（SunPath）测试：在共用线程池的任务中并发查询尚未计算的网格单元（如并行计算的多个组件共用一个分组），
+// 查询在持锁期间于同一线程池上并行计算节点，等待的线程不应进入另一个查询而重复加锁；
+// 并发查询的结果与串行查询一致
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <SurfaceGroup.h>
+#include <ThreadPool.h>
+
+#include "check.h"
+#include "stl_scene.h"
+
+using namespace geom;
+using namespace test;
+
+namespace {
+
+    ShadingOptions sun_path_options() {
+        ShadingOptions options;
+        options.mode = ShadingMode::SunPath;
+        options.sky_altitude_step = 5.0;
+        options.sky_azimuth_step = 10.0;
+        return options;
+    }
+
+}
+
+int main() {
+    try {
+        const auto dir = std::filesystem::temp_directory_path() / "berricake_test_sun_path";
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        std::filesystem::current_path(dir);
+
+        // 南侧有高楼遮挡的长方体
+        {
+            std::ofstream stl("shaded.stl");
+            write_box(stl, "", Point3D(0, 0, 0), Point3D(10, 10, 10));
+            write_box(stl, "tower_", Point3D(0, -20, 0), Point3D(10, -15, 30));
+        }
+        const std::vector<std::string> surfaces = {"south", "roof", "east"};
+        // 太阳位置：各不相同的网格单元，其中部分单元共用角点
+        const std::vector<std::pair<double, double>> suns = {
+            {12, 175}, {12, 185}, {33, 150}, {47, 200}, {63, 95}, {8, 265}, {27, 355}, {27, 5},
+        };
+
+        // 串行计算的参考值
+        SurfaceGroup serial("serial", "shaded.stl", surfaces, nullptr, sun_path_options());
+        std::vector<double> expected;
+        for (const auto& [altitude, azimuth] : suns) {
+            for (const auto& surface : surfaces) {
+                expected.push_back(serial.get_shadow_value(altitude, azimuth, surface));
+            }
+        }
+
+        // 在线程池的任务中查询未计算的单元：每个查询在持锁期间再次使用同一线程池
+        const auto pool = std::make_shared<util::ThreadPool>(4);
+        SurfaceGroup shared("shared", "shaded.stl", surfaces, pool, sun_path_options());
+        check(shared.getShadowTable().knownCount() == 0, "查询前不应有已计算的节点");
+        const size_t queries = suns.size() * surfaces.size();
+        std::vector<double> values(queries * 2);
+        pool->parallel_for(values.size(), [&](size_t i) {
+            const size_t q = i % queries;
+            const auto& [altitude, azimuth] = suns[q / surfaces.size()];
+            values[i] = shared.get_shadow_value(altitude, azimuth, surfaces[q % surfaces.size()]);
+        });
+
+        for (size_t i = 0; i < values.size(); ++i) {
+            const size_t q = i % queries;
+            check(std::abs(values[i] - expected[q]) < 1e-12,
+                  "并发查询第" + std::to_string(i) + "项与串行结果不一致: " + std::to_string(values[i]) +
+                  " / " + std::to_string(expected[q]));
+        }
+        check(shared.getShadowTable().knownCount() > 0 &&
+              shared.getShadowTable().knownCount() == serial.getShadowTable().knownCount(),
+              "并发查询计算的节点数应与串行相同");
+
+        std::filesystem::current_path(dir.parent_path());
+        std::filesystem::remove_all(dir);
+    } catch (const std::exception& e) {
+        std::cerr << "错误: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return test::finish("按需计算测试通过");
+}
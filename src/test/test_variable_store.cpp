@@ -0,0 +1,90 @@
+//
+// Created by zhou on 25-7-21.
+//
+
+// 变量存储测试：同名变量重定义（类型不变沿用槽位，类型改变换用新槽位），
+// 非瞬时值（累积量）的记录与恢复（迭代未收敛时回到本步开始时的值）
+
+#include <iostream>
+#include <string>
+
+#include <VariableStore.h>
+
+#include "check.h"
+
+using namespace core;
+using namespace test;
+
+int main() {
+    // 1. 重定义：类型不变时沿用原槽位，只更新值
+    {
+        VariableStore store;
+        const VarRef first = store.define("power", json{{"type", "double"}, {"value", 1.5}});
+        const VarRef again = store.define("power", json{{"type", "double"}, {"value", 2.5}});
+        check(first.type == again.type && first.slot == again.slot, "同类型重定义: 槽位改变");
+        check(store.size() == 1, "同类型重定义: 变量数应为1");
+        check(store.get(store.handle<double>("power")) == 2.5, "同类型重定义: 值未更新");
+    }
+
+    // 2. 重定义：类型改变时换用新类型的槽位，按旧类型解析句柄报错
+    {
+        VariableStore store;
+        store.define("count", json{{"type", "double"}, {"value", 1.5}});
+        const VarRef ref = store.define("count", json{{"type", "int"}, {"value", 3}});
+        check(ref.type == VarType::Int, "类型改变: 新类型应为int");
+        check(store.size() == 1, "类型改变: 变量数应为1");
+        check(store.get(store.handle<int>("count")) == 3, "类型改变: int值");
+        check(throws([&] { (void)store.handle<double>("count"); }), "类型改变: 按旧类型解析句柄应报错");
+        check(store.toJson("count")["type"] == "int", "类型改变: json中的类型名");
+
+        // 新定义的变量不会复用废弃的槽位
+        const VarRef other = store.define("other", json{{"type", "double"}, {"value", 7.0}});
+        check(store.get(store.handle<double>("other")) == 7.0 && store.get(store.handle<int>("count")) == 3,
+              "类型改变: 新变量与已换槽位的变量互不干扰");
+        check(other.type == VarType::Double, "类型改变: 新变量类型");
+    }
+
+    // 3. 非瞬时值的记录与恢复：只影响isInstValue为false的变量，各数值类型都按原值恢复
+    {
+        VariableStore store;
+        store.define("energy", json{{"type", "double"}, {"value", 10.0}, {"isInstValue", false}});
+        store.define("cycles", json{{"type", "int"}, {"value", 4}, {"isInstValue", false}});
+        store.define("running", json{{"type", "bool"}, {"value", true}, {"isInstValue", false}});
+        store.define("power", json{{"type", "double"}, {"value", 1.0}, {"isInstValue", true}});
+        store.define("plain", json{{"value", 5.0}});
+        const auto energy = store.handle<double>("energy");
+        const auto cycles = store.handle<int>("cycles");
+        const auto running = store.handle<bool>("running");
+        const auto power = store.handle<double>("power");
+        const auto plain = store.handle<double>("plain");
+
+        check(store.hasInst(0) && store.hasInst(1), "记录恢复: 应同时有瞬时值与非瞬时值");
+
+        // 时间步收敛后记录非瞬时值
+        store.snapshot(0);
+
+        // 一次未收敛的迭代修改了所有变量
+        store.set(energy, 12.5);
+        store.set(cycles, 5);
+        store.set(running, false);
+        store.set(power, 3.0);
+        store.set(plain, 6.0);
+
+        // 恢复非瞬时值：累积量回到记录时的值，瞬时值与未声明的变量不变
+        store.restore(0);
+        check(store.get(energy) == 10.0, "记录恢复: double累积量");
+        check(store.get(cycles) == 4, "记录恢复: int累积量");
+        check(store.get(running) == true, "记录恢复: bool累积量");
+        check(store.get(power) == 3.0, "记录恢复: 瞬时值不应恢复");
+        check(store.get(plain) == 6.0, "记录恢复: 未声明isInstValue的变量不应恢复");
+
+        // 再次记录后恢复到新的值
+        store.set(energy, 20.0);
+        store.snapshot(0);
+        store.set(energy, 25.0);
+        store.restore(0);
+        check(store.get(energy) == 20.0, "记录恢复: 再次记录后的值");
+    }
+
+    return test::finish("变量存储测试通过");
+}
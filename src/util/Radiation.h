@@ -4,7 +4,9 @@
 
 #ifndef RADIATION_H
 #define RADIATION_H
+#include <algorithm>
 #include <cmath>
+#include <tuple>
 #include <vector>
 
 namespace util {
@@ -19,7 +21,9 @@ public:
         double cosIncidence,            // 余弦角
         double solarElevationAngle,        // 高度角
         double groundReflectance = 0.2,     // 地面反射率 (0-1)
-        bool useAnisotropy = true)          // 是否考虑散射辐射各向异性
+        bool useAnisotropy = true,          // 是否考虑散射辐射各向异性
+        double skyViewFactor = -1.0,        // 天空视角系数（考虑周边遮挡，<0时按无遮挡处理）
+        double groundViewFactor = -1.0)     // 地面视角系数（<0时按无遮挡处理）
     {
         // 确保法向量是归一化的
         double norm = std::sqrt(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
@@ -33,11 +37,13 @@ public:
         // === 2. 计算天空散射辐射分量 ===
         double diffuseComponent = 0.0;
 
-        // 计算法向量与天顶方向的夹角余弦
-        double cosZenithAngle = std::max(0.0, unitNormal[2]);
+        // 表面倾角β的余弦（法向量与天顶方向的夹角余弦，朝下的表面为负）
+        double cosTilt = unitNormal[2];
 
-        // 各向同性模型
-        double isotropicDiffuse = diffuseRadiation * cosZenithAngle;
+        // 各向同性模型：给定天空视角系数时按表面实际看到的天空计算，
+        // 否则按无遮挡的倾斜面取(1+cosβ)/2（竖直墙面为0.5，朝下的表面为0）
+        double skyViewFraction = skyViewFactor >= 0.0 ? skyViewFactor : 0.5 * (1.0 + cosTilt);
+        double isotropicDiffuse = diffuseRadiation * skyViewFraction;
 
         if (useAnisotropy) {
             // 考虑各向异性的天空散射辐射模型 (简化的Hay模型)
@@ -52,9 +58,11 @@ public:
         }
 
         // === 3. 计算地面反射辐射分量 ===
-        double groundReflectedComponent = 0.5 * groundReflectance *
+        // 无遮挡时地面视角系数为(1-cosβ)/2，与天空部分之和为1
+        double groundViewFraction = groundViewFactor >= 0.0 ? groundViewFactor : 0.5 * (1.0 - cosTilt);
+        double groundReflectedComponent = groundReflectance *
                                          (directRadiation + diffuseRadiation) *
-                                         (1.0 - cosZenithAngle);
+                                         groundViewFraction;
 
         // === 4. 计算总辐射 ===
         double totalRad = directComponent + diffuseComponent + groundReflectedComponent;
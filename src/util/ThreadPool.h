@@ -0,0 +1,247 @@
+//
+// Created by zhou on 25-7-10.
+//
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+// 工作窃取线程池：每个工作线程有自己的任务队列，空闲时从其他队列尾部窃取任务
+// 调用parallel_for的线程也会参与执行任务，因此n个线程的池只创建n-1个工作线程
+// 每次parallel_for只等待自己提交的任务，可以嵌套调用（如并行计算的组件在任务中再次并行）；
+// 等待期间只执行本次调用提交的任务及其中嵌套提交的任务，不会执行无关的任务：
+// 调用方可以在持有锁时调用parallel_for，等待中的线程不会进入另一个同样要取这把锁的任务
+// （如并行计算的两个组件共用一个分析器）；本组的任务总可以由等待的线程自己执行完，不会死锁
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit ThreadPool(size_t num_threads) {
+        num_threads = std::max<size_t>(1, num_threads);
+        for (size_t i = 0; i < num_threads; ++i) {
+            queues_.push_back(std::make_unique<WorkQueue>());
+        }
+        for (size_t i = 1; i < num_threads; ++i) {
+            workers_.emplace_back([this, i] { worker_loop(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            stop_ = true;
+        }
+        wake_cv_.notify_all();
+        for (auto& worker : workers_) {
+            if (worker.joinable()) worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // 线程数（含调用线程）
+    [[nodiscard]] size_t size() const {
+        return queues_.size();
+    }
+
+    // 线程数参数约定：<=0 表示使用全部硬件线程
+    static size_t resolve_thread_count(int requested) {
+        if (requested > 0) return static_cast<size_t>(requested);
+        const unsigned hw = std::thread::hardware_concurrency();
+        return hw == 0 ? 1 : hw;
+    }
+
+    // 并行执行 fn(0) ... fn(count-1) 并等待完成；任务抛出的第一个异常在此重新抛出
+    template <typename Fn>
+    void parallel_for(size_t count, Fn&& fn) {
+        if (size() == 1 || count <= 1) {
+            for (size_t i = 0; i < count; ++i) fn(i);
+            return;
+        }
+        TaskGroup group;
+        group.parent = current_group();
+        for (size_t i = 0; i < count; ++i) {
+            submit([&fn, i] { fn(i); }, group);
+        }
+        wait(group);
+    }
+
+private:
+    // 一次parallel_for提交的任务
+    struct TaskGroup {
+        std::atomic<size_t> pending{0};  // 尚未执行完的任务数
+        std::exception_ptr error;        // 第一个异常（持wake_mutex_读写）
+        const TaskGroup* parent = nullptr;  // 调用parallel_for时当前线程正在执行的任务所属的组
+    };
+
+    struct QueuedTask {
+        Task fn;
+        TaskGroup* group = nullptr;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<QueuedTask> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> workers_;
+
+    std::atomic<size_t> next_queue_{0};
+    std::atomic<size_t> queued_{0};   // 队列中尚未取出的任务数
+    uint64_t submitted_ = 0;          // 累计提交的任务数（持wake_mutex_读写，等待中的线程据此得知有新任务）
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::condition_variable done_cv_;
+    bool stop_ = false;
+
+    // 当前线程在本池中的队列下标（不是本池的工作线程时为0）
+    static size_t& self_index(const ThreadPool* pool) {
+        thread_local const ThreadPool* owner = nullptr;
+        thread_local size_t index = 0;
+        if (owner != pool) {
+            owner = pool;
+            index = 0;
+        }
+        return index;
+    }
+
+    // 当前线程正在执行的任务所属的组（不在执行任务时为空）
+    static const TaskGroup*& current_group() {
+        thread_local const TaskGroup* group = nullptr;
+        return group;
+    }
+
+    // 任务组group是否为ancestor本身或其中嵌套提交的组
+    static bool descends_from(const TaskGroup* group, const TaskGroup* ancestor) {
+        for (; group; group = group->parent) {
+            if (group == ancestor) return true;
+        }
+        return false;
+    }
+
+    // 提交任务（轮询分配到各队列）
+    void submit(Task task, TaskGroup& group) {
+        const size_t q = next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+        // 先计数再入队，保证计数不会小于实际任务数
+        group.pending.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            ++queued_;
+            ++submitted_;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queues_[q]->mutex);
+            queues_[q]->tasks.push_back({std::move(task), &group});
+        }
+        wake_cv_.notify_one();
+        done_cv_.notify_all();  // 嵌套提交的任务可能由等待上层任务组的线程执行
+    }
+
+    // 等待任务组完成，期间当前线程只执行本组及其中嵌套提交的任务
+    void wait(TaskGroup& group) {
+        const size_t self = self_index(this);
+        QueuedTask task;
+        while (group.pending.load() > 0) {
+            uint64_t seen;
+            {
+                std::lock_guard<std::mutex> lock(wake_mutex_);
+                seen = submitted_;
+            }
+            if (try_pop(self, task, &group)) {
+                run(task);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            done_cv_.wait(lock, [this, &group, seen] {
+                return group.pending.load() == 0 || submitted_ != seen;
+            });
+        }
+
+        std::exception_ptr error;
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            std::swap(error, group.error);
+        }
+        if (error) std::rethrow_exception(error);
+    }
+
+    // 先从自己的队列头部取，再从其他队列尾部窃取；only非空时只取属于only或其中嵌套提交的任务
+    bool try_pop(size_t self, QueuedTask& task, const TaskGroup* only = nullptr) {
+        const size_t n = queues_.size();
+        for (size_t k = 0; k < n; ++k) {
+            auto& queue = *queues_[(self + k) % n];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) continue;
+            if (only) {
+                // 从尾部找：嵌套提交的任务较新，在队列尾部
+                const auto it = std::find_if(queue.tasks.rbegin(), queue.tasks.rend(), [only](const QueuedTask& t) {
+                    return descends_from(t.group, only);
+                });
+                if (it == queue.tasks.rend()) continue;
+                task = std::move(*it);
+                queue.tasks.erase(std::next(it).base());
+            } else if (k == 0) {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            } else {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            --queued_;
+            return true;
+        }
+        return false;
+    }
+
+    void run(QueuedTask& task) {
+        TaskGroup* group = task.group;
+        const TaskGroup* outer = std::exchange(current_group(), group);
+        try {
+            task.fn();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            if (!group->error) group->error = std::current_exception();
+        }
+        current_group() = outer;
+        task.fn = nullptr;
+        if (--group->pending == 0) {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            done_cv_.notify_all();
+        }
+    }
+
+    void worker_loop(size_t self) {
+        self_index(this) = self;
+        QueuedTask task;
+        while (true) {
+            if (try_pop(self, task)) {
+                run(task);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            wake_cv_.wait(lock, [this] { return stop_ || queued_.load() > 0; });
+            if (stop_ && queued_.load() == 0) return;
+        }
+    }
+};
+
+} // util
+
+#endif //THREADPOOL_H